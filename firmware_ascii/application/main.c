@@ -14,6 +14,8 @@ All Global variable names shall start with "G_"
 /* New variables */
 volatile u32 G_u32SystemFlags = 0;                     /* Global system flags */
 volatile u32 G_u32ApplicationFlags = 0;                /* Global applications flags: set when application is successfully initialized */
+volatile u32 G_u32StartupFlags = 0;                    /* Set by tasks whose startup sequence is still running (G_u32ApplicationFlags bits) */
+volatile u32 G_u32BootTimeMs = 0;                      /* System time in ms when initialization completed */
 
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* External global variables defined in other files (must indicate which file they are defined in) */
@@ -25,6 +27,7 @@ extern volatile u32 G_u32SystemTime1s;                 /* From board-specific so
 Global variable definitions with scope limited to this local application.
 Variable names shall start with "Main_" and be declared as static.
 ***********************************************************************************************************************/
+static u32 Main_u32StartupTimer;                        /* Deadline reference for the driver startup sequences */
 
 
 /***********************************************************************************************************************
@@ -33,6 +36,9 @@ Main has two sections:
 
 1. Initialization which is run once on power-up or reset.  All drivers and applications are setup here without timing
 contraints but must complete execution regardless of success or failure of starting the application. 
+Drivers that need timed startup steps (resets, power-up delays) set their bit in G_u32StartupFlags and finish the
+steps from their state machines, so the driver tasks run together until all of the bits clear or 
+MAIN_STARTUP_TIMEOUT_MS passes.  Applications are initialized after that.
 
 2. Super loop which runs infinitely giving processor time to each application.  The total loop time should not exceed
 1ms of execution time counting all application execution.  SystemSleep() will execute to complete the remaining time in
@@ -69,6 +75,18 @@ void main(void)
   AntApiInitialize();
   SdCardInitialize();
 
+  /* Run the drivers until their startup sequences are done so the resets and delays overlap */
+  Main_u32StartupTimer = G_u32SystemTime1ms;
+  while( G_u32StartupFlags && !IsTimeUp(&Main_u32StartupTimer, MAIN_STARTUP_TIMEOUT_MS) )
+  {
+    WATCHDOG_BONE();
+    MainRunDriverStates();
+
+    HEARTBEAT_OFF();
+    SystemSleep();
+    HEARTBEAT_ON();
+  }
+  
   /* Application initialization */
 
   UserApp1Initialize();
@@ -77,6 +95,7 @@ void main(void)
 
   
   /* Exit initialization */
+  G_u32BootTimeMs = G_u32SystemTime1ms;
   SystemStatusReport();
   G_u32SystemFlags &= ~_SYSTEM_INITIALIZING;
     
@@ -86,19 +105,7 @@ void main(void)
     WATCHDOG_BONE();
     
     /* Drivers */
-    LedUpdate();
-    ButtonRunActiveState();
-    UartRunActiveState();
-    TimerRunActiveState(); 
-    SspRunActiveState();
-    TWIRunActiveState();
-    Adc12RunActiveState();
-    MessagingRunActiveState();
-    DebugRunActiveState();
-    LcdRunActiveState();
-    AntRunActiveState();
-    AntApiRunActiveState();
-    SdCardRunActiveState();
+    MainRunDriverStates();
 
     /* Applications */
     UserApp1RunActiveState();
@@ -115,6 +122,37 @@ void main(void)
 } /* end main() */
 
 
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MainRunDriverStates
+
+Description:
+Runs one iteration of every driver task.  Used by the startup loop and the super loop.
+
+Requires:
+  - All drivers have been initialized
+
+Promises:
+  - Each driver state machine has run once
+*/
+static void MainRunDriverStates(void)
+{
+  LedUpdate();
+  ButtonRunActiveState();
+  UartRunActiveState();
+  TimerRunActiveState();
+  SspRunActiveState();
+  TWIRunActiveState();
+  Adc12RunActiveState();
+  MessagingRunActiveState();
+  DebugRunActiveState();
+  LcdRunActiveState();
+  AntRunActiveState();
+  AntApiRunActiveState();
+  SdCardRunActiveState();
+
+} /* end MainRunDriverStates() */
+
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* End of File */
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -62,6 +62,7 @@ All Global variable names shall start with "G_<type>Lcd"
 /* Existing variables (defined in other files -- should all contain the "extern" keyword) */
 extern volatile u32 G_u32SystemFlags;                  /* From main.c */
 extern volatile u32 G_u32ApplicationFlags;             /* From main.c */
+extern volatile u32 G_u32StartupFlags;                 /* From main.c */
 
 extern volatile u32 G_u32SystemTime1ms;                /* From board-specific source file */
 extern volatile u32 G_u32SystemTime1s;                 /* From board-specific source file */
@@ -109,12 +110,6 @@ void LCDCommand(u8 u8Command_)
   /* Queue the command to the IC application */
   TWI0WriteData(LCD_ADDRESS, sizeof(au8LCDWriteCommand), &au8LCDWriteCommand[0], STOP);
 
-  /* Add a delay during initialization to let the command send properly */
-  if(G_u32SystemFlags & _SYSTEM_INITIALIZING )
-  {
-    for(u32 i = 0; i < 100000; i++);
-  }
-  
 } /* end LCDCommand() */
 
 /*------------------------------------------------------------------------------
@@ -202,55 +197,24 @@ void LCDClearChars(u8 u8Address_, u8 u8CharactersToClear_)
 Function: LcdInitialize
 
 Description:
-Initializes the LCD task and manually sends a message to the LCD
+Initializes the LCD task and takes the LCD out of reset.  The setup commands and welcome message are sent
+by the startup states once the LCD has had time to power up.
 
 Requires:
   - 
 
 Promises:
-  - LCD task Setup and LCD functions can now be called
+  - LCD reset is released and _APPLICATION_FLAGS_LCD is set in G_u32StartupFlags until the startup states finish
+  - Lcd_StateMachine = LcdSM_StartupDelay
 */
 void LcdInitialize(void)
 {
-  u8 au8Commands[] = 
-  {
-    LCD_FUNCTION_CMD, LCD_FUNCTION2_CMD, LCD_BIAS_CMD, 
-    LCD_CONTRAST_CMD, LCD_DISPLAY_SET_CMD, LCD_FOLLOWER_CMD 
-  };
-                 /* "012345567890123456789" */
-  u8 au8Welcome[] = "RAZOR SAM3U2 ASCII   ";
-  
-  /* State to Idle */
-  Lcd_StateMachine = LcdSM_Idle;
-  
-  /* Turn on LCD wait 40 ms for it to setup */
+  /* Turn on LCD: LcdSM_StartupDelay gives it LCD_STARTUP_DELAY ms to setup */
   AT91C_BASE_PIOB->PIO_SODR = PB_09_LCD_RST;
   Lcd_u32Timer = G_u32SystemTime1ms;
-  while( !IsTimeUp(&Lcd_u32Timer, LCD_STARTUP_DELAY) );
-  
-  /* Send Control Command */
-  TWI0WriteByte(LCD_ADDRESS, LCD_CONTROL_COMMAND, NO_STOP);
-  
-  /* Send Control Commands */
-  TWI0WriteData(LCD_ADDRESS, NUM_CONTROL_CMD, &au8Commands[0], NO_STOP);
-  
-  /* Wait for 200 ms */
-  Lcd_u32Timer = G_u32SystemTime1ms;
-  while( !IsTimeUp(&Lcd_u32Timer, LCD_CONTROL_COMMAND_DELAY) );
-  
-  /* Send Final Command to turn it on */
-  TWI0WriteByte(LCD_ADDRESS, LCD_DISPLAY_CMD | LCD_DISPLAY_ON, STOP);
-
-  /* Blacklight - White */
-  LedOn(LCD_RED);
-  LedOn(LCD_GREEN);
-  LedOn(LCD_BLUE);
   
-  TWI0WriteByte(LCD_ADDRESS, LCD_CONTROL_DATA, NO_STOP);
-  TWI0WriteData(LCD_ADDRESS, 20, &au8Welcome[0], STOP);
-   
-  Lcd_u32Timer = G_u32SystemTime1ms;
-  G_u32ApplicationFlags |= _APPLICATION_FLAGS_LCD;
+  G_u32StartupFlags |= _APPLICATION_FLAGS_LCD;
+  Lcd_StateMachine = LcdSM_StartupDelay;
 
 } /* end LcdInitialize */
 
@@ -280,6 +244,84 @@ void LcdRunActiveState(void)
 State Machine Function Declarations
 ***********************************************************************************************************************/
 
+/*------------------------------------------------------------------------------
+Function: LcdSM_StartupDelay
+
+Description:
+Waits for the LCD to power up after reset is released, then queues the setup commands.
+
+Requires:
+  - Lcd_u32Timer was set when the LCD reset was released
+
+Promises:
+  - After LCD_STARTUP_DELAY ms, the control commands are queued to the TWI and 
+    Lcd_StateMachine = LcdSM_StartupCommands
+*/
+void LcdSM_StartupDelay(void)
+{
+  u8 au8Commands[] = 
+  {
+    LCD_FUNCTION_CMD, LCD_FUNCTION2_CMD, LCD_BIAS_CMD, 
+    LCD_CONTRAST_CMD, LCD_DISPLAY_SET_CMD, LCD_FOLLOWER_CMD 
+  };
+  
+  if( IsTimeUp(&Lcd_u32Timer, LCD_STARTUP_DELAY) )
+  {
+    /* Send Control Command */
+    TWI0WriteByte(LCD_ADDRESS, LCD_CONTROL_COMMAND, NO_STOP);
+    
+    /* Send Control Commands */
+    TWI0WriteData(LCD_ADDRESS, NUM_CONTROL_CMD, &au8Commands[0], NO_STOP);
+    
+    Lcd_u32Timer = G_u32SystemTime1ms;
+    Lcd_StateMachine = LcdSM_StartupCommands;
+  }
+  
+} /* end LcdSM_StartupDelay() */
+
+
+/*------------------------------------------------------------------------------
+Function: LcdSM_StartupCommands
+
+Description:
+Waits for the LCD to process the control commands, then turns on the display and
+shows the welcome message.
+
+Requires:
+  - Lcd_u32Timer was set when the control commands were queued
+
+Promises:
+  - After LCD_CONTROL_COMMAND_DELAY ms, the display is on with the welcome message,
+    the backlight is white, _APPLICATION_FLAGS_LCD is set in G_u32ApplicationFlags and cleared
+    in G_u32StartupFlags and Lcd_StateMachine = LcdSM_Idle
+*/
+void LcdSM_StartupCommands(void)
+{
+                 /* "012345567890123456789" */
+  u8 au8Welcome[] = "RAZOR SAM3U2 ASCII   ";
+  
+  if( IsTimeUp(&Lcd_u32Timer, LCD_CONTROL_COMMAND_DELAY) )
+  {
+    /* Send Final Command to turn it on */
+    TWI0WriteByte(LCD_ADDRESS, LCD_DISPLAY_CMD | LCD_DISPLAY_ON, STOP);
+
+    /* Blacklight - White */
+    LedOn(LCD_RED);
+    LedOn(LCD_GREEN);
+    LedOn(LCD_BLUE);
+    
+    TWI0WriteByte(LCD_ADDRESS, LCD_CONTROL_DATA, NO_STOP);
+    TWI0WriteData(LCD_ADDRESS, 20, &au8Welcome[0], STOP);
+     
+    Lcd_u32Timer = G_u32SystemTime1ms;
+    G_u32ApplicationFlags |= _APPLICATION_FLAGS_LCD;
+    G_u32StartupFlags &= ~_APPLICATION_FLAGS_LCD;
+    Lcd_StateMachine = LcdSM_Idle;
+  }
+  
+} /* end LcdSM_StartupCommands() */
+
+
 /*------------------------------------------------------------------------------
 Function: LcdSM_Idle
 
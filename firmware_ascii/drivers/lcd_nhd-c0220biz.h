@@ -120,6 +120,8 @@ void LcdRunActiveState(void);
 /***********************************************************************************************************************
 State Machine Declarations
 ***********************************************************************************************************************/
+void LcdSM_StartupDelay(void);
+void LcdSM_StartupCommands(void);
 void LcdSM_Idle(void);
 
   
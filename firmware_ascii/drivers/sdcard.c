@@ -286,6 +286,17 @@ void SdCardInitialize(void)
   SD_sSspConfig.u16RxBufferSize    = SDCARD_RX_BUFFER_SIZE;
   SD_sSspConfig.eBitOrder          = MSB_FIRST;
   SD_sSspConfig.eSspMode           = SPI_MASTER_MANUAL_CS;
+  SD_sSspConfig.eTxPriority        = MSG_PRIORITY_NORMAL;
+  SD_sSspConfig.u32TxByteQuota     = 0;
+  SD_sSspConfig.u32ModeRegister    = 0;
+  SD_sSspConfig.u32BaudRateRegister = 0;
+  
+  /* The SSP device is kept for good: the SSP driver shares the bus with any other devices on it */
+  SD_Ssp = SspRequest(&SD_sSspConfig);
+  if(SD_Ssp == NULL)
+  {
+    DebugPrintf(SD_au8SspRequestFailed);
+  }
   
   /* Always start in SdCardSM_IdleNoCard but display different message if card is already in */
   SD_pfStateMachine = SdCardSM_IdleNoCard;
@@ -345,19 +356,20 @@ Requires:
   - pau8Command_ is a pointer to the first byte of the command byte array
 
 Promises:
-  - Requested command is queued to the SSP peripheral
+  - CS is asserted and the requested command is queued to the SSP peripheral
   - SD_u32CurrentMsgToken updated with the corresponding message token
   - SD_u32Timeout loaded to start counting the timeout period for the command
   - State machine set to wait command
 */
 void SdCommand(u8* pau8Command_)
 {
+  /* Assert CS first: the SSP task starts the command as soon as it is queued */
+  SspAssertCS(SD_Ssp);
+  
   /* Queue the transmit message with this command */
   SD_u32CurrentMsgToken = SspWriteData(SD_Ssp, SD_CMD_SIZE, pau8Command_);
   if(SD_u32CurrentMsgToken)
   {
-    SspAssertCS(SD_Ssp);
-
     /* Set up time-outs and next state */
     SD_u32Timeout = G_u32SystemTime1ms;
     SD_pfStateMachine = SdCardSM_WaitCommand;
@@ -452,38 +464,25 @@ State Machine Function Definitions
 static void SdCardSM_IdleNoCard(void)
 {
 
-  if( SdIsCardInserted() )
+  if( SdIsCardInserted() && (SD_Ssp != NULL) )
   {
-    /* Request the SSP resource to talk to the card */
-    SD_Ssp = SspRequest(&SD_sSspConfig);
-    if(SD_Ssp == NULL)
+    /* If card is in, set flag and then try to talk to card.  Other devices on the SSP bus only get
+    turns between transfers while CS is deasserted. */
+    SD_u32Flags &= SD_CLEAR_CARD_TYPE_BITS;
+
+    /* CS is NOT asserted for initial dummy clocks */
+    SspDeAssertCS(SD_Ssp);
+    
+    /* Queue up a set of dummy transfers to make sure the card is awake; */
+    if(SspReadData(SD_Ssp, SD_WAKEUP_BYTES))
     {
-      /* Go to wait state if SSP is not available */
-      DebugPrintf(SD_au8SspRequestFailed);
-      SD_u32Timeout = G_u32SystemTime1ms;
-      SD_pfWaitReturnState = SdCardSM_IdleNoCard;
-      SD_pfStateMachine = SdCardSM_WaitSSP;
+      SD_pfStateMachine = SdCardSM_Dummies;
     }
     else
     {
-      /* If card is in, set flag and then try to talk to card.  Note that the SSP peripheral will 
-      be allocated to the SD card for this whole initialization process. */
-      SD_u32Flags &= SD_CLEAR_CARD_TYPE_BITS;
-
-      /* CS is NOT asserted for initial dummy clocks */
-      SspDeAssertCS(SD_Ssp);
-      
-      /* Queue up a set of dummy transfers to make sure the card is awake; */
-      if(SspReadData(SD_Ssp, SD_WAKEUP_BYTES))
-      {
-        SD_pfStateMachine = SdCardSM_Dummies;
-      }
-      else
-      {
-        /* We didn't get a return token, so abort */
-        SD_u8ErrorCode = SD_ERROR_NO_TOKEN;
-        SD_pfStateMachine = SdCardSM_Error;
-      }
+      /* We didn't get a return token, so abort */
+      SD_u8ErrorCode = SD_ERROR_NO_TOKEN;
+      SD_pfStateMachine = SdCardSM_Error;
     }
   }  
   
@@ -726,9 +725,8 @@ static void SdCardSM_ResponseCMD16(void)
   /* Check the response byte (response R1) */
   if(SD_au8RxBuffer[0] == SD_STATUS_READY)
   {
-    /* Success! Card is ready for read/write operations.  We can release the SSP resource for now. */
+    /* Success! Card is ready for read/write operations.  Deasserting CS lets other devices use the bus. */
     SspDeAssertCS(SD_Ssp);
-    SspRelease(SD_Ssp);
 
     SD_CardState = SD_IDLE;
     DebugPrintf(SD_au8CardReady);
@@ -765,8 +763,6 @@ static void SdCardSM_ReadCMD58(void)
       SD_u32Flags |= _SD_CARD_HC;
       
       /* Success! Card is ready for read/write operations */
-      SspRelease(SD_Ssp);
-  
       SD_CardState = SD_IDLE;
       DebugPrintf(SD_au8CardReady);
     
@@ -920,22 +916,22 @@ static void SdCardSM_WaitResponse(void)
 
   
 /*-------------------------------------------------------------------------------------------------------------------*/
-/* Kill time before checking SSP availability again */
-static void SdCardSM_WaitSSP(void)          
+/* Kill time (card debounce and error recovery) before going to SD_pfWaitReturnState */
+static void SdCardSM_Delay(void)          
 {
   if( IsTimeUp(&SD_u32Timeout, SD_SPI_WAIT_TIME_MS) )
   {
     SD_pfStateMachine = SD_pfWaitReturnState;
   }
   
-} /* end SdCardSM_WaitSSP() */
+} /* end SdCardSM_Delay() */
      
      
 /*-------------------------------------------------------------------------------------------------------------------*/
 /* SD card is initialized: wait for action request. */
 static void SdCardSM_ReadyIdle(void)          
 {
-  /* Check if the card is still in; if not return through WaitSSP to allow some debounce time */
+  /* Check if the card is still in; if not return through SdCardSM_Delay to allow some debounce time */
   if( !SdIsCardInserted() )
   {
     SD_u32Flags &= SD_CLEAR_CARD_TYPE_BITS;
@@ -943,44 +939,27 @@ static void SdCardSM_ReadyIdle(void)
     /* Exit through a wait state for effective debouncing */
     SD_u32Timeout = G_u32SystemTime1ms;
     SD_pfWaitReturnState = SdCardSM_IdleNoCard;
-    SD_pfStateMachine = SdCardSM_WaitSSP;
+    SD_pfStateMachine = SdCardSM_Delay;
   }
   else
   {
-    /* Look for a request to read or write file data */
-    if( (SD_CardState == SD_WRITING) || (SD_CardState == SD_READING) )
+    /* Look for a request to read or write file data; the SSP queues it behind any other device's transfer */
+    if(SD_CardState == SD_WRITING)
     {
-      /* Request the SSP resource to talk to the card */
-      SD_Ssp = SspRequest(&SD_sSspConfig);
-      if(SD_Ssp == NULL)
-      {
-        /* Go to wait state if SSP is not available */
-        DebugPrintf(SD_au8SspRequestFailed);
-        SD_u32Timeout = G_u32SystemTime1ms;
-        SD_pfWaitReturnState = SdCardSM_ReadyIdle;
-        SD_pfStateMachine = SdCardSM_WaitSSP;
-      }
-      else
-      {
-        /* Got SSP, so start read or write */
-        if(SD_CardState == SD_WRITING)
-        {
-          /* Not yet implemented */
-          SD_pfStateMachine = SdCardSM_ReadyIdle;
-          SD_CardState = SD_IDLE;
-        }
-        else
-        {
-          /* Parse out the bytes of the address into the command array */
-          SD_au8CMD17[1] = (u8)(SD_u32Address >> 24);
-          SD_au8CMD17[2] = (u8)(SD_u32Address >> 16);
-          SD_au8CMD17[3] = (u8)(SD_u32Address >> 8);
-          SD_au8CMD17[4] = (u8)SD_u32Address;
-          
-          SdCommand(&SD_au8CMD17[0]);
-          SD_pfWaitReturnState = SdCardSM_ResponseCMD17;
-        }
-      }
+      /* Not yet implemented */
+      SD_pfStateMachine = SdCardSM_ReadyIdle;
+      SD_CardState = SD_IDLE;
+    }
+    else if(SD_CardState == SD_READING)
+    {
+      /* Parse out the bytes of the address into the command array */
+      SD_au8CMD17[1] = (u8)(SD_u32Address >> 24);
+      SD_au8CMD17[2] = (u8)(SD_u32Address >> 16);
+      SD_au8CMD17[3] = (u8)(SD_u32Address >> 8);
+      SD_au8CMD17[4] = (u8)SD_u32Address;
+      
+      SdCommand(&SD_au8CMD17[0]);
+      SD_pfWaitReturnState = SdCardSM_ResponseCMD17;
     }
   }
 } /* end SdCardSM_ReadyIdle() */
@@ -1084,7 +1063,6 @@ static void SdCardSM_DataTransfer(void)
     SD_CardState = SD_DATA_READY;
 
     SspDeAssertCS(SD_Ssp);
-    SspRelease(SD_Ssp);
 
     /* Reset the RxBuffer pointers to the start of the RxBuffer */
     //SD_pu8RxBufferNextByte = &SD_au8RxBuffer[0];
@@ -1109,12 +1087,11 @@ static void SdCardSM_FailedDataTransfer(void)
 {
   /* Reset the system variables */
   SspDeAssertCS(SD_Ssp);
-  SspRelease(SD_Ssp);
   //FlushSdRxBuffer();
   SD_CardState = SD_CARD_ERROR;
   
   SD_u32Timeout = G_u32SystemTime1ms;
-  SD_pfStateMachine = SdCardSM_WaitSSP;
+  SD_pfStateMachine = SdCardSM_Delay;
   
 } /* end SdCardSM_FailedDataTransfer() */
 
@@ -1128,10 +1105,9 @@ static void SdCardSM_Error(void)
   
   /* Reset the system variables */
   SspDeAssertCS(SD_Ssp);
-  SspRelease(SD_Ssp);
   //FlushSdRxBuffer();
 
-  /* Indicate error and return through the SSP delay state to give the system some recovery time */
+  /* Indicate error and return through the delay state to give the system some recovery time */
   DebugPrintf(SD_au8CardError);
   switch (SD_u8ErrorCode)
   {
@@ -1184,7 +1160,7 @@ static void SdCardSM_Error(void)
   SD_CardState = SD_NO_CARD;
   SD_u32Timeout = G_u32SystemTime1ms;
   SD_pfWaitReturnState = SdCardSM_IdleNoCard;
-  SD_pfStateMachine = SdCardSM_WaitSSP;
+  SD_pfStateMachine = SdCardSM_Delay;
   
 } /* end SdCardSM_Error() */
 
@@ -44,7 +44,7 @@ Constants / Definitions
 
 #define SD_CMD_SIZE               (u8)6                /* Size of an SD card command */
 
-#define SD_SPI_WAIT_TIME_MS	      (u32)(500)           /* Time to wait for the SPI resource to become available */
+#define SD_SPI_WAIT_TIME_MS	      (u32)(500)           /* Time to wait for an SPI transfer; also the SdCardSM_Delay() time */
 #define SD_READ_TOKEN_MS		      (u32)(200)
 #define SD_INIT_TIMEOUT_MS		    (u32)(1000)
 #define SD_SECTOR_READ_TIMEOUT_MS	(u32)(1000)
@@ -184,7 +184,7 @@ static void SdCardSM_FailedDataTransfer(void);
 //static void SdCardSM_WaitReady(void);
 static void SdCardSM_WaitCommand(void);
 static void SdCardSM_WaitResponse(void);
-static void SdCardSM_WaitSSP(void);
+static void SdCardSM_Delay(void);
 
 static void SdCardSM_Error(void);         
 
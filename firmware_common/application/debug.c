@@ -90,6 +90,7 @@ u8 G_u8DebugScanfCharCount = 0;                    /* Counter for # of character
 /* Existing variables (defined in other files -- should all contain the "extern" keyword) */
 extern volatile u32 G_u32SystemFlags;                    /* From main.c */
 extern volatile u32 G_u32ApplicationFlags;               /* From main.c */
+extern volatile u32 G_u32BootTimeMs;                     /* From main.c */
 
 extern volatile u32 G_u32SystemTime1ms;                  /* From board-specific source file */
 extern volatile u32 G_u32SystemTime1s;                   /* From board-specific source file */
@@ -127,9 +128,9 @@ DebugCommandType Debug_au8Commands[DEBUG_COMMANDS] = { {DEBUG_CMD_NAME00, DebugC
                                                        {DEBUG_CMD_NAME01, DebugCommandLedTestToggle},
                                                        {DEBUG_CMD_NAME02, DebugCommandSysTimeToggle},
                                                        {DEBUG_CMD_NAME03, DebugCommandDummy},
-                                                       {DEBUG_CMD_NAME04, DebugCommandDummy},
-                                                       {DEBUG_CMD_NAME05, DebugCommandDummy},
-                                                       {DEBUG_CMD_NAME06, DebugCommandDummy},
+                                                       {DEBUG_CMD_NAME04, DebugCommandMessagingBenchmark},
+                                                       {DEBUG_CMD_NAME05, DebugCommandMessagingStats},
+                                                       {DEBUG_CMD_NAME06, DebugCommandMessagingSelfTest},
                                                        {DEBUG_CMD_NAME07, DebugCommandDummy} 
                                                      };
 
@@ -141,9 +142,9 @@ DebugCommandType Debug_au8Commands[DEBUG_COMMANDS] = { {DEBUG_CMD_NAME00, DebugC
                                                        {DEBUG_CMD_NAME01, DebugCommandLedTestToggle},
                                                        {DEBUG_CMD_NAME02, DebugCommandSysTimeToggle},
                                                        {DEBUG_CMD_NAME03, DebugCommandCaptouchValuesToggle},
-                                                       {DEBUG_CMD_NAME04, DebugCommandDummy},
-                                                       {DEBUG_CMD_NAME05, DebugCommandDummy},
-                                                       {DEBUG_CMD_NAME06, DebugCommandDummy},
+                                                       {DEBUG_CMD_NAME04, DebugCommandMessagingBenchmark},
+                                                       {DEBUG_CMD_NAME05, DebugCommandMessagingStats},
+                                                       {DEBUG_CMD_NAME06, DebugCommandMessagingSelfTest},
                                                        {DEBUG_CMD_NAME07, DebugCommandDummy} 
                                                      };
 
@@ -370,11 +371,14 @@ Requires:
 Promises:
   - Prints out messages for any system tests that failed
   - Prints out overall good message if all tests passed
+  - Prints the boot time (G_u32BootTimeMs)
 */
 void SystemStatusReport(void)
 {
   u8 au8SystemPassed[] = "No failed tasks.";
   u8 au8SystemReady[] = "\n\rInitialization complete. Type en+c00 for debug menu.  Failed tasks:\n\r";
+  u8 au8BootTime[] = "Boot time: ";
+  u8 au8BootTimeUnits[] = " ms";
   u32 u32TaskFlagMaskBit = (u32)0x01;
   bool bNoFailedTasks = TRUE;
 
@@ -408,6 +412,12 @@ void SystemStatusReport(void)
   
   DebugLineFeed();
   
+  /* Report how long startup took so it can be tracked */
+  DebugPrintf(au8BootTime);
+  DebugPrintNumber(G_u32BootTimeMs);
+  DebugPrintf(au8BootTimeUnits);
+  DebugLineFeed();
+  
 } /* end SystemStatusReport() */
 
 
@@ -458,6 +468,10 @@ void DebugInitialize(void)
   sUartConfig.pu8RxNextByte      = &Debug_pu8RxBufferNextChar;
   sUartConfig.u16RxBufferSize    = DEBUG_RX_BUFFER_SIZE;
   sUartConfig.fnRxCallback       = DebugRxCallback;
+  sUartConfig.eTxPriority        = MSG_PRIORITY_LOW;
+  sUartConfig.u32TxByteQuota     = DEBUG_TX_BYTE_QUOTA;
+  sUartConfig.eRxMode            = UART_RX_BLOCK;
+  sUartConfig.bHardwareFlowControl = FALSE;
   
   Debug_Uart = UartRequest(&sUartConfig);
   
@@ -803,6 +817,234 @@ static void DebugCommandSysTimeToggle(void)
   
 } /* end DebugCommandSysTimeToggle() */
 
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: DebugCommandMessagingBenchmark
+
+Description:
+Times queue, status and dequeue for each message size and queue depth in the tables below, then runs the arena
+allocator benchmark, and prints the average times in ns.  The queue benchmark needs an empty arena so it is run 
+before anything is printed; "busy" is reported if other messages are still queued.  Each result line is a 
+separate debug message built with DebugLineAppend() so it can never overrun the line buffer.
+The benchmark blocks for a few hundred ms so a system time violation may be reported if enabled.
+*/
+static void DebugCommandMessagingBenchmark(void)
+{
+  static const u32 au32Sizes[DEBUG_BENCHMARK_SIZES] = {16, 256, MAX_TX_MESSAGE_LENGTH};
+  static const u32 au32Depths[DEBUG_BENCHMARK_DEPTHS] = {1, 8};
+  u8 au8BenchmarkMessage[] = "\n\rMessaging pool (";
+  u8 au8BytesMessage[] = " bytes): ";
+  u8 au8ResultMessage[] = " ns/op\n\r";
+  u8 au8QueueMessage[] = "Size x depth: queue/status/dequeue ns\n\r";
+  u8 au8BusyMessage[] = "Messaging benchmark: busy\n\r";
+  u8 au8Line[DEBUG_STATS_LINE_SIZE];
+  u8 au8Number[11];
+  MessagingBenchmarkType asResults[DEBUG_BENCHMARK_SIZES * DEBUG_BENCHMARK_DEPTHS];
+  MessagingBenchmarkType* psResult = &asResults[0];
+  bool bQueueResults = TRUE;
+  u32 u32Result;
+  
+  for(u8 i = 0; (i < DEBUG_BENCHMARK_SIZES) && bQueueResults; i++)
+  {
+    for(u8 j = 0; (j < DEBUG_BENCHMARK_DEPTHS) && bQueueResults; j++)
+    {
+      bQueueResults = MessagingBenchmarkQueue(au32Sizes[i], au32Depths[j], psResult++);
+    }
+  }
+  
+  /* Both benchmarks refuse to run unless the arena is empty */
+  u32Result = MessagingBenchmark();
+  if( !bQueueResults || (u32Result == 0) )
+  {
+    DebugPrintf(au8BusyMessage);
+    return;
+  }
+
+  DebugPrintf(au8BenchmarkMessage);
+  DebugPrintNumber(MSG_ARENA_SIZE);
+  DebugPrintf(au8BytesMessage);
+  DebugPrintNumber(u32Result);
+  DebugPrintf(au8ResultMessage);
+  
+  /* One message per size and depth */
+  DebugPrintf(au8QueueMessage);
+  psResult = &asResults[0];
+  for(u8 i = 0; i < DEBUG_BENCHMARK_SIZES; i++)
+  {
+    for(u8 j = 0; j < DEBUG_BENCHMARK_DEPTHS; j++)
+    {
+      au8Line[0] = '\0';
+      NumberToAscii(au32Sizes[i], au8Number);
+      DebugLineAppend(au8Line, au8Number);
+      DebugLineAppend(au8Line, " x ");
+      NumberToAscii(psResult->u32Depth, au8Number);
+      DebugLineAppend(au8Line, au8Number);
+      DebugLineAppend(au8Line, ": ");
+      NumberToAscii(psResult->u32QueueNs, au8Number);
+      DebugLineAppend(au8Line, au8Number);
+      DebugLineAppend(au8Line, "/");
+      NumberToAscii(psResult->u32StatusNs, au8Number);
+      DebugLineAppend(au8Line, au8Number);
+      DebugLineAppend(au8Line, "/");
+      NumberToAscii(psResult->u32DequeueNs, au8Number);
+      DebugLineAppend(au8Line, au8Number);
+      DebugLineAppend(au8Line, "\n\r");
+      DebugPrintf(au8Line);
+      psResult++;
+    }
+  }
+  
+} /* end DebugCommandMessagingBenchmark() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: DebugCommandMessagingStats
+
+Description:
+Prints the messaging counters and high-water marks followed by the wait (queued to sending) and send 
+(sending to complete) latency histograms of each queue that has samples.  Bucket n holds latencies of 2^(n-1) to 
+2^n - 1 ms.  Lines are built locally with DebugLineAppend() so the whole report costs only a few debug messages.
+*/
+static void DebugCommandMessagingStats(void)
+{
+  u8 au8Line[DEBUG_STATS_LINE_SIZE];
+  u8 au8Number[11];
+  MessagingStatsType sStats;
+  MessageLatencyType sLatency;
+  u32 u32Samples;
+  u8 u8QueueId = 0;
+  
+  MessagingGetStats(&sStats);
+
+  au8Line[0] = '\0';
+  DebugLineAppend(au8Line, "\n\rEnq: ");
+  NumberToAscii(sStats.u32Enqueues, au8Number);
+  DebugLineAppend(au8Line, au8Number);
+  DebugLineAppend(au8Line, " Deq: ");
+  NumberToAscii(sStats.u32Dequeues, au8Number);
+  DebugLineAppend(au8Line, au8Number);
+  DebugLineAppend(au8Line, " Too large: ");
+  NumberToAscii(sStats.u32TooLarge, au8Number);
+  DebugLineAppend(au8Line, au8Number);
+  DebugLineAppend(au8Line, " Full: ");
+  NumberToAscii(sStats.u32QueueFull, au8Number);
+  DebugLineAppend(au8Line, au8Number);
+  DebugLineAppend(au8Line, " Quota: ");
+  NumberToAscii(sStats.u32QuotaFull, au8Number);
+  DebugLineAppend(au8Line, au8Number);
+  DebugLineAppend(au8Line, "\n\rArena high: ");
+  NumberToAscii(sStats.u32ArenaBytesHighWater, au8Number);
+  DebugLineAppend(au8Line, au8Number);
+  DebugLineAppend(au8Line, "/");
+  NumberToAscii(MSG_ARENA_SIZE, au8Number);
+  DebugLineAppend(au8Line, au8Number);
+  DebugLineAppend(au8Line, " Msgs high: ");
+  NumberToAscii(sStats.u32MessagesHighWater, au8Number);
+  DebugLineAppend(au8Line, au8Number);
+  DebugLineAppend(au8Line, "\n\rLatency ms: 0 1 2+ 4+ 8+ 16+ 32+ 64+\n\r");
+  DebugPrintf(au8Line);
+  
+  /* One line per queue that has seen traffic */
+  while(MessagingGetLatency(u8QueueId, &sLatency))
+  {
+    u32Samples = 0;
+    for(u8 i = 0; i < MSG_LATENCY_BUCKETS; i++)
+    {
+      u32Samples += sLatency.au32WaitTime[i] + sLatency.au32SendTime[i];
+    }
+    
+    if(u32Samples != 0)
+    {
+      au8Line[0] = 'Q';
+      NumberToAscii(u8QueueId, &au8Line[1]);
+      DebugLineAppend(au8Line, " wait:");
+      for(u8 i = 0; i < MSG_LATENCY_BUCKETS; i++)
+      {
+        DebugLineAppend(au8Line, " ");
+        NumberToAscii(sLatency.au32WaitTime[i], au8Number);
+        DebugLineAppend(au8Line, au8Number);
+      }
+      DebugLineAppend(au8Line, " send:");
+      for(u8 i = 0; i < MSG_LATENCY_BUCKETS; i++)
+      {
+        DebugLineAppend(au8Line, " ");
+        NumberToAscii(sLatency.au32SendTime[i], au8Number);
+        DebugLineAppend(au8Line, au8Number);
+      }
+      DebugLineAppend(au8Line, "\n\r");
+      DebugPrintf(au8Line);
+    }
+    
+    u8QueueId++;
+  }
+  
+} /* end DebugCommandMessagingStats() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: DebugCommandMessagingSelfTest
+
+Description:
+Runs the messaging stress test and prints PASS or the failure flags (see _MSG_SELFTEST_x in messaging.h).
+The test needs an empty arena so it reports busy if debug output or other messages are still queued.
+*/
+static void DebugCommandMessagingSelfTest(void)
+{
+  u8 au8SelfTestMessage[] = "\n\rMessaging self test: ";
+  u8 au8PassMessage[] = "PASS\n\r";
+  u8 au8FailMessage[] = "FAIL 0x";
+  u8 au8Line[48];
+  u8 u8Length;
+  u32 u32Result;
+  
+  u32Result = MessagingSelfTest();
+  
+  strcpy((char*)au8Line, (char*)au8SelfTestMessage);
+  if(u32Result == 0)
+  {
+    strcat((char*)au8Line, (char*)au8PassMessage);
+  }
+  else
+  {
+    strcat((char*)au8Line, (char*)au8FailMessage);
+    u8Length = strlen((char*)au8Line);
+    au8Line[u8Length++] = HexToASCIICharUpper( (u8)((u32Result >> 4) & 0x0F) );
+    au8Line[u8Length++] = HexToASCIICharUpper( (u8)(u32Result & 0x0F) );
+    au8Line[u8Length]   = '\0';
+    strcat((char*)au8Line, "\n\r");
+  }
+  
+  DebugPrintf(au8Line);
+  
+} /* end DebugCommandMessagingSelfTest() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: DebugLineAppend
+
+Description:
+Appends a string to a report line without overrunning it.  Text that does not fit is dropped.
+
+Requires:
+  - pu8Line_ points to a NULL-terminated string in a buffer of DEBUG_STATS_LINE_SIZE bytes
+  - pu8Text_ is NULL-terminated
+
+Promises:
+  - As much of pu8Text_ as fits is added to pu8Line_ which stays NULL-terminated
+*/
+static void DebugLineAppend(u8* pu8Line_, const u8* pu8Text_)
+{
+  u32 u32Length = strlen((char*)pu8Line_);
+  
+  while( (*pu8Text_ != '\0') && (u32Length < (DEBUG_STATS_LINE_SIZE - 1)) )
+  {
+    pu8Line_[u32Length++] = *pu8Text_++;
+  }
+  
+  pu8Line_[u32Length] = '\0';
+  
+} /* end DebugLineAppend() */
+
 #ifdef MPGL2 /* MPGL2 only tests */
 /*----------------------------------------------------------------------------------------------------------------------
 Function: DebugCommandCaptouchValuesToggle
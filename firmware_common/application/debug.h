@@ -12,6 +12,10 @@ File: debug.h
 #define DEBUG_RX_BUFFER_SIZE           (u32)128             /* Size of debug buffer for incoming messages */
 #define DEBUG_CMD_BUFFER_SIZE          (u32)64              /* Size of debug buffer for a command */
 #define DEBUG_SCANF_BUFFER_SIZE        (u8)128              /* Size of buffer for scanf messages */
+#define DEBUG_TX_BYTE_QUOTA            (u32)1024            /* Max message arena bytes that debug output may hold at once */
+#define DEBUG_STATS_LINE_SIZE          (u32)224             /* Size of the line buffer used to build the messaging reports (longer lines are truncated) */
+#define DEBUG_BENCHMARK_DEPTHS         (u8)2                /* Number of queue depths run for each size by the messaging benchmark */
+#define DEBUG_BENCHMARK_SIZES          (u8)3                /* Number of message sizes run by the messaging benchmark */
 
 /* G_u32DebugFlags */
 #define _DEBUG_LED_TEST_ENABLE         (u32)0x00000001      /* Flag if LED test is enabled */
@@ -59,9 +63,9 @@ typedef struct
 #define DEBUG_CMD_NAME01        "Toggle LED test                 "  /* Command 1: Test that allows characters to toggle LEDs */
 #define DEBUG_CMD_NAME02        "Toggle system timing warning    "  /* Command 2: Prints message if system tick has advanced more than 1 between main loop sleeps (i.e. tasks are taking too long) */
 #define DEBUG_CMD_NAME03        "Dummy3                          "  /* Command 3: */
-#define DEBUG_CMD_NAME04        "Dummy4                          "  /* Command 4: */
-#define DEBUG_CMD_NAME05        "Dummy5                          "  /* Command 5: */
-#define DEBUG_CMD_NAME06        "Dummy6                          "  /* Command 6: */
+#define DEBUG_CMD_NAME04        "Messaging benchmark             "  /* Command 4: Times the arena allocator and queue/status/dequeue for several message sizes */
+#define DEBUG_CMD_NAME05        "Messaging statistics            "  /* Command 5: Prints messaging counters, high-water marks and latency histograms */
+#define DEBUG_CMD_NAME06        "Messaging self test             "  /* Command 6: Runs the messaging stress test and prints PASS or the failed checks */
 #define DEBUG_CMD_NAME07        "Dummy7                          "  /* Command 7: */
 #endif /* EIE1 */
 
@@ -72,9 +76,9 @@ typedef struct
 #define DEBUG_CMD_NAME01        "Toggle LED test                 "  /* Command 1: Test that allows characters to toggle LEDs */
 #define DEBUG_CMD_NAME02        "Toggle system timing warning    "  /* Command 2: Prints message if system tick has advanced more than 1 between main loop sleeps (i.e. tasks are taking too long) */
 #define DEBUG_CMD_NAME03        "Toggle Captouch value display   "  /* Command 2: Test that shows Captouch sense values on debug port */
-#define DEBUG_CMD_NAME04        "Dummy4                          "  /* Command 4: */
-#define DEBUG_CMD_NAME05        "Dummy5                          "  /* Command 5: */
-#define DEBUG_CMD_NAME06        "Dummy6                          "  /* Command 6: */
+#define DEBUG_CMD_NAME04        "Messaging benchmark             "  /* Command 4: Times the arena allocator and queue/status/dequeue for several message sizes */
+#define DEBUG_CMD_NAME05        "Messaging statistics            "  /* Command 5: Prints messaging counters, high-water marks and latency histograms */
+#define DEBUG_CMD_NAME06        "Messaging self test             "  /* Command 6: Runs the messaging stress test and prints PASS or the failed checks */
 #define DEBUG_CMD_NAME07        "Dummy7                          "  /* Command 7: */
 #endif /* EIE1 */
 
@@ -123,6 +127,10 @@ static void DebugCommandDummy(void);
 static void DebugCommandLedTestToggle(void);
 static void DebugLedTestCharacter(u8 u8Char_);
 static void DebugCommandSysTimeToggle(void);
+static void DebugCommandMessagingBenchmark(void);
+static void DebugCommandMessagingStats(void);
+static void DebugCommandMessagingSelfTest(void);
+static void DebugLineAppend(u8* pu8Line_, const u8* pu8Text_);
 
 #ifdef EIE1 /* EIE1-specific debug functions */
 #endif /* EIE1 */
@@ -1242,7 +1242,7 @@ I
 */
 
 /*Interrupt Enable Register*/
-#define TWI0_IER_INIT (u32)0x00000142
+#define TWI0_IER_INIT (u32)0x00000140
 /*
     31-16 [0] Reserved
 
@@ -1262,13 +1262,13 @@ I
     04 [0] SVACC - Slave Access
 
     03 [0] Reserved
-    02 [0] TXRDY - Transmit Holding Register Ready
-    01 [1] RXRDY - Receive Holding Register Ready
-    00 [0] TXCOMP - Transmission Completed
+    02 [0] TXRDY - Transmit Holding Register Ready (enabled per transfer)
+    01 [0] RXRDY - Receive Holding Register Ready (enabled per transfer)
+    00 [0] TXCOMP - Transmission Completed (enabled per transfer)
 */
 
 /*Interrupt Disable Register*/
-#define TWI0_IDR_INIT (u32)0x0000FE35
+#define TWI0_IDR_INIT (u32)0x0000FE37
 /*
     31-16 [0] Reserved
 
@@ -1289,7 +1289,7 @@ I
 
     03 [0] Reserved
     02 [1] TXRDY - Transmit Holding Register Ready
-    01 [0] RXRDY - Receive Holding Register Ready
+    01 [1] RXRDY - Receive Holding Register Ready
     00 [1] TXCOMP - Transmission Completed
 */
 
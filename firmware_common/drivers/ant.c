@@ -79,6 +79,7 @@ u8 G_au8ANTGetVersion[]     = {MESG_REQUEST_SIZE, MESG_REQUEST_ID, 0, MESG_VERSI
 and indicate what file the variable is defined in. */
 extern u32 G_u32SystemFlags;                            /* From main.c */
 extern u32 G_u32ApplicationFlags;                       /* From main.c */
+extern volatile u32 G_u32StartupFlags;                  /* From main.c */
 
 extern volatile u32 G_u32SystemTime1ms;                 /* From board-specific source file */
 extern volatile u32 G_u32SystemTime1s;                  /* From board-specific source file */
@@ -93,6 +94,7 @@ Variable names shall start with "Ant_<type>Name" and be declared as static.
 static fnCode_type Ant_pfnStateMachine;                 /* The ANT state machine function pointer */
 static u32 Ant_u32RxTimer;                              /* Dedicated timer for receiving bytes */
 static u32 Ant_u32TxTimer;                              /* Dedicated timer for transmitting bytes */
+static u32 Ant_u32StartupTimer;                         /* Deadline reference for the AntSM_Startup states */
 
 static u32 Ant_u32TxByteCounter = 0;                    /* Counter counts callbacks on sent bytes */
 static u32 Ant_u32RxByteCounter = 0;                    /* Counter counts callbacks on received bytes */
@@ -137,7 +139,9 @@ static u32 Ant_DebugQueuedDataMessages = 0;
 Function: AntSyncSerialInitialize
 
 Description:
-Properly sets up the ANT SPI interface and tests Host <-> ANT communications.
+Sets up the ANT SPI interface and puts ANT in reset.  Releasing the reset and testing
+Host <-> ANT communications is done by the AntSM_Startup states so the rest of the 
+system can start up in the meantime.
 
 Requires:
   - ANT_SPI is configured
@@ -148,16 +152,11 @@ Promises:
   - Ant_pu8AntRxBufferNextChar is initialized to start of AntRxBuffer
   - Ant_pu8AntRxBufferUnreadMsg is initialized to start of AntRxBuffer
   - Ant_u8AntNewRxMessages = 0;
-  - ANT SSP CS and RX interrupts are enabled
-  - If ANT starts up correctly and responds to version request, then 
-    G_u32SystemFlags _APPLICATION_FLAGS_ANT is set and Ant_u8AntVersion is populated
-    with the returned version information from the ANT IC.  
+  - ANT is held in reset with SRDY and MRDY deasserted
+  - Ant_u32StartupTimer is started and Ant_pfnStateMachine = AntSM_StartupReset
 */
 static void AntSyncSerialInitialize(void)
 {
-  u32 u32EventTimer;
-  bool bErrorStatus = FALSE;
-  
   /* Initialize buffer pointers */  
   Ant_pu8AntRxBufferNextChar    = Ant_au8AntRxBuffer;
   Ant_pu8AntRxBufferCurrentChar = Ant_au8AntRxBuffer;
@@ -165,36 +164,74 @@ static void AntSyncSerialInitialize(void)
   Ant_u8AntNewRxMessages = 0;
  
   /* Reset the 51422 and initialize SRDY and MRDY */
-  u32EventTimer = G_u32SystemTime1ms;
+  Ant_u32StartupTimer = G_u32SystemTime1ms;
   ANT_RESET_ASSERT();
   SYNC_MRDY_DEASSERT();
   SYNC_SRDY_DEASSERT();
-  while( !IsTimeUp(&u32EventTimer, ANT_RESET_WAIT_MS) );
-  ANT_RESET_DEASSERT();
-  u32EventTimer = G_u32SystemTime1ms;
-  while( !IsTimeUp(&u32EventTimer, ANT_RESTART_DELAY_MS) );
+  Ant_pfnStateMachine = AntSM_StartupReset;
+ 
+} /* end AntSyncSerialInitialize */
 
-  
-  /* ANT should want to send message 0x6F now to indicate it has reset */
-  u32EventTimer = G_u32SystemTime1ms;
-  while( !IS_SEN_ASSERTED() && !bErrorStatus )
+
+/*------------------------------------------------------------------------------
+Function: AntStartupComplete
+
+Description:
+Ends the ANT startup: reports the result and either starts the ANT task or shuts 
+down the interface.
+
+Requires:
+  - The AntSM_Startup states are done: _APPLICATION_FLAGS_ANT is set if ANT answered
+    the version request
+
+Promises:
+  - The result is reported on the debug port
+  - If ANT is good, Ant_pfnStateMachine = AntSM_Idle
+  - Otherwise the ANT interface lines are floated and Ant_pfnStateMachine = AntSM_NoResponse
+  - _APPLICATION_FLAGS_ANT is cleared in G_u32StartupFlags
+*/
+static void AntStartupComplete(void)
+{
+  u32 u32AntPortAPins, u32AntPortBPins;
+
+  /* Report status out the debug port */
+  DebugPrintf(G_au8AntMessageInit);
+  if(G_u32ApplicationFlags & _APPLICATION_FLAGS_ANT)  
   {
-    bErrorStatus = IsTimeUp(&u32EventTimer, ANT_MSG_TIMEOUT_MS);
+    DebugPrintf(G_au8AntMessageOk);
+    DebugPrintf("ANT version: ");
+    DebugPrintf(Ant_u8AntVersion);
+    DebugLineFeed();
+    
+    G_u32AntFlags &= ~_ANT_FLAGS_RESTART;
+    Ant_pfnStateMachine = AntSM_Idle;
   }
-
-  if (!bErrorStatus)
+  else
   {
-    /* Receive and process the restart message */
-    AntRxMessage();
-    AntProcessMessage();   
-
-  /* Send out version request message and expect response */
-    G_au8ANTGetVersion[4] = AntCalculateTxChecksum(&G_au8ANTGetVersion[0]);
-    AntTxMessage(&G_au8ANTGetVersion[0]);    
-    AntExpectResponse(MESG_VERSION_ID, ANT_MSG_TIMEOUT_MS);
+    /* The ANT device is not responding -- it may be dead, or it may not yet
+    be loaded with any firmware.  Regardless, float all of the interface lines so 
+    that any programmer or other firmware will not be impacted by the Host MCU */
+    DebugPrintf(G_au8AntMessageInitFail);
+
+    /* Make sure all ANT pins are on the PIO controller */
+    u32AntPortAPins = ANT_PIOA_PINS;
+    u32AntPortBPins = ANT_PIOB_PINS;
+    
+    AT91C_BASE_PIOA->PIO_PDR = u32AntPortAPins;
+    AT91C_BASE_PIOA->PIO_PER = u32AntPortAPins;
+    AT91C_BASE_PIOB->PIO_PDR = u32AntPortBPins;
+    AT91C_BASE_PIOB->PIO_PER = u32AntPortBPins;
+
+    /* Disable all outputs (set to HiZ input) */
+    AT91C_BASE_PIOA->PIO_ODR = u32AntPortAPins;
+    AT91C_BASE_PIOB->PIO_ODR = u32AntPortBPins;
+    
+    Ant_pfnStateMachine = AntSM_NoResponse;
   }
- 
-} /* end AntSyncSerialInitialize */
+  
+  G_u32StartupFlags &= ~_APPLICATION_FLAGS_ANT;
+  
+} /* end AntStartupComplete() */
 
 
 /*-----------------------------------------------------------------------------
@@ -606,8 +643,9 @@ static bool AntParseExtendedData(u8* pu8SourceMessage, AntExtendedDataType* psEx
 Function: AntInitialize
 
 Description:
-Intialize the ANT system.  ANT device is reset and communication checked through
-a version request.  The main channel parameters are then set up to default values.
+Intialize the ANT system.  The main channel parameters are set up to default values
+and the ANT device is put in reset.  The startup states then release the reset and 
+check communication through a version request.
   
 Requires:
   - ANT_SPI peripheral is correctly configured
@@ -615,13 +653,13 @@ Requires:
 
 Promises:
   - G_stAntSetupData set to default ANT values
-  - If all successful, G_u32SystemFlags.AntGood bit is set and ANT system is ready
-  - Ant_pfnStateMachine = AntSM_Idle
+  - _APPLICATION_FLAGS_ANT is set in G_u32StartupFlags until the startup states finish;
+    if all successful, G_u32ApplicationFlags _APPLICATION_FLAGS_ANT is then set and
+    ANT system is ready
+  - Ant_pfnStateMachine = AntSM_StartupReset (or AntSM_NoResponse if ANT is disabled)
 */
 void AntInitialize(void)
 {
-  u32 u32AntPortAPins, u32AntPortBPins;
-
   if(G_u32SystemFlags & _SYSTEM_STARTUP_NO_ANT)
   {
     DebugPrintf(G_au8AntMessageNoAnt);
@@ -632,8 +670,7 @@ void AntInitialize(void)
     /* Give PIO control of ANT_RESET line */
     AT91C_BASE_PIOB->PIO_OER = PB_21_ANT_RESET;
     
-    /* Announce on the debug port that ANT setup is starting and intialize pointers */
-    DebugPrintf(G_au8AntMessageInit);
+    /* Intialize pointers (AntStartupComplete() announces the result on the debug port) */
     G_sAntApplicationMsgList = 0;
     Ant_psDataOutgoingMsgList = 0;
   
@@ -670,47 +707,19 @@ void AntInitialize(void)
     Ant_sSspConfig.pu8RxBufferAddress = Ant_au8AntRxBuffer;
     Ant_sSspConfig.ppu8RxNextByte     = &Ant_pu8AntRxBufferNextChar;
     Ant_sSspConfig.u16RxBufferSize    = ANT_RX_BUFFER_SIZE;
+    Ant_sSspConfig.eTxPriority        = MSG_PRIORITY_HIGH;
+    Ant_sSspConfig.u32TxByteQuota     = 0;
+    Ant_sSspConfig.u32ModeRegister    = 0;
+    Ant_sSspConfig.u32BaudRateRegister = 0;
 
     Ant_Ssp = SspRequest(&Ant_sSspConfig);
     ANT_SSP_FLAGS = 0;
     
-    /* Reset ANT, activate SPI interface and get a test message */
+    /* Reset ANT and activate SPI interface: the startup states get a test message */
     AntSyncSerialInitialize();
-    
-    /* Report status out the debug port */
-    if(G_u32ApplicationFlags & _APPLICATION_FLAGS_ANT)  
-    {
-      DebugPrintf(G_au8AntMessageOk);
-      DebugPrintf("ANT version: ");
-      DebugPrintf(Ant_u8AntVersion);
-      DebugLineFeed();
-      
-      G_u32AntFlags &= ~_ANT_FLAGS_RESTART;
-      Ant_pfnStateMachine = AntSM_Idle;
-    }
-    else
-    {
-      /* The ANT device is not responding -- it may be dead, or it may not yet
-      be loaded with any firmware.  Regardless, float all of the interface lines so 
-      that any programmer or other firmware will not be impacted by the Host MCU */
-      DebugPrintf(G_au8AntMessageInitFail);
-
-      /* Make sure all ANT pins are on the PIO controller */
-      u32AntPortAPins = ANT_PIOA_PINS;
-      u32AntPortBPins = ANT_PIOB_PINS;
-      
-      AT91C_BASE_PIOA->PIO_PDR = u32AntPortAPins;
-      AT91C_BASE_PIOA->PIO_PER = u32AntPortAPins;
-      AT91C_BASE_PIOB->PIO_PDR = u32AntPortBPins;
-      AT91C_BASE_PIOB->PIO_PER = u32AntPortBPins;
-
-      /* Disable all outputs (set to HiZ input) */
-      AT91C_BASE_PIOA->PIO_ODR = u32AntPortAPins;
-      AT91C_BASE_PIOB->PIO_ODR = u32AntPortBPins;
-      
-      Ant_pfnStateMachine = AntSM_NoResponse;
-    }
+    G_u32StartupFlags |= _APPLICATION_FLAGS_ANT;
   }
+  
 } /* end AntInitialize() */
 
 
@@ -884,8 +893,8 @@ Requires:
   - A message had been sent to ANT to which a response should be coming in
   - Ant_u8AntNewRxMessages == 0 as this function is meant to run one-to-one with
     transmitted messages.
-  - SSP task should be in manual mode so it is busy sending the Tx message to which
-    this function will wait for the ANT response.
+  - The SSP task is sending the Tx message (from its interrupts) to which this 
+    function will wait for the ANT response.
 
 Promises:
   - Returns 0 if the message is received and was successful
@@ -1762,3 +1771,97 @@ void AntSM_NoResponse(void)
 {
   
 } /* end AntSM_NoResponse() */
+
+
+/*------------------------------------------------------------------------------
+Startup: hold ANT in reset for ANT_RESET_WAIT_MS and then release it.
+*/
+void AntSM_StartupReset(void)
+{
+  if( IsTimeUp(&Ant_u32StartupTimer, ANT_RESET_WAIT_MS) )
+  {
+    ANT_RESET_DEASSERT();
+    Ant_u32StartupTimer = G_u32SystemTime1ms;
+    Ant_pfnStateMachine = AntSM_StartupRestart;
+  }
+  
+} /* end AntSM_StartupReset() */
+
+
+/*------------------------------------------------------------------------------
+Startup: give ANT ANT_RESTART_DELAY_MS to come out of reset.  The other tasks 
+keep starting up during this time.
+*/
+void AntSM_StartupRestart(void)
+{
+  if( IsTimeUp(&Ant_u32StartupTimer, ANT_RESTART_DELAY_MS) )
+  {
+    Ant_u32StartupTimer = G_u32SystemTime1ms;
+    Ant_pfnStateMachine = AntSM_StartupRestartMessage;
+  }
+  
+} /* end AntSM_StartupRestart() */
+
+
+/*------------------------------------------------------------------------------
+Startup: ANT should want to send message 0x6F now to indicate it has reset.  Read 
+it and send the version request.
+*/
+void AntSM_StartupRestartMessage(void)
+{
+  if( IS_SEN_ASSERTED() )
+  {
+    /* Receive and process the restart message */
+    AntRxMessage();
+    AntProcessMessage();   
+
+    /* Send out version request message and expect response.  If ANT interrupts the
+    request with a message of its own, stay here to read that message and try again. */
+    G_au8ANTGetVersion[4] = AntCalculateTxChecksum(&G_au8ANTGetVersion[0]);
+    if( AntTxMessage(&G_au8ANTGetVersion[0]) )
+    {
+      Ant_u32StartupTimer = G_u32SystemTime1ms;
+      Ant_pfnStateMachine = AntSM_StartupVersion;
+    }
+  }
+  else if( IsTimeUp(&Ant_u32StartupTimer, ANT_MSG_TIMEOUT_MS) )
+  {
+    AntStartupComplete();
+  }
+  
+} /* end AntSM_StartupRestartMessage() */
+
+
+/*------------------------------------------------------------------------------
+Startup: wait for the version request to finish sending (SEN released) and then
+for the response.  AntProcessMessage() sets _APPLICATION_FLAGS_ANT if the version
+message arrives.
+*/
+void AntSM_StartupVersion(void)
+{
+  /* Done with the request message token once ANT releases SEN */
+  if( Ant_u32CurrentTxMessageToken != 0 )
+  {
+    if( !IS_SEN_ASSERTED() )
+    {
+      G_u32AntFlags &= ~_ANT_FLAGS_TX_IN_PROGRESS;
+      AntDeQueueOutgoingMessage();
+      Ant_u32CurrentTxMessageToken = 0;
+      Ant_u32StartupTimer = G_u32SystemTime1ms;
+    }
+  }
+  /* Then read the response */
+  else if( IS_SEN_ASSERTED() )
+  {
+    AntRxMessage();
+    AntProcessMessage();
+    AntStartupComplete();
+    return;
+  }
+  
+  if( IsTimeUp(&Ant_u32StartupTimer, ANT_MSG_TIMEOUT_MS) )
+  {
+    AntStartupComplete();
+  }
+  
+} /* end AntSM_StartupVersion() */
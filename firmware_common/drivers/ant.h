@@ -231,6 +231,7 @@ typedef struct
 
 /* ANT Private Serial-layer Functions */
 static void AntSyncSerialInitialize(void);
+static void AntStartupComplete(void);
 static void AntSrdyPulse(void);
 static void AntRxMessage(void);
 static void AntAbortMessage(void);
@@ -266,5 +267,9 @@ void AntSM_Idle(void);
 void AntSM_ReceiveMessage(void);
 void AntSM_TransmitMessage(void);
 void AntSM_NoResponse(void);
+void AntSM_StartupReset(void);
+void AntSM_StartupRestart(void);
+void AntSM_StartupRestartMessage(void);
+void AntSM_StartupVersion(void);
 
 #endif /* __ANT_H */
\ No newline at end of file
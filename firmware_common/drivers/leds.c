@@ -68,12 +68,15 @@ extern volatile u32 G_u32SystemTime1ms;                /* From board-specific so
 extern volatile u32 G_u32SystemTime1s;                 /* From board-specific source file */
 
 extern volatile u32 G_u32ApplicationFlags;             /* From main.c */
+extern volatile u32 G_u32StartupFlags;                 /* From main.c */
 
 
 /***********************************************************************************************************************
 Global variable definitions with scope limited to this local application.
 Variable names shall start with "Led_" and be declared as static.
 ***********************************************************************************************************************/
+static u8 Led_u8StartupLevel;                          /* PWM level of the startup fade */
+static u32 Led_u32StartupTimer;                        /* Time reference for the current startup fade level */
 
 /************ %LED% EDIT BOARD-SPECIFIC GPIO DEFINITIONS BELOW ***************/
 
@@ -312,26 +315,18 @@ void LedBlink(LedNumberType eLED_, LedRateType eBlinkRate_)
 Function: LedInitialize
 
 Description:
-Initialization of LED system paramters and visual LED check.
+Initialization of LED system paramters and start of the visual LED check.  The fade itself is run
+by LedStartupSequence() so other drivers can start up at the same time.
 
 Requires:
   - G_u32SystemTime1ms ticking
-  - All LEDs already initialized to LED_NORMAL_MODE mode ON
+  - All LEDs already initialized to LED_PWM_MODE at LED_PWM_100
 
 Promises:
-  - All LEDs in LED_NORMAL_MODE mode with OFF
+  - The startup fade is started and _APPLICATION_FLAGS_LED is set in G_u32StartupFlags until it finishes
 */
 void LedInitialize(void)
 {
-  u32 u32Timer;
-  u8  u8Index;
-
-  u32 u32Buzzer1Frequency = 4000;
-  u32 u32Buzzer2Frequency = 500;
-  u32 u32StepSize = (u32Buzzer1Frequency - u32Buzzer2Frequency) / 20;
-
-  static u8 au8LedStartupMsg[] = "LED functions ready\n\r";
-
 #if MPGL2
   /* Test code for checking LEDs */
 #if 0
@@ -351,82 +346,21 @@ void LedInitialize(void)
 
 #endif /* MPGL2 */
   
-  /* Turn all LEDs on full, then fade them out over a few seconds */
-  for(u8Index = 20; u8Index > 0; u8Index--)
-  {
-#ifdef STARTUP_SOUND
-    /* Configure Buzzers to provide some audio during start up */
-    PWMAudioSetFrequency(BUZZER1, u32Buzzer1Frequency);
-    PWMAudioOn(BUZZER1);
-#ifdef  EIE1
-    PWMAudioSetFrequency(BUZZER2, u32Buzzer2Frequency);
-    PWMAudioOn(BUZZER2);
-#endif /* EIE1 */
-#endif /* STARTUP_SOUND */
-    
-    /* Spend a little bit of time in each level of intensity */
-    for(u16 j = 20; j > 0; j--)
-    {
-      u32Timer = G_u32SystemTime1ms;
-      while( !IsTimeUp(&u32Timer, 1) );
-      LedUpdate();
-    }
-    /* Pause for a bit on the first iteration to show the LEDs on for little while */
-    if(u8Index == 20)
-    {
-      while( !IsTimeUp(&u32Timer, 200) );
-    }
-    
-    /* Set the LED intensity for the next iteration */
-    for(u8 j = 0; j < TOTAL_LEDS; j++)
-    {
-      Leds_asLedArray[j].eRate = (LedRateType)(u8Index - 1);
-    }
-    
-    /* Set the buzzer frequency for the next iteration */
-    u32Buzzer1Frequency -= u32StepSize;
-    u32Buzzer2Frequency += u32StepSize;
-  }
-
-  /* Final update to set last state, hold for a short period */
-  LedUpdate();
-  while( !IsTimeUp(&u32Timer, 200) );
+  /* All LEDs start on full; LedStartupSequence() fades them out from LedUpdate() */
+  Led_u8StartupLevel = LED_STARTUP_LEVELS;
+  Led_u32StartupTimer = G_u32SystemTime1ms;
   
 #ifdef STARTUP_SOUND
-  /* Turn off the buzzers */
-  PWMAudioOff(BUZZER1);
+  /* Configure Buzzers to provide some audio during start up */
+  PWMAudioSetFrequency(BUZZER1, LED_STARTUP_BUZZER1_HZ);
+  PWMAudioOn(BUZZER1);
 #ifdef  EIE1
-  PWMAudioOff(BUZZER2);
+  PWMAudioSetFrequency(BUZZER2, LED_STARTUP_BUZZER2_HZ);
+  PWMAudioOn(BUZZER2);
 #endif /* EIE1 */
-  
 #endif /* STARTUP_SOUND */
 
- 
-  /* The discrete LEDs are off and the backlight is on (white) -- this
-  is how we will exit the LED init.  But should we set all the LEDs to
-  NORMAL mode?  This would solve the LedToggle() problem described in 
-  LedBasic module.  So if the code below is added, then the module
-  information must be updated. */
-#if 0 
-  for(u8 i = 0; i < TOTAL_LEDS; i++)
-  {
-    Leds_asLedArray[i].eMode = LED_NORMAL_MODE;
-  }
-#endif
-
-#ifdef EIE1
-  LedOn(LCD_RED);
-  LedOn(LCD_GREEN);
-  LedOn(LCD_BLUE);
-#endif
-  
-#ifdef MPGL2
-  LedOn(LCD_BL);
-#endif
-
-  /* Final setup and report that LED system is ready */
-  G_u32ApplicationFlags |= _APPLICATION_FLAGS_LED;
-  DebugPrintf(au8LedStartupMsg);
+  G_u32StartupFlags |= _APPLICATION_FLAGS_LED;
   
 } /* end LedInitialize() */
 
@@ -505,9 +439,115 @@ void LedUpdate(void)
       }
     }
   } /* end for */
+  
+  /* Step the startup fade until it is done */
+  if(G_u32StartupFlags & _APPLICATION_FLAGS_LED)
+  {
+    LedStartupSequence();
+  }
+  
 } /* end LedUpdate() */
 
 
+/*----------------------------------------------------------------------------------------------------------------------
+Function: LedStartupSequence
+
+Description:
+Fades all of the LEDs from full on to off: full on is held for a little while, then each lower PWM level
+is shown for LED_STARTUP_LEVEL_TIME_MS and off is held before the sequence ends.
+
+Requires:
+  - LedInitialize() has started the sequence
+  - Called every 1ms while _APPLICATION_FLAGS_LED is set in G_u32StartupFlags
+
+Promises:
+  - All PWMing LEDs are stepped down one level each time the current level has been shown long enough
+  - When the sequence ends, the buzzers are off, the backlight is on, _APPLICATION_FLAGS_LED is set in 
+    G_u32ApplicationFlags and cleared in G_u32StartupFlags
+*/
+static void LedStartupSequence(void)
+{
+  u32 u32LevelTime = LED_STARTUP_LEVEL_TIME_MS;
+  static u8 au8LedStartupMsg[] = "LED functions ready\n\r";
+
+  /* Spend a little more time on the first and last levels to show the LEDs on and off */
+  if(Led_u8StartupLevel == LED_STARTUP_LEVELS)
+  {
+    u32LevelTime += LED_STARTUP_HOLD_TIME_MS;
+  }
+  else if(Led_u8StartupLevel == 0)
+  {
+    u32LevelTime = LED_STARTUP_HOLD_TIME_MS;
+  }
+  
+  if( !IsTimeUp(&Led_u32StartupTimer, u32LevelTime) )
+  {
+    return;
+  }
+  
+  Led_u32StartupTimer = G_u32SystemTime1ms;
+  
+  /* Set the LED intensity (and buzzer frequency) for the next level */
+  if(Led_u8StartupLevel != 0)
+  {
+    Led_u8StartupLevel--;
+    for(u8 i = 0; i < TOTAL_LEDS; i++)
+    {
+      Leds_asLedArray[i].eRate = (LedRateType)Led_u8StartupLevel;
+    }
+    
+#ifdef STARTUP_SOUND
+    if(Led_u8StartupLevel != 0)
+    {
+      PWMAudioSetFrequency(BUZZER1, LED_STARTUP_BUZZER1_HZ - ((LED_STARTUP_LEVELS - Led_u8StartupLevel) * LED_STARTUP_BUZZER_STEP_HZ));
+#ifdef  EIE1
+      PWMAudioSetFrequency(BUZZER2, LED_STARTUP_BUZZER2_HZ + ((LED_STARTUP_LEVELS - Led_u8StartupLevel) * LED_STARTUP_BUZZER_STEP_HZ));
+#endif /* EIE1 */
+    }
+#endif /* STARTUP_SOUND */
+
+    return;
+  }
+
+#ifdef STARTUP_SOUND
+  /* Turn off the buzzers */
+  PWMAudioOff(BUZZER1);
+#ifdef  EIE1
+  PWMAudioOff(BUZZER2);
+#endif /* EIE1 */
+  
+#endif /* STARTUP_SOUND */
+
+  /* The discrete LEDs are off and the backlight is on (white) -- this
+  is how we will exit the LED init.  But should we set all the LEDs to
+  NORMAL mode?  This would solve the LedToggle() problem described in 
+  LedBasic module.  So if the code below is added, then the module
+  information must be updated. */
+#if 0 
+  for(u8 i = 0; i < TOTAL_LEDS; i++)
+  {
+    Leds_asLedArray[i].eMode = LED_NORMAL_MODE;
+  }
+#endif
+
+#ifdef EIE1
+  LedOn(LCD_RED);
+  LedOn(LCD_GREEN);
+  LedOn(LCD_BLUE);
+#endif
+  
+#ifdef MPGL2
+  LedOn(LCD_BL);
+#endif
+
+  /* Final setup and report that LED system is ready */
+  G_u32ApplicationFlags |= _APPLICATION_FLAGS_LED;
+  G_u32StartupFlags &= ~_APPLICATION_FLAGS_LED;
+  DebugPrintf(au8LedStartupMsg);
+  
+} /* end LedStartupSequence() */
+
+
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -67,6 +67,13 @@ typedef struct
 ******************************************************************************/
 #define LED_INIT_MSG_TIMEOUT            (u32)1000     /* Time in ms for init message to send */
 
+#define LED_STARTUP_LEVELS              (u8)LED_PWM_100  /* PWM level the startup fade begins at */
+#define LED_STARTUP_LEVEL_TIME_MS       (u32)20       /* Time in ms each level of the startup fade is shown */
+#define LED_STARTUP_HOLD_TIME_MS        (u32)200      /* Extra time in ms at full on, and time fully off, before the fade ends */
+#define LED_STARTUP_BUZZER1_HZ          (u32)4000     /* BUZZER1 frequency at the start of the fade */
+#define LED_STARTUP_BUZZER2_HZ          (u32)500      /* BUZZER2 frequency at the start of the fade */
+#define LED_STARTUP_BUZZER_STEP_HZ      (u32)((LED_STARTUP_BUZZER1_HZ - LED_STARTUP_BUZZER2_HZ) / LED_STARTUP_LEVELS)
+
 
 /******************************************************************************
 * Function Declarations
@@ -83,6 +90,7 @@ void LedInitialize(void);
 
 /* Private Functions */
 void LedUpdate(void);
+static void LedStartupSequence(void);
 
 
 /******************************************************************************
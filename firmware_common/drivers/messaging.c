@@ -17,33 +17,104 @@ EMPTY, WAITING, SENDING, RECEIVING, COMPLETE, TIMEOUT, ABANDONED, NOT_FOUND
 
 MessageType: linked-list style entry with token, size, data pointer and next MessageType pointer
 
-MessageSlot: member of the message queue holding the free/full status of a particular queue location and a pointer to its data
+MessageQueueType: a peripheral's transmit queue holding head and tail MessageType pointers, the number of messages queued
+and the priority class and byte quota of the client using it
+
+MessagePriorityType: MSG_PRIORITY_LOW, MSG_PRIORITY_NORMAL, MSG_PRIORITY_HIGH
+
+MessageBlockType: header of a message in the arena holding the message, the block size and its free and sending flags
 
 MessageStatus: token, state and timestamp of a message in the queue
 
+MessageScavengerStatsType: counts of messages timed out, abandoned and status entries aged out by the scavenger
+
+MessagingStatsType: enqueue, dequeue and refusal counters and arena high-water marks
+
+MessageLatencyType: a queue's queued-to-SENDING and SENDING-to-COMPLETE latency histograms
+
 FUNCTIONS
 Public:
 MessageStateType QueryMessageStatus(u32 u32Token_)
 Queries the current status of the message with u32Token.  If the message has completed or timed out, the query will
-cause the message status to be removed from the status queue.
+cause the message status to be removed from the status queue.  Statusi are stored at index (u32Token & STATUS_QUEUE_MASK)
+so the lookup time does not depend on STATUS_QUEUE_SIZE.
+
+bool SetMessageNotification(u32 u32Token_, fnMessageNotify_type pfnNotify_, volatile u32* pu32EventFlags_, u32 u32EventMask_)
+Registers a callback and/or event bits for a queued message so the client is told as soon as the message reaches
+COMPLETE, TIMEOUT or ABANDONED instead of polling QueryMessageStatus every loop.  The callback usually runs in 
+the peripheral's interrupt so it must be short.
+
+void MessagingGetScavengerStats(MessageScavengerStatsType* psStats_)
+Copies the scavenger totals.  MessagingIdle enforces the MSG_STATUS_* times a few entries per ms: a message stuck 
+at the head of a queue is marked TIMEOUT, messages waiting behind it are ABANDONED and their arena space 
+reclaimed, and final status entries that no client queried are removed.
 
 Protected:
 void MessagingInitialize(void)
 One-time call to start the messaging application.
 
-u32 QueueMessage(MessageType** ppeTargetTxBuffer_, u32 u32MessageSize_, u8* pu8MessageData_)
+void InitializeMessageQueue(MessageQueueType* psQueue_)
+Sets a peripheral's transmit queue to empty.  Must be called before the queue is first used.
+
+void RegisterMessageQueue(MessageQueueType* psQueue_)
+Lets the scavenger reclaim stale messages from a queue.  Only for drivers that keep no per-message state of their own.
+
+void SetMessageQueuePriority(MessageQueueType* psQueue_, MessagePriorityType ePriority_, u32 u32ByteQuota_)
+Sets the priority class and arena byte quota of a queue.  LOW and NORMAL queues cannot use the last MSG_RESERVE_LOW
+and MSG_RESERVE_NORMAL bytes of the arena, so a flood of low priority messages (e.g. debug prints) fails with 
+_MESSAGING_TX_QUOTA_FULL while HIGH priority clients can still queue.
+
+void MessagingGetStats(MessagingStatsType* psStats_)
+bool MessagingGetLatency(u8 u8QueueId_, MessageLatencyType* psLatency_)
+void MessagingResetStats(void)
+Snapshot and clear the telemetry.  Use the high-water marks to size MSG_ARENA_SIZE and the latency histograms 
+(one per queue, ids assigned in the order the drivers call InitializeMessageQueue) to find slow peripherals.
+
+u32 QueueMessage(MessageQueueType* psTargetQueue_, u32 u32MessageSize_, u8* pu8MessageData_)
 Adds a message to the correct data queue, assigns a token which is posted to the status queue and returned to the client.
 This function is Protected because tasks that can queue messages should be managed carefully and not granted free reign
-to queue messages.  The message queue is a finite resource with TX_QUEUE_SIZE slots available for messages.
-We avoid dynamic allocation due to the inherent issues with fragmentation on resource-limited systems.
-
-void DeQueueMessage(MessageType** pTargetQueue_)
+to queue messages.  The message queue is a finite resource of MSG_ARENA_SIZE bytes that is allocated as a ring:
+blocks are taken at the head and returned at the tail, so no fragmentation occurs.  We avoid dynamic allocation 
+due to the inherent issues with fragmentation on resource-limited systems.  A payload longer than 
+MAX_TX_MESSAGE_LENGTH is split in to several messages that are sent back to back; the token of the last part is
+returned.
+
+u32 QueueMessageReference(MessageQueueType* psTargetQueue_, u32 u32MessageSize_, u8* pu8MessageData_)
+Same as QueueMessage but the data is not copied: the peripheral transmits straight from the caller's buffer which
+must not change until the message status is COMPLETE or ABANDONED.
+
+u32 IssueMessageToken(u8 u8QueueId_)
+Assigns the next token and posts it to the status queue without using the arena.  For drivers that keep their
+own message storage (the TWI descriptor ring) but still report status through tokens.  Tokens whose status entry
+still holds a live message are skipped, so a token is unique but not always one more than the last.
+
+void DeQueueMessage(MessageQueueType* psTargetQueue_)
 Removes a message from the message queue (typically since all the bytes have been submitted to the communication peripheral
 which is sending the message.  The message status is updated in the status queue.
+Queues are single producer (the main loop) / single consumer (the peripheral) lists that are updated with 
+LDREX/STREX, so ISRs can dequeue while the main loop is adding messages without either side disabling interrupts.
+Messages must therefore only be queued from the main loop.
 
 void UpdateMessageStatus(u32 u32Token_, MessageStateType eNewState_)
 Changes the status of a message in the statue queue.
 
+void MarkMessageSending(MessageType* psMessage_)
+Sets a queued message to SENDING and flags its arena block as in use by the peripheral's PDC.  Peripherals must 
+use this rather than UpdateMessageStatus() for SENDING so the scavenger can tell from the block itself that the 
+message must not be reclaimed.
+
+u32 MessagingBenchmark(void)
+Times MSG_BENCHMARK_CYCLES block allocate/release pairs and returns the average time per operation in ns.
+
+bool MessagingBenchmarkQueue(u32 u32MessageSize_, u32 u32Depth_, MessagingBenchmarkType* psResult_)
+Times QueueMessage, status update/query and DeQueueMessage for one message size and queue depth.  Run it for a 
+spread of sizes and depths to get a baseline that future messaging changes can be compared against.
+
+u32 MessagingSelfTest(void)
+Randomized stress test over several private queues that checks token sequence and uniqueness across the
+0xFFFFFFFF rollover, message status, payload integrity and that every arena block is accounted for.
+Returns 0 on a pass.  The benchmark and self test only run when no messages are queued.
+
 **********************************************************************************************************************/
 
 #include "configuration.h"
@@ -71,14 +142,51 @@ Variable names shall start with "Msg_" and be declared as static.
 static fnCode_type Messaging_pfnStateMachine;            /* The state machine function pointer */
 static u32 Msg_u32Token;                                 /* Incrementing message token used for all external communications */
 
-static MessageSlot Msg_Pool[TX_QUEUE_SIZE];              /* Array of MessageSlot used for the transmit queue */
-static u8 Msg_u8QueuedMessageCount;                      /* Number of messages slots currently occupied */
-
-/* A separate status queue needs to be maintained since the message information in Msg_Pool will be lost when the message
+/* The arena is a byte ring: blocks are allocated at Msg_u32ArenaHead and reclaimed in order from Msg_u32ArenaTail.
+Peripherals can finish out of order, so a dequeued block is only marked free until every older block is also free.
+When a block does not fit above the head it is placed at the bottom of the arena and Msg_u32ArenaWrap remembers
+where the blocks at the top end.  Each block is contiguous so a message is always a single PDC transfer. 
+Peripheral ISRs only ever set bFree: the head, tail, wrap and count below are owned by the main loop, which 
+reclaims free blocks just before it allocates, so the arena needs no critical sections. */
+static u32 Msg_au32Arena[MSG_ARENA_SIZE / 4];            /* Message arena (declared as u32 for alignment) */
+static u32 Msg_u32ArenaHead;                             /* Byte offset where the next block will be allocated */
+static u32 Msg_u32ArenaTail;                             /* Byte offset of the oldest block in the arena */
+static u32 Msg_u32ArenaWrap;                             /* Byte offset where the top blocks end once the head has wrapped; MSG_ARENA_SIZE otherwise */
+static u16 Msg_u16QueuedMessageCount;                    /* Number of blocks in the arena that have not been reclaimed */
+
+/* The ring the allocator works in.  The host test build overrides these so its allocator sweep can run over a 
+larger arena of its own (see messaging_host.c). */
+#ifndef MSG_ALLOCATOR_BASE
+#define MSG_ALLOCATOR_BASE              ((u8*)Msg_au32Arena)
+#define MSG_ALLOCATOR_SIZE              MSG_ARENA_SIZE
+#endif
+
+/* A separate status queue needs to be maintained since the message information in the arena will be lost when the message
 has been dequeued.  Applications must be able to query to determine the status of their message, particularly if
-it has been sent. */
+it has been sent.  The queue is indexed directly by the low bits of the token; the full token stored in the entry
+confirms that the entry still belongs to that message and has not been reused by a newer token. */
 static MessageStatus Msg_StatusQueue[STATUS_QUEUE_SIZE]; /* Array of MessageStatus used to monitor message status */
-static MessageStatus* Msg_pNextStatus;                   /* Pointer to next available message status */
+
+/* A message that stays queued can be passed by any number of newer tokens, so IssueMessageToken() skips tokens whose
+entry still holds a WAITING, SENDING or RECEIVING message and refuses a token only if every entry is live.  That 
+cannot happen while the queue has an entry for every message that can be live at once: the arena full of header-only
+(reference) blocks plus a full ring of IssueMessageToken() messages.  The array size goes negative (a compile error)
+if STATUS_QUEUE_SIZE is too small. */
+typedef u8 Msg_StatusQueueSizeCheck[(STATUS_QUEUE_SIZE >= ((MSG_ARENA_SIZE / sizeof(MessageBlockType)) + MSG_ISSUED_TOKENS)) ? 1 : -1];
+
+/* Every transmit queue is registered so MessagingIdle can find messages stuck behind a peripheral that has stopped */
+static MessageQueueType* Msg_apsQueues[MSG_MAX_QUEUES];  /* Registered transmit queues */
+static u8 Msg_u8QueueCount;                              /* Number of entries used in Msg_apsQueues */
+static u8 Msg_u8ScavengeQueueIndex;                      /* Next queue in Msg_apsQueues that the scavenger will check */
+static u16 Msg_u16ScavengeStatusIndex;                   /* Next entry in Msg_StatusQueue that the scavenger will check */
+static MessageScavengerStatsType Msg_sScavengerStats;    /* Scavenger totals */
+
+static MessagingStatsType Msg_sStats;                    /* Telemetry totals */
+static MessageLatencyType Msg_asLatency[MSG_MAX_QUEUES]; /* Latency histograms indexed by MessageQueueType.u8QueueId */
+static u32 Msg_u32SnapshotGuard;                         /* LDREX/STREX target that detects an ISR during a telemetry copy */
+static u8 Msg_u8QueueIdCount;                            /* Number of queue ids handed out */
+
+static const u8 Msg_au8BenchmarkData[MAX_TX_MESSAGE_LENGTH] = {0}; /* Payload source for MessagingBenchmarkQueue() */
 
 
 /**********************************************************************************************************************
@@ -94,8 +202,8 @@ Function: QueryMessageStatus()
 
 Description:
 Checks the state of a message.  If the state is COMPLETE or TIMEOUT, the status is deleted from the message queue.
-Since the queue is quite short, most of the time it will hold very little entires.  New entries are always filled at the front,
-using a simple linear search starting at index 0.
+The status entry is found directly from the token, so no search is required.  If the entry holds a different
+token then the status has been overwritten by a newer message (or cleared) and NOT_FOUND is returned.
 
 Requires:
   - u32Token_ is the token of the message of interest
@@ -106,27 +214,20 @@ Promises:
 */
 MessageStateType QueryMessageStatus(u32 u32Token_)
 {
-  MessageStateType eStatus   = NOT_FOUND;
-  MessageStatus* pListParser = &Msg_StatusQueue[0];
+  MessageStateType eStatus = NOT_FOUND;
+  MessageStatus* psStatus  = &Msg_StatusQueue[u32Token_ & STATUS_QUEUE_MASK];
   
-  /* Brute force search for the token - the queue will never be large enough on this system to require a more
-  intelligent search algorithm */
-  while( (pListParser->u32Token != u32Token_) && (pListParser != &Msg_StatusQueue[STATUS_QUEUE_SIZE]) )
-  {
-    pListParser++;
-  }
-
-  /* If the token was found pListParser is pointing at it, take appropriate action */
-  if(pListParser != &Msg_StatusQueue[STATUS_QUEUE_SIZE])
+  /* If the entry still belongs to this token, take appropriate action */
+  if(psStatus->u32Token == u32Token_)
   {
     /* Save the status */
-    eStatus = pListParser->eState;
+    eStatus = (MessageStateType)psStatus->u8State;
 
     /* Release the slot if the message state is final (the client must deal with it now) */
     if( (eStatus == COMPLETE) || (eStatus == TIMEOUT) )
     {
-      pListParser->u32Token = 0;
-      pListParser->eState = EMPTY;
+      psStatus->u32Token = 0;
+      psStatus->u8State = EMPTY;
     }
   }
 
@@ -135,128 +236,452 @@ MessageStateType QueryMessageStatus(u32 u32Token_)
 } /* end QueryMessageStatus() */
 
 
+/*----------------------------------------------------------------------------------------------------------------------
+Function: SetMessageNotification()
+
+Description:
+Attaches a one-shot completion notification to a message.  When UpdateMessageStatus() sets the message to COMPLETE,
+TIMEOUT or ABANDONED, pfnNotify_ is called and u32EventMask_ is ORed in to *pu32EventFlags_.  This is
+normally from the peripheral ISR, so the notification arrives without waiting for the next pass of the 
+client's state machine.  The callback runs in interrupt context: keep it short and do not queue messages from it.
+
+If the message has already reached a final state (e.g. it was sent in manual mode before this call) the notification
+is delivered immediately from this function.  The status entry is left in place either way so QueryMessageStatus 
+still works as before.
+
+Requires:
+  - u32Token_ is the token returned when the message was queued
+  - pfnNotify_ is the function to call or NULL
+  - pu32EventFlags_ points to the flag register to update or NULL
+  - u32EventMask_ is the bit(s) to set in *pu32EventFlags_
+
+Promises:
+  - Returns TRUE if the notification is registered (or already delivered)
+  - Returns FALSE if the token is not in the status queue; nothing will be delivered
+*/
+bool SetMessageNotification(u32 u32Token_, fnMessageNotify_type pfnNotify_, volatile u32* pu32EventFlags_, u32 u32EventMask_)
+{
+  MessageStatus* psStatus = &Msg_StatusQueue[u32Token_ & STATUS_QUEUE_MASK];
+  MessageStateType eState;
+  
+  /* The peripheral ISR may update the status at any time.  The notification is armed by the STREX of 
+  u32NotifyToken which only succeeds if no interrupt ran since the LDREX, so the ISR either finished before the
+  state was checked or sees a complete notification. */
+  do
+  {
+    (void)__LDREXW( (u32*)&psStatus->u32NotifyToken );
+    
+    if(psStatus->u32Token != u32Token_)
+    {
+      return(FALSE);
+    }
+    
+    /* Deliver now if the message already finished; the ISR will not deliver an unarmed notification */
+    eState = (MessageStateType)psStatus->u8State;
+    if( (eState == COMPLETE) || (eState == TIMEOUT) || (eState == ABANDONED) )
+    {
+      if(pu32EventFlags_ != NULL)
+      {
+        *pu32EventFlags_ |= u32EventMask_;
+      }
+      
+      if(pfnNotify_ != NULL)
+      {
+        pfnNotify_(u32Token_, eState);
+      }
+      
+      return(TRUE);
+    }
+    
+    psStatus->pfnNotify      = pfnNotify_;
+    psStatus->pu32EventFlags = pu32EventFlags_;
+    psStatus->u32EventMask   = u32EventMask_;
+  } while( __STREXW(u32Token_, (u32*)&psStatus->u32NotifyToken) != 0 );
+  
+  return(TRUE);
+  
+} /* end SetMessageNotification() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessagingGetScavengerStats()
+
+Description:
+Reports how much work the stale-message scavenger has done since MessagingInitialize().  Non-zero counts mean a
+peripheral stopped sending or a client queued messages and never checked on them.
+
+Requires:
+  - psStats_ points to space for the results
+
+Promises:
+  - *psStats_ holds a copy of the scavenger totals
+*/
+void MessagingGetScavengerStats(MessageScavengerStatsType* psStats_)
+{
+  psStats_->u32TimedOut       = Msg_sScavengerStats.u32TimedOut;
+  psStats_->u32Abandoned      = Msg_sScavengerStats.u32Abandoned;
+  psStats_->u32BytesReclaimed = Msg_sScavengerStats.u32BytesReclaimed;
+  psStats_->u32StatusesAged   = Msg_sScavengerStats.u32StatusesAged;
+  
+} /* end MessagingGetScavengerStats() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessagingGetStats()
+
+Description:
+Takes a consistent snapshot of the messaging counters and high-water marks.
+
+Requires:
+  - psStats_ points to space for the results
+
+Promises:
+  - *psStats_ holds a copy of Msg_sStats
+*/
+void MessagingGetStats(MessagingStatsType* psStats_)
+{
+  /* Peripheral ISRs update the counters so copy again if one ran during the copy */
+  do
+  {
+    (void)__LDREXW(&Msg_u32SnapshotGuard);
+    *psStats_ = Msg_sStats;
+  } while( __STREXW(0, &Msg_u32SnapshotGuard) != 0 );
+  
+} /* end MessagingGetStats() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessagingGetLatency()
+
+Description:
+Takes a snapshot of one queue's latency histograms.  Latencies are measured in whole ms from G_u32SystemTime1ms
+so bucket 0 holds everything under 1ms.
+
+Requires:
+  - u8QueueId_ is the u8QueueId of the queue of interest (0 to the number of initialized queues - 1)
+  - psLatency_ points to space for the results
+
+Promises:
+  - Returns TRUE and *psLatency_ holds a copy of the histograms if u8QueueId_ is in use
+  - Returns FALSE if there is no queue with id u8QueueId_ (so callers can loop until FALSE)
+*/
+bool MessagingGetLatency(u8 u8QueueId_, MessageLatencyType* psLatency_)
+{
+  if(u8QueueId_ >= Msg_u8QueueIdCount)
+  {
+    return(FALSE);
+  }
+  
+  do
+  {
+    (void)__LDREXW(&Msg_u32SnapshotGuard);
+    *psLatency_ = Msg_asLatency[u8QueueId_];
+  } while( __STREXW(0, &Msg_u32SnapshotGuard) != 0 );
+  
+  return(TRUE);
+  
+} /* end MessagingGetLatency() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessagingResetStats()
+
+Description:
+Clears the telemetry counters, high-water marks and latency histograms so a new measurement can start.
+Queue ids are kept.
+
+Requires:
+  - 
+
+Promises:
+  - Msg_sStats and Msg_asLatency are zero
+*/
+void MessagingResetStats(void)
+{
+  /* Clear again if an ISR counted something part way through */
+  do
+  {
+    (void)__LDREXW(&Msg_u32SnapshotGuard);
+    memset(&Msg_sStats, 0, sizeof(Msg_sStats));
+    memset(Msg_asLatency, 0, sizeof(Msg_asLatency));
+  } while( __STREXW(0, &Msg_u32SnapshotGuard) != 0 );
+  
+} /* end MessagingResetStats() */
+
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Protected Functions */
 /*--------------------------------------------------------------------------------------------------------------------*/
 
 /*----------------------------------------------------------------------------------------------------------------------
-Function: QueueMessage
+Function: InitializeMessageQueue
 
 Description:
-Allocates one of the positions in the message queue to the calling function's send queue.
+Sets a transmit queue to empty.  Peripheral drivers call this for every queue they own during initialization.
 
 Requires:
-  - ppeTargetTxBuffer_ is the peripheral transmit buffer where the message will be queued
-  - u32MessageSize_ is the size of the message data array in bytes
-  - pu8MessageData_ points to the message data array
-  - Msg_Pool should not be full 
+  - psQueue_ points to the queue to initialize
+  - psQueue_ does not currently hold any messages (they would be lost from the pool)
+  - Called once per queue so that each queue gets one telemetry id
 
 Promises:
-  - The message is inserted into the target list and assigned a token
-  - If the message is created successfully, the message token is returned; otherwise, NULL is returned
+  - psQueue_->psHead and psQueue_->psTail are NULL and psQueue_->u32Count is 0
+  - The queue is MSG_PRIORITY_NORMAL with no byte quota
+  - psQueue_->u8QueueId is the next telemetry id, or MSG_NO_QUEUE_ID once MSG_MAX_QUEUES ids have been used
 */
-u32 QueueMessage(MessageType** ppeTargetTxBuffer_, u32 u32MessageSize_, u8* pu8MessageData_)
+void InitializeMessageQueue(MessageQueueType* psQueue_)
 {
-  MessageSlot *psSlotParser;
-  MessageType *psNewMessage;
-  MessageType *psListParser;
-  u32 u32BytesRemaining = u32MessageSize_;
-  u32 u32CurrentMessageSize = 0;
+  psQueue_->psHead       = NULL;
+  psQueue_->psTail       = NULL;
+  psQueue_->u32Count     = 0;
+  psQueue_->ePriority    = MSG_PRIORITY_NORMAL;
+  psQueue_->u32ByteQuota = 0;
+  psQueue_->u32BytesUsed = 0;
   
-  /* Check for available space in the message pool */
-  if(Msg_u8QueuedMessageCount == TX_QUEUE_SIZE)
+  psQueue_->u8QueueId = MSG_NO_QUEUE_ID;
+  if(Msg_u8QueueIdCount < MSG_MAX_QUEUES)
   {
-    G_u32MessagingFlags |= _MESSAGING_TX_QUEUE_FULL;
-    return(0);
+    psQueue_->u8QueueId = Msg_u8QueueIdCount++;
   }
+  
+} /* end InitializeMessageQueue() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: RegisterMessageQueue
+
+Description:
+Adds a transmit queue to the list checked by the scavenger in MessagingIdle.  The scavenger may remove any message
+except the head, so a driver must only register its queue if it keeps no information of its own about the
+messages waiting behind the head (e.g. a parallel descriptor ring).
 
-  /* Space available, so proceed with allocation.  Though only one message is queued at a time, we
-  use a while loop to handle messages that are too big and must be split into different slots.  The slots
-  are always sequential and the message processor will send the bytes continuously across slots */
-  while(u32BytesRemaining)
+Requires:
+  - psQueue_ points to an initialized queue that is static since it is registered permanently
+  - MessagingInitialize() has already run
+
+Promises:
+  - psQueue_ is added to Msg_apsQueues if it is not there already; _MESSAGING_TOO_MANY_QUEUES is set if there is no room
+*/
+void RegisterMessageQueue(MessageQueueType* psQueue_)
+{
+  /* Register the queue once */
+  for(u8 i = 0; i < Msg_u8QueueCount; i++)
   {
-    Msg_u8QueuedMessageCount++;
-    
-    /* Flag if we're above the high watermark */
-    if(Msg_u8QueuedMessageCount >= TX_QUEUE_WATERMARK)
-    {
-      G_u32MessagingFlags |= _MESSAGING_TX_QUEUE_ALMOST_FULL;
-    }
-    else
+    if(Msg_apsQueues[i] == psQueue_)
     {
-      G_u32MessagingFlags &= ~_MESSAGING_TX_QUEUE_ALMOST_FULL;
+      return;
     }
-    
-    /* Find an empty slot: this is non-circular and there must be at least one free slot if we're here */
-    psSlotParser = &Msg_Pool[0];
-    while(!psSlotParser->bFree)
+  }
+  
+  if(Msg_u8QueueCount < MSG_MAX_QUEUES)
+  {
+    Msg_apsQueues[Msg_u8QueueCount++] = psQueue_;
+  }
+  else
+  {
+    G_u32MessagingFlags |= _MESSAGING_TOO_MANY_QUEUES;
+  }
+  
+} /* end RegisterMessageQueue() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: SetMessageQueuePriority
+
+Description:
+Sets the priority class and byte quota used when messages are added to a queue.  Peripheral drivers call this 
+from their Request function with the values in the client's configuration.
+  - MSG_PRIORITY_HIGH may use the whole arena
+  - MSG_PRIORITY_NORMAL must leave MSG_RESERVE_NORMAL bytes free
+  - MSG_PRIORITY_LOW must leave MSG_RESERVE_LOW bytes free
+A non-zero u32ByteQuota_ further limits the arena bytes (headers included) that the queue may hold at once.
+
+Requires:
+  - psQueue_ points to an initialized queue
+  - ePriority_ is the priority class
+  - u32ByteQuota_ is the max bytes the queue may hold or 0 for no limit
+
+Promises:
+  - The queue's ePriority and u32ByteQuota are updated; messages already queued are not affected
+*/
+void SetMessageQueuePriority(MessageQueueType* psQueue_, MessagePriorityType ePriority_, u32 u32ByteQuota_)
+{
+  psQueue_->ePriority    = ePriority_;
+  psQueue_->u32ByteQuota = u32ByteQuota_;
+  
+} /* end SetMessageQueuePriority() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: QueueMessage
+
+Description:
+Allocates a block in the message arena for the calling function's send queue.  The data is copied
+so the caller's buffer may be reused as soon as this function returns.
+
+A payload of up to MAX_TX_MESSAGE_LENGTH bytes is always one contiguous message.  A longer payload is split in to 
+parts of up to MAX_TX_MESSAGE_LENGTH bytes that are queued back to back, each with its own token, and a part is
+cut short where the free space wraps so the whole arena can be used.  The peripheral sends the parts one after the
+other so the bytes go out in order.  Space for every part is checked before the first is queued, so a split message
+is queued whole or refused.
+
+Requires:
+  - psTargetQueue_ is the peripheral transmit queue where the message will be queued
+  - u32MessageSize_ is the size of the message data array in bytes
+  - pu8MessageData_ points to the message data array
+
+Promises:
+  - The message (or each of its parts) is appended at psTargetQueue_->psTail and assigned a token; 
+    psTargetQueue_->u32Count is updated
+  - If the message is created successfully, the message token is returned (the token of the last part if it was
+    split); otherwise, NULL is returned
+*/
+u32 QueueMessage(MessageQueueType* psTargetQueue_, u32 u32MessageSize_, u8* pu8MessageData_)
+{
+  MessageType *psNewMessage;
+  u32 u32Parts;
+  u32 u32PartSize;
+  u32 u32Largest;
+  
+  if(u32MessageSize_ <= MAX_TX_MESSAGE_LENGTH)
+  {
+    psNewMessage = AddMessageToQueue(psTargetQueue_, u32MessageSize_, pu8MessageData_, TRUE);
+    if(psNewMessage == NULL)
     {
-      psSlotParser++;
+      return(0);
     }
     
-    /* Allocate the slot and set the message pointer */
-    psSlotParser->bFree = FALSE;
-    psNewMessage = &(psSlotParser->Message);
+    return(psNewMessage->u32Token);
+  }
+
+  /* Check the space for the whole message first.  Allow one block for the part that is cut short at the wrap and one
+  for the space skipped at the top of the arena; every block is rounded up by at most 3 bytes. */
+  u32Parts = (u32MessageSize_ + MAX_TX_MESSAGE_LENGTH - 1) / MAX_TX_MESSAGE_LENGTH;
+  if(!MessageSpaceAvailable(psTargetQueue_, u32MessageSize_ + ( (u32Parts + 2) * MessageBlockSize(3) )))
+  {
+    return(0);
+  }
   
-    /* Check the message size and split the message up if necessary */
-    if(u32BytesRemaining > MAX_TX_MESSAGE_LENGTH)
-    {
-      u32CurrentMessageSize = MAX_TX_MESSAGE_LENGTH;
-      u32BytesRemaining -= MAX_TX_MESSAGE_LENGTH;
-    }
-    else
+  /* Queue the parts in order */
+  while(u32MessageSize_ != 0)
+  {
+    u32PartSize = (u32MessageSize_ > MAX_TX_MESSAGE_LENGTH) ? MAX_TX_MESSAGE_LENGTH : u32MessageSize_;
+    u32Largest = ArenaLargestPayload();
+    if( (u32Largest != 0) && (u32PartSize > u32Largest) )
     {
-      u32CurrentMessageSize = u32BytesRemaining;
-      u32BytesRemaining = 0;
+      u32PartSize = u32Largest;
     }
     
-    /* Copy all the data to the allocated message structure */
-    psNewMessage->u32Token      = Msg_u32Token;
-    psNewMessage->u32Size       = u32CurrentMessageSize;
-    psNewMessage->psNextMessage = NULL;
-    
-    /* Add the data into the payload */
-    for(u32 i = 0; i < psNewMessage->u32Size; i++)
+    /* Only a status queue with every entry live can refuse a part now; the parts already queued are still sent */
+    psNewMessage = AddMessageToQueue(psTargetQueue_, u32PartSize, pu8MessageData_, TRUE);
+    if(psNewMessage == NULL)
     {
-      *(psNewMessage->pu8Message + i) = *pu8MessageData_++;
+      return(0);
     }
+    
+    pu8MessageData_ += u32PartSize;
+    u32MessageSize_ -= u32PartSize;
+  }
   
-    /* Link the new message into the client's transmit buffer */
-    /* Handle an empty list */
-    if(*ppeTargetTxBuffer_ == NULL)
-    {
-      *ppeTargetTxBuffer_ = psNewMessage;
-    }
+  /* The last part is the last to be sent */
+  return(psNewMessage->u32Token);
+  
+} /* end QueueMessage() */
 
-    /* Add the message to the end of the list */
-    else
-    {
-      /* Find the last node */
-      psListParser =  *ppeTargetTxBuffer_;
-      while(psListParser->psNextMessage != NULL)
-      {
-        psListParser = psListParser->psNextMessage;
-      }
-     
-      /* Found the end: add the new node */
-      psListParser->psNextMessage = psNewMessage;
-    }
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: QueueMessageReference
+
+Description:
+Zero-copy version of QueueMessage.  The message descriptor points at the caller's buffer and the peripheral
+transmits directly from it, so no data is copied and only the block header is taken from the arena.
+The buffer may be in RAM or flash since it is only ever read.
+
+Ownership: the caller lends pu8MessageData_ to the messaging system.  The data must not be changed or freed
+until the status of the returned token is COMPLETE or ABANDONED (see QueryMessageStatus).  A TIMEOUT message is
+late but still owned by its peripheral which may yet read the buffer.
+A stack buffer may only be used if the function that owns it waits for one of these states before returning.
+
+Requires:
+  - psTargetQueue_ is the peripheral transmit queue where the message will be queued
+  - u32MessageSize_ is the size of the message data array in bytes (1 to MAX_TX_REFERENCE_LENGTH)
+  - pu8MessageData_ points to the message data array which stays valid as described above
+
+Promises:
+  - The message is appended at psTargetQueue_->psTail and assigned a token; psTargetQueue_->u32Count is updated
+  - If the message is created successfully, the message token is returned; otherwise, 0 is returned
+*/
+u32 QueueMessageReference(MessageQueueType* psTargetQueue_, u32 u32MessageSize_, u8* pu8MessageData_)
+{
+  MessageType *psNewMessage;
+
+  if( (u32MessageSize_ == 0) || (u32MessageSize_ > MAX_TX_REFERENCE_LENGTH) )
+  {
+    G_u32MessagingFlags |= _MESSAGING_MSG_TOO_LARGE;
+    Msg_sStats.u32TooLarge++;
+    return(0);
+  }
+  
+  psNewMessage = AddMessageToQueue(psTargetQueue_, u32MessageSize_, pu8MessageData_, FALSE);
+  if(psNewMessage == NULL)
+  {
+    return(0);
+  }
+  
+  return(psNewMessage->u32Token);
+  
+} /* end QueueMessageReference() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: IssueMessageToken
+
+Description:
+Assigns the next message token and posts its status as WAITING.  The caller stores the message itself, so
+nothing is taken from the arena and the message is not in any MessageQueueType; the driver moves the status
+along with UpdateMessageStatus() like any other message and clients use QueryMessageStatus() as usual.
+
+Tokens are issued in order, but a message that stays queued (e.g. a UART held off by flow control) can be passed
+by STATUS_QUEUE_SIZE newer tokens.  The token that would reuse its status entry is skipped so the live status
+and its notification are never overwritten.
+
+Requires:
+  - u8QueueId_ is a telemetry id from InitializeMessageQueue() or MSG_NO_QUEUE_ID
+  - Called only from the main loop (the same single producer as QueueMessage)
+  - The caller never has more than MSG_ISSUED_TOKENS of these messages waiting or sending (the status queue is 
+    sized for that many)
+
+Promises:
+  - Returns the new token (never 0) with a WAITING status; Msg_u32Token is advanced past it and past any tokens 
+    skipped because their status entry is live
+  - Returns 0 and sets _MESSAGING_TX_QUEUE_FULL if every status entry is live
+*/
+u32 IssueMessageToken(u8 u8QueueId_)
+{
+  u32 u32Token;
   
-    /* Update the Public status of the message in the status queue */
-    AddNewMessageStatus(Msg_u32Token);
+  for(u16 i = 0; i < STATUS_QUEUE_SIZE; i++)
+  {
+    u32Token = Msg_u32Token;
   
     /* Increment message token and catch the rollover every 4 billion messages... Token 0 is not allowed. */
     if(++Msg_u32Token == 0)
     {
       Msg_u32Token = 1;
     }
+    
+    if(!MessageStatusIsLive(u32Token))
+    {
+      AddNewMessageStatus(u32Token, u8QueueId_);
+      return(u32Token);
+    }
+  }
   
-  } /* end while */
-
-  /* Return only the current (and highest) message token, as it will be the last portion to be sent if the message was split up */
-  return(psNewMessage->u32Token);
+  G_u32MessagingFlags |= _MESSAGING_TX_QUEUE_FULL;
+  Msg_sStats.u32QueueFull++;
+  return(0);
   
-} /* end QueueMessage() */
+} /* end IssueMessageToken() */
 
 
 /*----------------------------------------------------------------------------------------------------------------------
@@ -265,45 +690,59 @@ Function: DeQueueMessage
 Description:
 Removes a message from a message queue and adds it back to the pool.
 
+Each queue has a single consumer (its peripheral ISR, or the driver's state machine when the ISR cannot run) and 
+a single producer (QueueMessage from the main loop).  The consumer owns psHead and only writes psTail to empty 
+the queue, so this is safe to call while the main loop is part way through adding a message: see LinkMessage().
+
 Requires:
-  - pTargetQueue_ points to the list queue where the message to be deleted is located
-  - pTargetQueue_ is a FIFO linked-list where the message that needs to be killed is at the front of the list
+  - psTargetQueue_ points to the queue where the message to be deleted is located
+  - psTargetQueue_ is a FIFO where the message that needs to be killed is at psHead
   - The message to be removed has been completely sent and is no longer in use
-  - New message cannot be added into the list during this function (via interrupts)
+  - Called only by the queue's consumer
 
 Promises:
-  - The first message in the list is deleted; the list is hooked back up
-  - The message space is added back to the available message queue
+  - The first message in the list is deleted; psHead (and psTail if the queue is now empty) and u32Count are updated
+  - The message block is marked free and will be reclaimed by the next allocation
 */
-void DeQueueMessage(MessageType** pTargetQueue_)
+void DeQueueMessage(MessageQueueType* psTargetQueue_)
 {
-  MessageSlot *psSlotParser;
+  MessageType* psMessage = psTargetQueue_->psHead;
+  MessageType* psNext;
+  u32 u32Offset;
       
   /* Make sure there is a message to kill */
-  if(*pTargetQueue_ == NULL)
+  if(psMessage == NULL)
   {
     G_u32MessagingFlags |= _DEQUEUE_GOT_NULL;
     return;
   }
   
-  /* Find the message's slot: this message pool is non-circular and the message must be one of the slots */
-  psSlotParser = &Msg_Pool[0];
-  while( (&psSlotParser->Message != *pTargetQueue_) && (psSlotParser != &Msg_Pool[TX_QUEUE_SIZE]) )
-  {
-    psSlotParser++;
-  }
-
-  /* Make sure the message has been found */
-  if(psSlotParser == &Msg_Pool[TX_QUEUE_SIZE])
+  /* Make sure the message really is an allocated block in the arena.  An address below the arena wraps to 
+  a huge offset so one compare catches both ends. */
+  u32Offset = (u32)psMessage - (u32)MSG_ALLOCATOR_BASE;
+  if( (u32Offset >= MSG_ALLOCATOR_SIZE) || 
+      (u32Offset & 0x03) ||
+      ( ((MessageBlockType*)psMessage)->bFree ) )
   {
     G_u32MessagingFlags |= _DEQUEUE_MSG_NOT_FOUND;
     return;
   }
 
-  /* Unhook the message from the current owner's queue and put it back in the pool */
-  *pTargetQueue_ = (*pTargetQueue_)->psNextMessage;
-  psSlotParser->bFree = TRUE;
-  Msg_u8QueuedMessageCount--;
+  /* Unhook the message from the current owner's queue.  If it is the last message, psTail is only cleared if the 
+  producer has not already swapped in a new tail; in that case LinkMessage() publishes the new message to psHead. */
+  psNext = psMessage->psNextMessage;
+  psTargetQueue_->psHead = psNext;
+  if( (psNext == NULL) && (psTargetQueue_->psTail == psMessage) )
+  {
+    psTargetQueue_->psTail = NULL;
+  }
+  
+  AtomicAdd(&psTargetQueue_->u32Count, (u32)-1);
+  AtomicAdd(&psTargetQueue_->u32BytesUsed, 0 - ((MessageBlockType*)psMessage)->u32BlockSize);
+  AtomicAdd(&Msg_sStats.u32Dequeues, 1);
+  
+  /* Put it back in the arena */
+  ReleaseMessageBlock( (MessageBlockType*)psMessage );
   
 } /* end DeQueueMessage() */
 
@@ -319,28 +758,42 @@ Requires:
 
 Promises:
   - Message queues are zeroed
+  - The message arena is empty
   - Flags and state machine are initialized
 */
 void MessagingInitialize(void)
 {
   /* Inititalize variables */
-  Msg_u8QueuedMessageCount = 0;
+  Msg_u16QueuedMessageCount = 0;
   Msg_u32Token = 1;
 
-  /* Ensure all message slots are deallocated and the message status queue is empty */
-  for(u16 i = 0; i < TX_QUEUE_SIZE; i++)
-  {
-    Msg_Pool[i].bFree = TRUE;
-  }
+  /* Ensure the message arena is empty */
+  Msg_u32ArenaHead = 0;
+  Msg_u32ArenaTail = 0;
+  Msg_u32ArenaWrap = MSG_ALLOCATOR_SIZE;
 
   for(u16 i = 0; i < STATUS_QUEUE_SIZE; i++)
   {
     Msg_StatusQueue[i].u32Token = 0;
-    Msg_StatusQueue[i].eState = EMPTY;
+    Msg_StatusQueue[i].u8State = EMPTY;
     Msg_StatusQueue[i].u32Timestamp = 0;
+    Msg_StatusQueue[i].pfnNotify = NULL;
+    Msg_StatusQueue[i].pu32EventFlags = NULL;
+    Msg_StatusQueue[i].u32EventMask = 0;
+    Msg_StatusQueue[i].u32NotifyToken = 0;
+    Msg_StatusQueue[i].u8QueueId = MSG_NO_QUEUE_ID;
   }
 
-  Msg_pNextStatus = &Msg_StatusQueue[0];
+  /* Queues register themselves as the peripheral drivers initialize */
+  Msg_u8QueueCount = 0;
+  Msg_u8QueueIdCount = 0;
+  Msg_u8ScavengeQueueIndex = 0;
+  Msg_u16ScavengeStatusIndex = 0;
+  Msg_sScavengerStats.u32TimedOut = 0;
+  Msg_sScavengerStats.u32Abandoned = 0;
+  Msg_sScavengerStats.u32BytesReclaimed = 0;
+  Msg_sScavengerStats.u32StatusesAged = 0;
+  MessagingResetStats();
 
   G_u32MessagingFlags = 0;
   Messaging_pfnStateMachine = MessagingIdle;
@@ -373,67 +826,1315 @@ void MessagingRunActiveState(void)
 Function: UpdateMessageStatus()
 
 Description:
-Changes the status of a message in the statue queue.
+Changes the status of a message in the statue queue.  This is called from peripheral ISRs.
 
 Requires:
   - u32Token_ is message that should be in the status queue
   - eNewState_ is the desired status setting for the message
 
 Promises:
-  - eState of the message is set to eNewState_
+  - u8State of the message is set to eNewState_ and its timestamp updated if its status entry has not been overwritten
+  - WAITING to SENDING and SENDING to COMPLETE times are added to the queue's latency histograms
+  - If eNewState_ is COMPLETE, TIMEOUT or ABANDONED, any notification registered with SetMessageNotification is delivered
 */
 void UpdateMessageStatus(u32 u32Token_, MessageStateType eNewState_)
 {
-  MessageStatus* pListParser = &Msg_StatusQueue[0];
+  MessageStatus* psStatus = &Msg_StatusQueue[u32Token_ & STATUS_QUEUE_MASK];
   
-  /* Search for the token */
-  while( (pListParser->u32Token != u32Token_) && (pListParser != &Msg_StatusQueue[STATUS_QUEUE_SIZE]) )
+  /* Only change the status if the entry still belongs to this token */
+  if(psStatus->u32Token == u32Token_)
   {
-    pListParser++;
+    /* Telemetry: the timestamp still holds the time of the previous state change */
+    if(psStatus->u8QueueId < MSG_MAX_QUEUES)
+    {
+      if( (psStatus->u8State == WAITING) && (eNewState_ == SENDING) )
+      {
+        RecordLatency(Msg_asLatency[psStatus->u8QueueId].au32WaitTime, G_u32SystemTime1ms - psStatus->u32Timestamp);
+      }
+      else if( (psStatus->u8State == SENDING) && (eNewState_ == COMPLETE) )
+      {
+        RecordLatency(Msg_asLatency[psStatus->u8QueueId].au32SendTime, G_u32SystemTime1ms - psStatus->u32Timestamp);
+      }
+    }
+    
+    psStatus->u8State = eNewState_;
+    psStatus->u32Timestamp = G_u32SystemTime1ms;
+    
+    if( (eNewState_ == COMPLETE) || (eNewState_ == TIMEOUT) || (eNewState_ == ABANDONED) )
+    {
+      NotifyMessageStatus(psStatus);
+    }
   }
+  
+} /* end UpdateMessageStatus() */
 
-  /* If the token was found, change the status */
-  if(pListParser != &Msg_StatusQueue[STATUS_QUEUE_SIZE])
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MarkMessageSending()
+
+Description:
+Sets a queued message to SENDING when a peripheral loads it in to its PDC.  The flag in the arena block is what
+keeps the scavenger away from the message; the status entry is only for the client.  Called from the peripheral's
+state machine or ISR.
+
+Requires:
+  - psMessage_ is a message in a transmit queue (so it is an arena block)
+  - The peripheral has not yet loaded psMessage_->pu8Data in to its PDC
+
+Promises:
+  - The message's block has bSending = TRUE
+  - The message status is SENDING
+*/
+void MarkMessageSending(MessageType* psMessage_)
+{
+  ( (MessageBlockType*)psMessage_ )->bSending = TRUE;
+  UpdateMessageStatus(psMessage_->u32Token, SENDING);
+  
+} /* end MarkMessageSending() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessagingBenchmark()
+
+Description:
+Measures the cost of the message arena allocator by running MSG_BENCHMARK_CYCLES allocate/release pairs 
+of MSG_BENCHMARK_PAYLOAD_SIZE-byte blocks.  The reclaim of each released block happens in the following allocate
+so it is included in the result.  Only the arena is exercised: no tokens are used and the status queue 
+is not touched.  The benchmark only runs when no messages are queued: a live block at the arena tail would stop
+the released blocks from being reclaimed and the benchmark would leave them behind.
+
+*** This function violates the 1ms system rule (it runs for tens of ms) so should only be used for debugging. ***
+
+Requires:
+  - G_u32SystemTime1ms is running
+  - Called from the main loop
+
+Promises:
+  - Returns the average time for one allocate or release in ns
+  - Returns 0 without touching the arena if any messages are queued
+  - The arena is empty again on return
+*/
+u32 MessagingBenchmark(void)
+{
+  MessageBlockType* psBlock;
+  u32 u32StartTime;
+  u32 u32ElapsedTime;
+  
+  if(!MessagingIsIdle())
+  {
+    return(0);
+  }
+  
+  /* Wait for a fresh tick so the measurement starts on a 1ms boundary */
+  u32StartTime = G_u32SystemTime1ms;
+  while(u32StartTime == G_u32SystemTime1ms);
+  u32StartTime = G_u32SystemTime1ms;
+
+  for(u32 i = 0; i < MSG_BENCHMARK_CYCLES; i++)
+  {
+    psBlock = AllocateMessageBlock(MSG_BENCHMARK_PAYLOAD_SIZE);
+    if(psBlock == NULL)
+    {
+      return(0);
+    }
+    ReleaseMessageBlock(psBlock);
+  }
+  
+  /* Leave the arena as it was found */
+  ReclaimMessageBlocks();
+
+  u32ElapsedTime = G_u32SystemTime1ms - u32StartTime;
+  
+  /* Two operations per cycle; scale ms to ns */
+  return( (u32ElapsedTime * 1000000) / (2 * MSG_BENCHMARK_CYCLES) );
+  
+} /* end MessagingBenchmark() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessagingBenchmarkQueue()
+
+Description:
+Measures the full cost of sending a message through a private queue: u32Depth_ messages of u32MessageSize_ bytes
+are queued, their status is set COMPLETE and queried (which clears it), then they are dequeued.  This repeats for 
+MSG_BENCHMARK_TIME ms and each phase is timed separately with the SysTick counter so the results have sub-us 
+resolution.  The telemetry counters and G_u32MessagingFlags are restored afterwards so the benchmark does not 
+show up in them.
+
+*** This function violates the 1ms system rule so should only be used for debugging. ***
+
+Requires:
+  - No messages are queued (checked)
+  - u32MessageSize_ is 0 to MAX_TX_MESSAGE_LENGTH
+  - u32Depth_ is at least 1; it is reduced to MSG_BENCHMARK_MAX_DEPTH or the number of messages that fit in the arena
+  - psResult_ points to space for the results
+
+Promises:
+  - Returns TRUE and *psResult_ holds the results if the benchmark ran
+  - Returns FALSE if messages were queued or the parameters are out of range
+*/
+bool MessagingBenchmarkQueue(u32 u32MessageSize_, u32 u32Depth_, MessagingBenchmarkType* psResult_)
+{
+  static MessageQueueType sBenchmarkQueue;
+  u32 au32Tokens[MSG_BENCHMARK_MAX_DEPTH];
+  MessagingStatsType sSavedStats;
+  u32 u32SavedFlags;
+  u32 u32MaxDepth;
+  u32 u32StartTime;
+  u32 au32Ticks[4];
+  u32 u32QueueTicks = 0;
+  u32 u32StatusTicks = 0;
+  u32 u32DequeueTicks = 0;
+  u32 u32Messages = 0;
+  
+  if( (u32MessageSize_ > MAX_TX_MESSAGE_LENGTH) || (u32Depth_ == 0) || !MessagingIsIdle() )
+  {
+    return(FALSE);
+  }
+  
+  /* The ring needs one spare byte between the head and the tail */
+  u32MaxDepth = (MSG_ARENA_SIZE - 1) / MessageBlockSize(u32MessageSize_);
+  if(u32Depth_ > u32MaxDepth)
+  {
+    u32Depth_ = u32MaxDepth;
+  }
+  if(u32Depth_ > MSG_BENCHMARK_MAX_DEPTH)
+  {
+    u32Depth_ = MSG_BENCHMARK_MAX_DEPTH;
+  }
+  
+  InitializeTestQueue(&sBenchmarkQueue);
+  sSavedStats = Msg_sStats;
+  u32SavedFlags = G_u32MessagingFlags;
+  
+  /* Wait for a fresh tick so the run lasts a full MSG_BENCHMARK_TIME */
+  u32StartTime = G_u32SystemTime1ms;
+  while(u32StartTime == G_u32SystemTime1ms);
+  u32StartTime = G_u32SystemTime1ms;
+
+  while( (G_u32SystemTime1ms - u32StartTime) < MSG_BENCHMARK_TIME )
+  {
+    au32Ticks[0] = BenchmarkTicks();
+    for(u32 i = 0; i < u32Depth_; i++)
+    {
+      au32Tokens[i] = QueueMessage(&sBenchmarkQueue, u32MessageSize_, (u8*)Msg_au8BenchmarkData);
+    }
+
+    au32Ticks[1] = BenchmarkTicks();
+    for(u32 i = 0; i < u32Depth_; i++)
+    {
+      UpdateMessageStatus(au32Tokens[i], COMPLETE);
+      QueryMessageStatus(au32Tokens[i]);
+    }
+    
+    au32Ticks[2] = BenchmarkTicks();
+    for(u32 i = 0; i < u32Depth_; i++)
+    {
+      DeQueueMessage(&sBenchmarkQueue);
+    }
+    au32Ticks[3] = BenchmarkTicks();
+    
+    u32QueueTicks   += au32Ticks[1] - au32Ticks[0];
+    u32StatusTicks  += au32Ticks[2] - au32Ticks[1];
+    u32DequeueTicks += au32Ticks[3] - au32Ticks[2];
+    u32Messages     += u32Depth_;
+  }
+  
+  ReclaimMessageBlocks();
+  Msg_sStats = sSavedStats;
+  G_u32MessagingFlags = u32SavedFlags;
+  
+  psResult_->u32Depth     = u32Depth_;
+  psResult_->u32Messages  = u32Messages;
+  psResult_->u32QueueNs   = BenchmarkTicksToNs(u32QueueTicks, u32Messages);
+  psResult_->u32StatusNs  = BenchmarkTicksToNs(u32StatusTicks, u32Messages);
+  psResult_->u32DequeueNs = BenchmarkTicksToNs(u32DequeueTicks, u32Messages);
+  
+  return(TRUE);
+  
+} /* end MessagingBenchmarkQueue() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessagingSelfTest()
+
+Description:
+Randomized stress test of the messaging system.  MSG_SELFTEST_QUEUES private queues act as separate clients that
+queue and dequeue messages of random sizes in a random order, so the arena fills, wraps and refuses messages.
+The token is started just below 0xFFFFFFFF so that it rolls over part way through.  Checks:
+  - Every token is the next in sequence (so all are unique), or later only by tokens whose status entry is live, 
+    and 0 is never issued
+  - The token rolls over to 1
+  - A new message is WAITING and a completed one is COMPLETE
+  - Every payload arrives intact
+  - The queue counts and byte totals always fit in the arena and everything is returned to it at the end
+Afterwards the token, G_u32MessagingFlags and the telemetry counters are restored.  Status entries of earlier messages that were never
+queried may be overwritten.
+
+*** This function violates the 1ms system rule so should only be used for debugging. ***
+
+Requires:
+  - No messages are queued (checked)
+
+Promises:
+  - Returns 0 if all checks passed, otherwise the _MSG_SELFTEST_x flags of the checks that failed
+*/
+u32 MessagingSelfTest(void)
+{
+  static MessageQueueType asTestQueues[MSG_SELFTEST_QUEUES];
+  u8 au8Data[MSG_SELFTEST_MAX_SIZE];
+  MessagingStatsType sSavedStats;
+  MessageQueueType* psQueue;
+  MessageType* psMessage;
+  u32 u32SavedToken = Msg_u32Token;
+  u32 u32SavedFlags;
+  u32 u32ExpectedToken = 0xFFFFFFFF - (MSG_SELFTEST_MESSAGES / 2);
+  u32 u32Random = 1;
+  u32 u32Queued = 0;
+  u32 u32Token;
+  u32 u32Size;
+  u32 u32Count;
+  u32 u32Bytes;
+  u32 u32Result = 0;
+  bool bRolledOver = FALSE;
+  
+  if(!MessagingIsIdle())
+  {
+    return(_MSG_SELFTEST_BUSY);
+  }
+  
+  for(u8 i = 0; i < MSG_SELFTEST_QUEUES; i++)
+  {
+    InitializeTestQueue(&asTestQueues[i]);
+  }
+  sSavedStats = Msg_sStats;
+  u32SavedFlags = G_u32MessagingFlags;
+  G_u32MessagingFlags = 0;
+  Msg_u32Token = u32ExpectedToken;
+  
+  while(u32Queued < MSG_SELFTEST_MESSAGES)
+  {
+    /* Simple LCG so the sequence is the same every run */
+    u32Random = (u32Random * 1103515245) + 12345;
+    psQueue = &asTestQueues[(u32Random >> 16) % MSG_SELFTEST_QUEUES];
+    psMessage = psQueue->psHead;
+    
+    /* Queue two messages for every one dequeued so the arena fills up */
+    if( ((u32Random >> 24) % 3) != 0 )
+    {
+      u32Size = (u32Random >> 8) % (MSG_SELFTEST_MAX_SIZE + 1);
+      memset(au8Data, (u8)u32ExpectedToken, u32Size);
+      
+      u32Token = QueueMessage(psQueue, u32Size, au8Data);
+      if(u32Token != 0)
+      {
+        /* A token may only be skipped if a message that is still queued holds its status entry */
+        while( (u32ExpectedToken != u32Token) && MessageStatusIsLive(u32ExpectedToken) )
+        {
+          if(++u32ExpectedToken == 0)
+          {
+            u32ExpectedToken = 1;
+            bRolledOver = TRUE;
+          }
+        }
+        
+        if(u32Token != u32ExpectedToken)
+        {
+          u32Result |= _MSG_SELFTEST_TOKEN;
+        }
+        if(QueryMessageStatus(u32Token) != WAITING)
+        {
+          u32Result |= _MSG_SELFTEST_STATUS;
+        }
+        if(++u32ExpectedToken == 0)
+        {
+          u32ExpectedToken = 1;
+          bRolledOver = TRUE;
+        }
+        u32Queued++;
+        continue;
+      }
+      
+      /* Full: fall through and make room */
+    }
+    
+    if(psMessage != NULL)
+    {
+      for(u32 i = 0; i < psMessage->u32Size; i++)
+      {
+        if(psMessage->pu8Data[i] != (u8)psMessage->u32Token)
+        {
+          u32Result |= _MSG_SELFTEST_DATA;
+        }
+      }
+      
+      u32Token = psMessage->u32Token;
+      MarkMessageSending(psMessage);
+      UpdateMessageStatus(u32Token, COMPLETE);
+      DeQueueMessage(psQueue);
+      if(QueryMessageStatus(u32Token) != COMPLETE)
+      {
+        u32Result |= _MSG_SELFTEST_STATUS;
+      }
+    }
+    
+    /* Every block the queues hold must be in the arena */
+    u32Count = 0;
+    u32Bytes = 0;
+    for(u8 i = 0; i < MSG_SELFTEST_QUEUES; i++)
+    {
+      u32Count += asTestQueues[i].u32Count;
+      u32Bytes += asTestQueues[i].u32BytesUsed;
+    }
+    if( (u32Count > Msg_u16QueuedMessageCount) || (u32Bytes > ArenaBytesUsed()) )
+    {
+      u32Result |= _MSG_SELFTEST_CONSERVATION;
+    }
+  }
+  
+  /* Drain the queues: the arena must return to empty */
+  for(u8 i = 0; i < MSG_SELFTEST_QUEUES; i++)
+  {
+    while(asTestQueues[i].psHead != NULL)
+    {
+      u32Token = asTestQueues[i].psHead->u32Token;
+      UpdateMessageStatus(u32Token, COMPLETE);
+      DeQueueMessage(&asTestQueues[i]);
+      QueryMessageStatus(u32Token);
+    }
+    
+    if( (asTestQueues[i].u32Count != 0) || (asTestQueues[i].u32BytesUsed != 0) || (asTestQueues[i].psTail != NULL) )
+    {
+      u32Result |= _MSG_SELFTEST_CONSERVATION;
+    }
+  }
+  
+  ReclaimMessageBlocks();
+  if( (Msg_u16QueuedMessageCount != 0) || (Msg_u32ArenaHead != 0) || (Msg_u32ArenaTail != 0) )
+  {
+    u32Result |= _MSG_SELFTEST_CONSERVATION;
+  }
+  
+  if( (G_u32MessagingFlags & (_DEQUEUE_GOT_NULL | _DEQUEUE_MSG_NOT_FOUND)) )
+  {
+    u32Result |= _MSG_SELFTEST_CONSERVATION;
+  }
+  
+  if(!bRolledOver)
+  {
+    u32Result |= _MSG_SELFTEST_ROLLOVER;
+  }
+  
+  Msg_u32Token = u32SavedToken;
+  Msg_sStats = sSavedStats;
+  G_u32MessagingFlags = u32SavedFlags;
+  
+  return(u32Result);
+  
+} /* end MessagingSelfTest() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessageBlockSize()
+
+Description:
+Calculates the arena space needed for a message: the block header plus the payload, rounded up so the next
+block stays 4-byte aligned.
+
+Requires:
+  - u32PayloadSize_ is the number of payload bytes stored in the block (0 for a reference message)
+
+Promises:
+  - Returns the block size in bytes
+*/
+static u32 MessageBlockSize(u32 u32PayloadSize_)
+{
+  return( (sizeof(MessageBlockType) + u32PayloadSize_ + 3) & ~((u32)0x03) );
+  
+} /* end MessageBlockSize() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: AllocateMessageBlock()
+
+Description:
+Takes a contiguous block from the head of the message arena.  The block is placed directly above the head if it
+fits; otherwise it wraps to the bottom of the arena if there is room below the oldest block.  Blocks freed since
+the last allocation are reclaimed first.
+
+Requires:
+  - Called from the main loop only (it owns the arena head and tail)
+  - u32PayloadSize_ is the number of payload bytes needed after the header (0 for a reference message)
+
+Promises:
+  - Returns a pointer to the new block with bFree = bSending = FALSE and u32BlockSize set; Msg_u16QueuedMessageCount is incremented
+  - Returns NULL if the arena does not have a large enough contiguous space
+*/
+static MessageBlockType* AllocateMessageBlock(u32 u32PayloadSize_)
+{
+  MessageBlockType* psBlock;
+  u32 u32BlockSize = MessageBlockSize(u32PayloadSize_);
+  u32 u32Offset;
+  
+  ReclaimMessageBlocks();
+  
+  /* Not wrapped: free space is above the head and below the tail */
+  if(Msg_u32ArenaHead >= Msg_u32ArenaTail)
+  {
+    if( (MSG_ALLOCATOR_SIZE - Msg_u32ArenaHead) >= u32BlockSize )
+    {
+      u32Offset = Msg_u32ArenaHead;
+    }
+    /* The head must stay strictly below the tail once wrapped */
+    else if(u32BlockSize < Msg_u32ArenaTail)
+    {
+      Msg_u32ArenaWrap = Msg_u32ArenaHead;
+      u32Offset = 0;
+    }
+    else
+    {
+      return(NULL);
+    }
+  }
+  /* Wrapped: the only free space is between the head and the tail */
+  else
+  {
+    if( (Msg_u32ArenaTail - Msg_u32ArenaHead) > u32BlockSize )
+    {
+      u32Offset = Msg_u32ArenaHead;
+    }
+    else
+    {
+      return(NULL);
+    }
+  }
+  
+  psBlock = (MessageBlockType*)( MSG_ALLOCATOR_BASE + u32Offset );
+  psBlock->u32BlockSize = u32BlockSize;
+  psBlock->bFree = FALSE;
+  psBlock->bSending = FALSE;
+  
+  Msg_u32ArenaHead = u32Offset + u32BlockSize;
+  Msg_u16QueuedMessageCount++;
+  
+  return(psBlock);
+  
+} /* end AllocateMessageBlock() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ReleaseMessageBlock()
+
+Description:
+Marks a block free.  This is a single store so it is safe from any context; the space is reclaimed by 
+ReclaimMessageBlocks() the next time the main loop allocates.
+
+Requires:
+  - psBlock_ points to an allocated block in the arena that is no longer in any queue
+
+Promises:
+  - psBlock_->bFree = TRUE
+*/
+static void ReleaseMessageBlock(MessageBlockType* psBlock_)
+{
+  psBlock_->bFree = TRUE;
+  
+} /* end ReleaseMessageBlock() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ReclaimMessageBlocks()
+
+Description:
+Advances the arena tail past every free block at the old end of the ring.  A free block stuck behind a live block
+is reclaimed once the live block is released.  Only the main loop changes the head, tail and wrap offsets, so
+an ISR releasing a block during this function is simply picked up on the next call.
+
+Requires:
+  - Called from the main loop only
+
+Promises:
+  - Msg_u32ArenaTail, Msg_u32ArenaWrap and Msg_u16QueuedMessageCount are updated
+  - Msg_u32ArenaHead and Msg_u32ArenaTail are reset to 0 if the arena is empty
+*/
+static void ReclaimMessageBlocks(void)
+{
+  MessageBlockType* psTailBlock;
+  
+  while(Msg_u16QueuedMessageCount != 0)
+  {
+    psTailBlock = (MessageBlockType*)( MSG_ALLOCATOR_BASE + Msg_u32ArenaTail );
+    if(!psTailBlock->bFree)
+    {
+      return;
+    }
+    
+    Msg_u32ArenaTail += psTailBlock->u32BlockSize;
+    Msg_u16QueuedMessageCount--;
+    if(Msg_u32ArenaTail == Msg_u32ArenaWrap)
+    {
+      Msg_u32ArenaTail = 0;
+      Msg_u32ArenaWrap = MSG_ALLOCATOR_SIZE;
+    }
+  }
+
+  /* Empty arena: start again at the bottom for the best chance of fitting large blocks */
+  Msg_u32ArenaHead = 0;
+  Msg_u32ArenaTail = 0;
+  Msg_u32ArenaWrap = MSG_ALLOCATOR_SIZE;
+  
+} /* end ReclaimMessageBlocks() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ArenaBytesUsed()
+
+Description:
+Reports how much of the message arena is in use, including free blocks waiting to be reclaimed and the space 
+skipped at the top of the arena when the head wrapped.
+
+Requires:
+  - 
+
+Promises:
+  - Returns the number of bytes of the arena that are not available for allocation
+*/
+static u32 ArenaBytesUsed(void)
+{
+  if(Msg_u32ArenaHead >= Msg_u32ArenaTail)
+  {
+    return(Msg_u32ArenaHead - Msg_u32ArenaTail);
+  }
+  
+  return(MSG_ALLOCATOR_SIZE - Msg_u32ArenaTail + Msg_u32ArenaHead);
+  
+} /* end ArenaBytesUsed() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ArenaLargestPayload()
+
+Description:
+Finds the largest copied payload that AllocateMessageBlock() can place right now.  The block goes above the head 
+if anything fits there, so that space is used before the head wraps to the bottom of the arena.
+
+Requires:
+  - Called from the main loop only
+
+Promises:
+  - Blocks freed since the last allocation are reclaimed
+  - Returns the payload size in bytes (a multiple of 4); 0 if not even an empty payload fits
+*/
+static u32 ArenaLargestPayload(void)
+{
+  u32 u32Header = MessageBlockSize(0);
+  u32 u32Space;
+  
+  ReclaimMessageBlocks();
+  
+  /* Not wrapped: above the head, or below the tail with the head staying strictly below it */
+  if(Msg_u32ArenaHead >= Msg_u32ArenaTail)
+  {
+    u32Space = MSG_ALLOCATOR_SIZE - Msg_u32ArenaHead;
+    if( (u32Space <= u32Header) && (Msg_u32ArenaTail > 0) )
+    {
+      u32Space = Msg_u32ArenaTail - 4;
+    }
+  }
+  /* Wrapped: between the head and the tail, again staying strictly below the tail */
+  else
+  {
+    u32Space = Msg_u32ArenaTail - Msg_u32ArenaHead - 4;
+  }
+  
+  if(u32Space <= u32Header)
+  {
+    return(0);
+  }
+  
+  return(u32Space - u32Header);
+  
+} /* end ArenaLargestPayload() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessageStatusIsLive()
+
+Description:
+Checks whether the status entry that u32Token_ would use still belongs to a message that has not finished.
+
+Requires:
+  - u32Token_ is a token that may be issued
+
+Promises:
+  - Returns TRUE if the entry at (u32Token_ & STATUS_QUEUE_MASK) is WAITING, SENDING or RECEIVING
+*/
+static bool MessageStatusIsLive(u32 u32Token_)
+{
+  u8 u8State = Msg_StatusQueue[u32Token_ & STATUS_QUEUE_MASK].u8State;
+  
+  return( (bool)( (u8State == WAITING) || (u8State == SENDING) || (u8State == RECEIVING) ) );
+  
+} /* end MessageStatusIsLive() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: AddNewMessageStatus()
+
+Description:
+Adds a new mesage into the status queue.  Due to the tendancy of applications to forget that they wrote
+a message here, this buffer will overwite the final status of an old message if it needs space for a new 
+message.  IssueMessageToken() never passes a token whose entry is still live (see MessageStatusIsLive).
+
+Requires:
+  - u32Token_ is the message of interest and its entry is not live
+  - u8QueueId_ is the telemetry id of the queue the message is in
+
+Promises:
+  - A new status is created at index (u32Token_ & STATUS_QUEUE_MASK)
+*/
+static void AddNewMessageStatus(u32 u32Token_, u8 u8QueueId_)
+{
+  MessageStatus* psStatus = &Msg_StatusQueue[u32Token_ & STATUS_QUEUE_MASK];
+
+  /* Install the new message message */
+  psStatus->u32Token = u32Token_;
+  psStatus->u8State = WAITING;
+  psStatus->u32Timestamp = G_u32SystemTime1ms;
+  psStatus->pfnNotify = NULL;
+  psStatus->pu32EventFlags = NULL;
+  psStatus->u32EventMask = 0;
+  psStatus->u32NotifyToken = 0;
+  psStatus->u8QueueId = u8QueueId_;
+  
+} /* end AddNewMessageStatus() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: RecordLatency()
+
+Description:
+Adds one latency sample to a histogram.  Bucket n holds 2^(n-1) to 2^n - 1 ms so the bucket is just the number
+of significant bits in the latency.
+
+Requires:
+  - pu32Histogram_ points to an array of MSG_LATENCY_BUCKETS counters
+  - u32Latency_ is the latency in ms
+
+Promises:
+  - The counter for the latency's bucket is incremented with AtomicAdd() (status updates run in ISRs and the main loop)
+*/
+static void RecordLatency(u32* pu32Histogram_, u32 u32Latency_)
+{
+  u8 u8Bucket = 0;
+  
+  while( (u32Latency_ != 0) && (u8Bucket < (MSG_LATENCY_BUCKETS - 1)) )
+  {
+    u32Latency_ >>= 1;
+    u8Bucket++;
+  }
+  
+  AtomicAdd(&pu32Histogram_[u8Bucket], 1);
+  
+} /* end RecordLatency() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: NotifyMessageStatus()
+
+Description:
+Delivers the notification attached to a status entry.  The notification is disarmed with LDREX/STREX before it
+is delivered, so it is only ever delivered once even if the main loop and an ISR both finalize the message.
+
+Requires:
+  - psStatus_ points to a status entry that has just reached a final state
+
+Promises:
+  - If a notification was armed, the event bits are set, the callback is run and u32NotifyToken is 0
+*/
+static void NotifyMessageStatus(MessageStatus* psStatus_)
+{
+  do
+  {
+    if(__LDREXW( (u32*)&psStatus_->u32NotifyToken ) == 0)
+    {
+      return;
+    }
+  } while( __STREXW(0, (u32*)&psStatus_->u32NotifyToken) != 0 );
+  
+  if(psStatus_->pu32EventFlags != NULL)
+  {
+    *psStatus_->pu32EventFlags |= psStatus_->u32EventMask;
+  }
+  
+  if(psStatus_->pfnNotify != NULL)
+  {
+    psStatus_->pfnNotify(psStatus_->u32Token, (MessageStateType)psStatus_->u8State);
+  }
+  
+} /* end NotifyMessageStatus() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ScavengeStatusQueue()
+
+Description:
+Checks the next MSG_SCAVENGE_STATUS_PER_TICK entries of the status queue and removes final states that no client
+has collected: COMPLETE after MSG_STATUS_COMPLETE_TIME and TIMEOUT or ABANDONED after MSG_STATUS_TIMEOUT_TIME.
+WAITING and SENDING entries are left alone since their messages are still owned by a queue; ScavengeMessageQueue() 
+deals with those.  The whole status queue is covered every STATUS_QUEUE_SIZE / MSG_SCAVENGE_STATUS_PER_TICK ms.
+
+Requires:
+  - Called from the messaging state machine
+
+Promises:
+  - Stale final entries are set to EMPTY and counted in Msg_sScavengerStats.u32StatusesAged
+  - Msg_u16ScavengeStatusIndex is advanced
+*/
+static void ScavengeStatusQueue(void)
+{
+  MessageStatus* psStatus;
+  u32 u32Token;
+  u32 u32Age;
+  
+  for(u8 i = 0; i < MSG_SCAVENGE_STATUS_PER_TICK; i++)
   {
-    pListParser->eState = eNewState_;
+    psStatus = &Msg_StatusQueue[Msg_u16ScavengeStatusIndex];
+    Msg_u16ScavengeStatusIndex = (Msg_u16ScavengeStatusIndex + 1) & STATUS_QUEUE_MASK;
+    
+    /* An ISR can change the state at any time so the entry is checked inside an LDREX/STREX window on the token.  
+    Clearing the token is the commit: an ISR ignores the entry from then on. */
+    do
+    {
+      u32Token = __LDREXW( (u32*)&psStatus->u32Token );
+      u32Age = G_u32SystemTime1ms - psStatus->u32Timestamp;
+      
+      if( !( ( (psStatus->u8State == COMPLETE) && (u32Age > MSG_STATUS_COMPLETE_TIME) ) ||
+             ( ( (psStatus->u8State == TIMEOUT) || (psStatus->u8State == ABANDONED) ) && (u32Age > MSG_STATUS_TIMEOUT_TIME) ) ) )
+      {
+        break;
+      }
+    } while( __STREXW(0, (u32*)&psStatus->u32Token) != 0 );
+    
+    if( (u32Token != 0) && (psStatus->u32Token == 0) )
+    {
+      psStatus->u8State = EMPTY;
+      Msg_sScavengerStats.u32StatusesAged++;
+    }
   }
   
-} /* end UpdateMessageStatus() */
+} /* end ScavengeStatusQueue() */
 
 
-/*--------------------------------------------------------------------------------------------------------------------*/
-/* Private functions */
-/*--------------------------------------------------------------------------------------------------------------------*/
+/*----------------------------------------------------------------------------------------------------------------------
+Function: ScavengeMessageQueue()
+
+Description:
+Enforces MSG_STATUS_WAITING_TIME on one transmit queue.  The head message belongs to the peripheral (it may be 
+in the middle of a PDC transfer) so it is never removed; if it is overdue its status is set to TIMEOUT so the client
+finds out.  Messages behind an overdue head cannot be sent in time, so the oldest ones are set to ABANDONED 
+and their arena space is released, up to MSG_SCAVENGE_RECLAIM_PER_TICK per call.  Messages in a queue are in age
+order, so the walk stops at the first message that is not overdue.  The last message in the queue is left for the
+producer to link behind, so at least the head and tail stay queued.  A SENDING message behind the head has been
+chained in to the peripheral's DMA next pointer (its block has bSending set) so the walk stops there too.
+
+The peripheral ISR may dequeue the head at any time, so each message is unlinked with UnlinkMessage() which 
+only succeeds if the head has not moved.  The head's status is changed to TIMEOUT with LDREXB/STREXB so it never
+overwrites a COMPLETE set by the ISR, and no interrupts are disabled.
+
+Requires:
+  - psQueue_ is a registered transmit queue
+  - Called from the main loop (the queue's producer)
+
+Promises:
+  - Overdue messages are handled as above and counted in Msg_sScavengerStats
+*/
+static void ScavengeMessageQueue(MessageQueueType* psQueue_)
+{
+  MessageType* psHead = psQueue_->psHead;
+  MessageType* psMessage;
+  MessageStatus* psStatus;
+  u8 u8State;
+  u32 u32CurrentTime = G_u32SystemTime1ms;
+  
+  /* A dequeued head stays readable until the main loop reclaims it, so the snapshot is safe to inspect */
+  if( (psHead == NULL) || ( (u32CurrentTime - psHead->u32Timestamp) <= MSG_STATUS_WAITING_TIME) )
+  {
+    return;
+  }
+  
+  /* Tell the owner of a stuck head message, once.  The ISR may complete it at any time so the state is only 
+  changed if no interrupt ran since it was checked. */
+  psStatus = &Msg_StatusQueue[psHead->u32Token & STATUS_QUEUE_MASK];
+  do
+  {
+    u8State = __LDREXB( (u8*)&psStatus->u8State );
+    if( (psStatus->u32Token != psHead->u32Token) || ( (u8State != WAITING) && (u8State != SENDING) ) )
+    {
+      u8State = EMPTY;
+      break;
+    }
+  } while( __STREXB(TIMEOUT, (u8*)&psStatus->u8State) != 0 );
+  
+  if(u8State != EMPTY)
+  {
+    psStatus->u32Timestamp = G_u32SystemTime1ms;
+    Msg_sScavengerStats.u32TimedOut++;
+    NotifyMessageStatus(psStatus);
+  }
+  
+  /* Reclaim the oldest messages waiting behind it */
+  for(u8 i = 0; i < MSG_SCAVENGE_RECLAIM_PER_TICK; i++)
+  {
+    psMessage = psHead->psNextMessage;
+    if( (psMessage == NULL) || (psMessage == psQueue_->psTail) ||
+        ( (u32CurrentTime - psMessage->u32Timestamp) <= MSG_STATUS_WAITING_TIME) )
+    {
+      break;
+    }
+    
+    /* Stop if the peripheral has moved on or has chained the message in to its DMA; the scavenger will look 
+    again next time round */
+    if(!UnlinkMessage(psQueue_, psHead, psMessage))
+    {
+      break;
+    }
+    
+    AtomicAdd(&psQueue_->u32Count, (u32)-1);
+    AtomicAdd(&psQueue_->u32BytesUsed, 0 - ((MessageBlockType*)psMessage)->u32BlockSize);
+    
+    UpdateMessageStatus(psMessage->u32Token, ABANDONED);
+    Msg_sScavengerStats.u32Abandoned++;
+    Msg_sScavengerStats.u32BytesReclaimed += psMessage->u32Size;
+    ReleaseMessageBlock( (MessageBlockType*)psMessage );
+  }
+  
+} /* end ScavengeMessageQueue() */
+
 
 /*----------------------------------------------------------------------------------------------------------------------
-Function: AddNewMessageStatus()
+Function: MessageSpaceAvailable()
 
 Description:
-Adds a new mesage into the status queue.  Due to the tendancy of applications to forget that they wrote
-a message here, this buffer is circular and will overwite the oldest message if it needs space for a 
-new message.
+Checks a client's byte quota, its priority class reserve and the free space in the arena before anything is
+allocated, so only the offending client is refused.  Whether the space is contiguous is left to 
+AllocateMessageBlock().
 
 Requires:
-  - u32Token_ is the message of interest
+  - Called from the main loop only
+  - u32Bytes_ is the total size of the arena blocks the client wants to add
 
 Promises:
-  - A new status is created indexed by u32Token_
+  - Blocks freed since the last allocation are reclaimed
+  - Returns FALSE and sets _MESSAGING_TX_QUOTA_FULL if the queue's byte quota or its class's reserve would be exceeded
+  - Returns FALSE and sets _MESSAGING_TX_QUEUE_FULL if the arena does not have u32Bytes_ free
+  - Returns TRUE otherwise
 */
-static void AddNewMessageStatus(u32 u32Token_)
+static bool MessageSpaceAvailable(MessageQueueType* psTargetQueue_, u32 u32Bytes_)
 {
-  /* Install the new message message */
-  Msg_pNextStatus->u32Token = u32Token_;
-  Msg_pNextStatus->eState = WAITING;
-  Msg_pNextStatus->u32Timestamp = G_u32SystemTime1ms;
+  u32 u32Reserve = 0;
   
-  /* Safely advance the pointer */
-  Msg_pNextStatus++;
-  if(Msg_pNextStatus == &Msg_StatusQueue[STATUS_QUEUE_SIZE])
+  if(psTargetQueue_->ePriority == MSG_PRIORITY_LOW)
+  {
+    u32Reserve = MSG_RESERVE_LOW;
+  }
+  else if(psTargetQueue_->ePriority == MSG_PRIORITY_NORMAL)
   {
-    Msg_pNextStatus = &Msg_StatusQueue[0];
+    u32Reserve = MSG_RESERVE_NORMAL;
   }
   
-} /* end AddNewMessageStatus() */
+  ReclaimMessageBlocks();
+  if( (psTargetQueue_->u32ByteQuota != 0) && 
+      ( (psTargetQueue_->u32BytesUsed + u32Bytes_) > psTargetQueue_->u32ByteQuota) )
+  {
+    G_u32MessagingFlags |= _MESSAGING_TX_QUOTA_FULL;
+    Msg_sStats.u32QuotaFull++;
+    return(FALSE);
+  }
+  
+  /* An arena with no room at all is full for everyone rather than this client's quota */
+  if( (ArenaBytesUsed() + u32Bytes_) > MSG_ARENA_SIZE )
+  {
+    G_u32MessagingFlags |= _MESSAGING_TX_QUEUE_FULL;
+    Msg_sStats.u32QueueFull++;
+    return(FALSE);
+  }
+  
+  if( (ArenaBytesUsed() + u32Bytes_ + u32Reserve) > MSG_ARENA_SIZE )
+  {
+    G_u32MessagingFlags |= _MESSAGING_TX_QUOTA_FULL;
+    Msg_sStats.u32QuotaFull++;
+    return(FALSE);
+  }
+  
+  return(TRUE);
+  
+} /* end MessageSpaceAvailable() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: AddMessageToQueue()
+
+Description:
+Allocates an arena block for one message, assigns the next token, and appends the message to the target queue.
+
+Requires:
+  - u32Size_ is the number of bytes in the message
+  - pu8Data_ points to the message data
+  - bCopy_ is TRUE to copy the data in to the block; FALSE to transmit directly from pu8Data_
+
+Promises:
+  - Returns a pointer to the new message which is at psTargetQueue_->psTail
+  - The message status is added as WAITING and Msg_u32Token is advanced
+  - Returns NULL and sets _MESSAGING_TX_QUOTA_FULL if the queue's byte quota or its class's reserve would be exceeded
+  - Returns NULL and sets _MESSAGING_TX_QUEUE_FULL if the arena itself does not have space or no token can be issued
+  - Must only be called from the main loop: it is the single producer for every queue and owns the arena
+*/
+static MessageType* AddMessageToQueue(MessageQueueType* psTargetQueue_, u32 u32Size_, u8* pu8Data_, bool bCopy_)
+{
+  MessageBlockType *psNewBlock;
+  MessageType *psNewMessage;
+  u8* pu8Payload;
+  u32 u32PayloadSize = bCopy_ ? u32Size_ : 0;
+  u32 u32BlockSize = MessageBlockSize(u32PayloadSize);
+  
+  if(!MessageSpaceAvailable(psTargetQueue_, u32BlockSize))
+  {
+    return(NULL);
+  }
+  
+  /* Allocate the block: a reference message needs only the header.  This also fails if the free space is 
+  split between the top and the bottom of the arena. */
+  psNewBlock = AllocateMessageBlock(u32PayloadSize);
+  if(psNewBlock == NULL)
+  {
+    G_u32MessagingFlags |= _MESSAGING_TX_QUEUE_FULL;
+    Msg_sStats.u32QueueFull++;
+    return(NULL);
+  }
+  
+  /* Post the status before the peripheral can see the message so its first update is not lost.  The block is 
+  not in any queue yet, so it can simply be handed back if every status entry is live. */
+  psNewMessage = &(psNewBlock->Message);
+  psNewMessage->u32Token = IssueMessageToken(psTargetQueue_->u8QueueId);
+  if(psNewMessage->u32Token == 0)
+  {
+    ReleaseMessageBlock(psNewBlock);
+    return(NULL);
+  }
+  
+  /* Update the telemetry high-water marks */
+  Msg_sStats.u32Enqueues++;
+  if(ArenaBytesUsed() > Msg_sStats.u32ArenaBytesHighWater)
+  {
+    Msg_sStats.u32ArenaBytesHighWater = ArenaBytesUsed();
+  }
+  if(Msg_u16QueuedMessageCount > Msg_sStats.u32MessagesHighWater)
+  {
+    Msg_sStats.u32MessagesHighWater = Msg_u16QueuedMessageCount;
+  }
+  
+  /* Flag if we're above the high watermark */
+  if(ArenaBytesUsed() >= MSG_ARENA_WATERMARK)
+  {
+    G_u32MessagingFlags |= _MESSAGING_TX_QUEUE_ALMOST_FULL;
+  }
+  else
+  {
+    G_u32MessagingFlags &= ~_MESSAGING_TX_QUEUE_ALMOST_FULL;
+  }
+  
+  /* Set up the message structure */
+  psNewMessage->u32Size       = u32Size_;
+  psNewMessage->u32Timestamp  = G_u32SystemTime1ms;
+  psNewMessage->psNextMessage = NULL;
+  
+  if(bCopy_)
+  {
+    /* Add the data into the payload that follows the block header */
+    pu8Payload = (u8*)(psNewBlock + 1);
+    for(u32 i = 0; i < u32Size_; i++)
+    {
+      pu8Payload[i] = *pu8Data_++;
+    }
+    psNewMessage->pu8Data = pu8Payload;
+  }
+  else
+  {
+    psNewMessage->pu8Data = pu8Data_;
+  }
+  
+  /* Count the message first so the consumer never takes the counts below zero */
+  AtomicAdd(&psTargetQueue_->u32Count, 1);
+  AtomicAdd(&psTargetQueue_->u32BytesUsed, u32BlockSize);
+  LinkMessage(psTargetQueue_, psNewMessage);
+
+  return(psNewMessage);
+  
+} /* end AddMessageToQueue() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: LinkMessage()
+
+Description:
+Appends a message to a queue without disabling interrupts.  The main loop is the only producer and runs to the end
+of this function only once any consumer ISR has finished, but the ISR can interrupt it at any point:
+  1. The new message is swapped in to psTail with LDREX/STREX.  If the ISR empties the queue during the swap it 
+     clears psTail, the STREX fails because exception entry clears the exclusive monitor, and the swap is retried.
+  2. The message is linked behind the old tail.  If the ISR has already dequeued the old tail, the block is 
+     still intact (only the main loop reclaims arena space) so the store is harmless.
+  3. If the ISR has run out of messages (psHead is NULL) while psTail is still this message, it never saw the 
+     link so the message is published to psHead directly.
+
+Requires:
+  - Called from the main loop only
+  - psMessage_ is fully set up and its status has been posted
+
+Promises:
+  - psMessage_ is the last message in psQueue_ and will be seen by the consumer
+*/
+static void LinkMessage(MessageQueueType* psQueue_, MessageType* psMessage_)
+{
+  MessageType* psOldTail;
+  
+  psMessage_->psNextMessage = NULL;
+  
+  do
+  {
+    psOldTail = (MessageType*)LoadExclusivePointer( (void* volatile*)&psQueue_->psTail );
+  } while( !StoreExclusivePointer((void* volatile*)&psQueue_->psTail, psMessage_) );
+  
+  if(psOldTail != NULL)
+  {
+    psOldTail->psNextMessage = psMessage_;
+  }
+  
+  /* A non-NULL head reaches this message through the links; psTail moving on means the consumer already took it */
+  do
+  {
+    if( (LoadExclusivePointer((void* volatile*)&psQueue_->psHead) != NULL) || 
+        (psQueue_->psTail != psMessage_) )
+    {
+      return;
+    }
+  } while( !StoreExclusivePointer((void* volatile*)&psQueue_->psHead, psMessage_) );
+  
+} /* end LinkMessage() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UnlinkMessage()
+
+Description:
+Removes a message from the middle of a queue while the consumer ISR may be dequeuing the head.  The link is 
+changed with STREX which only succeeds if no interrupt occurred since psPrevious_->psNextMessage was loaded, and
+psPrevious_ is confirmed to still be the head inside that window.  The consumer therefore either dequeues 
+psPrevious_ before the change and the unlink is refused, or after it and skips psMessage_.  A message whose block
+has bSending set has been given to the peripheral's PDC and is never unlinked; the flag is set before the PDC is
+loaded and is checked inside the window, so a chain that races the unlink always makes the STREX fail.
+
+Requires:
+  - Called from the main loop only (so the producer cannot change psMessage_->psNextMessage)
+  - psPrevious_ was the head of psQueue_ and psMessage_ is not the tail
+
+Promises:
+  - Returns TRUE if psMessage_ has been removed from the queue; the counts are not changed
+  - Returns FALSE if psPrevious_ is no longer the head, psMessage_ no longer follows it or psMessage_ is SENDING
+*/
+static bool UnlinkMessage(MessageQueueType* psQueue_, MessageType* psPrevious_, MessageType* psMessage_)
+{
+  do
+  {
+    if( (LoadExclusivePointer(&psPrevious_->psNextMessage) != psMessage_) || 
+        (psQueue_->psHead != psPrevious_) || 
+        ( (MessageBlockType*)psMessage_ )->bSending )
+    {
+      return(FALSE);
+    }
+  } while( !StoreExclusivePointer(&psPrevious_->psNextMessage, psMessage_->psNextMessage) );
+  
+  return(TRUE);
+  
+} /* end UnlinkMessage() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: AtomicAdd()
+
+Description:
+Adds to a counter that is shared between the main loop and ISRs using LDREX/STREX.  Use (u32)-n to subtract.
+
+Requires:
+  - pu32Target_ points to a word-aligned counter
+
+Promises:
+  - *pu32Target_ += u32Value_ without a lost update
+*/
+static void AtomicAdd(volatile u32* pu32Target_, u32 u32Value_)
+{
+  u32 u32Result;
+  
+  do
+  {
+    u32Result = __LDREXW( (u32*)pu32Target_ ) + u32Value_;
+  } while( __STREXW(u32Result, (u32*)pu32Target_) != 0 );
+  
+} /* end AtomicAdd() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: LoadExclusivePointer()
+
+Description:
+LDREX of a pointer.  Pointers are 32 bits on the SAM3U.
+
+Requires:
+  - ppvTarget_ points to a word-aligned pointer
+
+Promises:
+  - Returns *ppvTarget_ and opens the exclusive monitor for StoreExclusivePointer()
+*/
+static void* LoadExclusivePointer(void* volatile* ppvTarget_)
+{
+  return( (void*)__LDREXW( (u32*)ppvTarget_ ) );
+  
+} /* end LoadExclusivePointer() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: StoreExclusivePointer()
+
+Description:
+STREX of a pointer.  Fails if anything (including any interrupt) has happened since LoadExclusivePointer().
+
+Requires:
+  - LoadExclusivePointer() was called on ppvTarget_ 
+
+Promises:
+  - Returns TRUE and *ppvTarget_ = pvValue_ if the store succeeded
+  - Returns FALSE with *ppvTarget_ unchanged if the exclusive access was lost
+*/
+static bool StoreExclusivePointer(void* volatile* ppvTarget_, void* pvValue_)
+{
+  if( __STREXW((u32)pvValue_, (u32*)ppvTarget_) == 0 )
+  {
+    return(TRUE);
+  }
+  
+  return(FALSE);
+  
+} /* end StoreExclusivePointer() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MessagingIsIdle()
+
+Description:
+Checks that no messages are in the arena so the benchmark and self test can use it without disturbing clients.
+
+Requires:
+  - Called from the main loop only
+
+Promises:
+  - Returns TRUE if the arena is empty (free blocks are reclaimed first)
+*/
+static bool MessagingIsIdle(void)
+{
+  ReclaimMessageBlocks();
+  
+  if(Msg_u16QueuedMessageCount == 0)
+  {
+    return(TRUE);
+  }
+  
+  return(FALSE);
+  
+} /* end MessagingIsIdle() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: InitializeTestQueue()
+
+Description:
+Sets up a private queue for the benchmark and self test.  Unlike InitializeMessageQueue() no telemetry id is used
+and the queue is HIGH priority so the whole arena is available.
+
+Requires:
+  - psQueue_ points to a queue that holds no messages
+
+Promises:
+  - psQueue_ is empty, MSG_PRIORITY_HIGH with no quota and has no telemetry id
+*/
+static void InitializeTestQueue(MessageQueueType* psQueue_)
+{
+  psQueue_->psHead       = NULL;
+  psQueue_->psTail       = NULL;
+  psQueue_->u32Count     = 0;
+  psQueue_->ePriority    = MSG_PRIORITY_HIGH;
+  psQueue_->u32ByteQuota = 0;
+  psQueue_->u32BytesUsed = 0;
+  psQueue_->u8QueueId    = MSG_NO_QUEUE_ID;
+  
+} /* end InitializeTestQueue() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BenchmarkTicks()
+
+Description:
+Reads a SysTick timestamp with SYSTICK_COUNT ticks per ms.  The SysTick counter counts down and reloads every ms
+so it is combined with G_u32SystemTime1ms; the read is repeated if the ms changed in the middle.
+
+Requires:
+  - SysTick is running
+
+Promises:
+  - Returns the time in SysTick ticks (wraps after about 12 minutes, so only use differences over short runs)
+*/
+static u32 BenchmarkTicks(void)
+{
+  u32 u32Time;
+  u32 u32Count;
+  
+  do
+  {
+    u32Time  = G_u32SystemTime1ms;
+    u32Count = AT91C_BASE_NVIC->NVIC_STICKCVR;
+  } while(u32Time != G_u32SystemTime1ms);
+  
+  return( (u32Time * SYSTICK_COUNT) + (SYSTICK_COUNT - 1 - u32Count) );
+  
+} /* end BenchmarkTicks() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: BenchmarkTicksToNs()
+
+Description:
+Converts a total number of SysTick ticks to the average time per operation in ns.
+
+Requires:
+  - u32Ticks_ is less than about 700 ms worth of ticks (4294967 ticks)
+
+Promises:
+  - Returns the average ns per operation (0 if u32Operations_ is 0)
+*/
+static u32 BenchmarkTicksToNs(u32 u32Ticks_, u32 u32Operations_)
+{
+  if(u32Operations_ == 0)
+  {
+    return(0);
+  }
+  
+  /* SYSTICK_COUNT ticks is 1000000 ns; split the scaling to stay inside 32 bits */
+  return( ( ((u32Ticks_ * 1000) / u32Operations_) * 1000) / SYSTICK_COUNT );
+  
+} /* end BenchmarkTicksToNs() */
 
 
 /**********************************************************************************************************************
@@ -441,17 +2142,20 @@ State Machine Function Definitions
 **********************************************************************************************************************/
 
 /*-------------------------------------------------------------------------------------------------------------------*/
-/* Do nothing for now */
+/* Scavenge stale messages: a small, fixed amount of work every ms so no single pass can violate the 1ms rule */
 void MessagingIdle(void)
 {
-  static u32 u32CleaningTime = MSG_STATUS_CLEANING_TIME;
+  ScavengeStatusQueue();
   
-  /* Periodically check for stale messages */
-  if(--u32CleaningTime == 0)
+  /* One queue per ms in round-robin order */
+  if(Msg_u8QueueCount != 0)
   {
-    u32CleaningTime = MSG_STATUS_CLEANING_TIME;
+    ScavengeMessageQueue(Msg_apsQueues[Msg_u8ScavengeQueueIndex]);
     
-    /* ??? Probably should add clean of the main message queue to detect any messages that have become stuck */
+    if(++Msg_u8ScavengeQueueIndex >= Msg_u8QueueCount)
+    {
+      Msg_u8ScavengeQueueIndex = 0;
+    }
   }
     
 } /* end MessagingIdle() */
@@ -17,19 +17,54 @@ Constants / Definitions
 #define _MESSAGING_TX_QUEUE_ALMOST_FULL (u32)0x00000002
 #define _DEQUEUE_GOT_NULL               (u32)0x00000004
 #define _DEQUEUE_MSG_NOT_FOUND          (u32)0x00000008
+#define _MESSAGING_MSG_TOO_LARGE        (u32)0x00000010
+#define _MESSAGING_TOO_MANY_QUEUES      (u32)0x00000020
+#define _MESSAGING_TX_QUOTA_FULL        (u32)0x00000040
   
 /* Tx buffer allocation: be aware of RAM usage when selecting the parameters below.
-Queue size in bytes is TX_QUEUE_SIZE x MAX_TX_MESSAGE_LENGTH */
-
-#define TX_QUEUE_SIZE                   (u8)16         /* Number of messages allowed in the queue */
-#define MAX_TX_MESSAGE_LENGTH           (u16)128       /* Max bytes in message payload */
-#define TX_QUEUE_WATERMARK              (u8)(TX_QUEUE_SIZE - 2) /* Number of messages in the queue that will trigger a warning flag */
-#define STATUS_QUEUE_SIZE               (u8)64         /* Number of message statusi to maintain */
+Messages are stored in a byte ring of MSG_ARENA_SIZE bytes.  Each message uses sizeof(MessageBlockType) header bytes
+plus its payload rounded up to a multiple of 4 (reference messages use only the header). */
+
+#ifndef MSG_ARENA_SIZE /* The host test build may use a larger arena */
+#define MSG_ARENA_SIZE                  (u32)2048      /* Bytes in the message arena: MUST be a multiple of 4 */
+#endif
+#define MSG_ARENA_WATERMARK             (u32)(MSG_ARENA_SIZE - (MSG_ARENA_SIZE / 8)) /* Bytes used in the arena that will trigger a warning flag */
+#define MSG_RESERVE_LOW                 (u32)512       /* Arena bytes that MSG_PRIORITY_LOW queues must leave free */
+#define MSG_RESERVE_NORMAL              (u32)256       /* Arena bytes that MSG_PRIORITY_NORMAL queues must leave free */
+#define MAX_TX_MESSAGE_LENGTH           (u16)1024      /* Max bytes in one copied message block; longer payloads are split */
+#define MAX_TX_REFERENCE_LENGTH         (u32)0xFFFF    /* Max bytes in a QueueMessageReference message (size of PDC counter) */
+#define MSG_ISSUED_TOKENS               (u32)32        /* Most IssueMessageToken() messages that can be live at once (the TWI descriptor ring) */
+#ifndef STATUS_QUEUE_SIZE /* Overridden along with MSG_ARENA_SIZE */
+#define STATUS_QUEUE_SIZE               (u16)128       /* Number of message statusi to maintain: MUST be a power of 2 of at least 
+                                                          MSG_ARENA_SIZE / sizeof(MessageBlockType) + MSG_ISSUED_TOKENS */
+#endif
+#define STATUS_QUEUE_MASK               (u32)(STATUS_QUEUE_SIZE - 1) /* AND with a token to get its status queue index */
+#define MSG_MAX_QUEUES                  (u8)10         /* Number of transmit queues the scavenger can watch and the telemetry can track */
+#define MSG_NO_QUEUE_ID                 (u8)0xFF       /* u8QueueId of a queue that has no telemetry slot */
+#define MSG_LATENCY_BUCKETS             (u8)8          /* Latency histogram buckets: 0, 1, 2-3, 4-7, 8-15, 16-31, 32-63, 64+ ms */
+
+#define MSG_BENCHMARK_CYCLES            (u32)100000    /* Number of allocate/release pairs run by MessagingBenchmark() */
+#define MSG_BENCHMARK_PAYLOAD_SIZE      (u32)16        /* Payload bytes of each block allocated by MessagingBenchmark() */
+#define MSG_BENCHMARK_TIME              (u32)20        /* Time in ms that each MessagingBenchmarkQueue() run lasts */
+#define MSG_BENCHMARK_MAX_DEPTH         (u32)16        /* Max messages queued at once by MessagingBenchmarkQueue() */
+#define MSG_SELFTEST_MESSAGES           (u32)4096      /* Messages queued by MessagingSelfTest() */
+#define MSG_SELFTEST_QUEUES             (u8)3          /* Private queues (simulated clients) used by MessagingSelfTest() */
+#define MSG_SELFTEST_MAX_SIZE           (u32)64        /* Max payload bytes of a MessagingSelfTest() message */
+
+/* MessagingSelfTest() result: 0 is a pass */
+#define _MSG_SELFTEST_BUSY              (u32)0x00000001  /* Messages were queued so the test did not run */
+#define _MSG_SELFTEST_TOKEN             (u32)0x00000002  /* A token was 0 or out of sequence */
+#define _MSG_SELFTEST_ROLLOVER          (u32)0x00000004  /* The token did not roll over from 0xFFFFFFFF to 1 */
+#define _MSG_SELFTEST_STATUS            (u32)0x00000008  /* A message status was not as expected */
+#define _MSG_SELFTEST_DATA              (u32)0x00000010  /* A message payload was corrupted */
+#define _MSG_SELFTEST_CONSERVATION      (u32)0x00000020  /* Queue counts and arena blocks disagreed or the arena did not empty */
 
 #define MSG_STATUS_COMPLETE_TIME        (u32)1000      /* Max time in ms that a message status can sit in the status queue in a COMPLETE state */
 #define MSG_STATUS_WAITING_TIME         (u32)1000      /* Max time in ms that a message can sit in the queue in a WAITING state */
-#define MSG_STATUS_TIMEOUT_TIME         (u32)1500      /* Max time in ms that a message status can sit in the status queue in a TIMEOUT state */
-#define MSG_STATUS_CLEANING_TIME        (u32)1000      /* Time in ms between cleaning the message queue */
+#define MSG_STATUS_TIMEOUT_TIME         (u32)1500      /* Max time in ms that a message status can sit in the status queue in a TIMEOUT or ABANDONED state */
+
+#define MSG_SCAVENGE_STATUS_PER_TICK    (u8)4          /* Status entries checked by MessagingIdle each ms */
+#define MSG_SCAVENGE_RECLAIM_PER_TICK   (u8)4          /* Max stale messages reclaimed from one queue each ms */
 
 
 /**********************************************************************************************************************
@@ -37,28 +72,94 @@ Type Definitions
 **********************************************************************************************************************/
 typedef enum {EMPTY = 0, WAITING, SENDING, RECEIVING, COMPLETE, TIMEOUT, ABANDONED, NOT_FOUND = 0xff} MessageStateType;
 
+/* Transmit queue priority class: each class must leave a reserve of arena bytes free for the classes above it.
+NORMAL is 0 so that a zeroed peripheral configuration gets the default class. */
+typedef enum {MSG_PRIORITY_NORMAL = 0, MSG_PRIORITY_LOW, MSG_PRIORITY_HIGH} MessagePriorityType;
+
+/* Message completion callback: receives the token and its final state (COMPLETE, TIMEOUT or ABANDONED) */
+typedef void(*fnMessageNotify_type)(u32 u32Token_, MessageStateType eState_);
+
 /* Message struct for data messages */
 typedef struct
 {
   u32 u32Token;                         /* Unigue token for this message */
   u32 u32Size;                          /* Size of the data payload in bytes */
-  u8 pu8Message[MAX_TX_MESSAGE_LENGTH]; /* Data payload array */
-  void* psNextMessage;                  /* Pointer to next message */
+  u32 u32Timestamp;                     /* Time the message was queued */
+  u8* pu8Data;                          /* Data to send: the payload in the arena or the client's buffer for reference messages */
+  void* volatile psNextMessage;         /* Pointer to next message */
 } MessageType;
 
+/* Transmit queue owned by a peripheral: messages are added at psTail (main loop) and removed from psHead (peripheral ISR) */
 typedef struct
 {
-  bool bFree;                           /* TRUE if message slot is available */
-  MessageType Message;                  /* The slot's message */
-} MessageSlot;
+  MessageType* volatile psHead;         /* First message in the queue (next to send); NULL if empty */
+  MessageType* volatile psTail;         /* Last message in the queue; NULL if empty */
+  volatile u32 u32Count;                /* Number of messages in the queue */
+  MessagePriorityType ePriority;        /* Priority class of the queue's client */
+  u32 u32ByteQuota;                     /* Max arena bytes the queue may hold; 0 for no quota */
+  volatile u32 u32BytesUsed;            /* Arena bytes currently held by messages in the queue */
+  u8 u8QueueId;                         /* Telemetry id assigned in order of InitializeMessageQueue calls; MSG_NO_QUEUE_ID if none */
+} MessageQueueType;
+
+/* Header of every block in the message arena; a copied payload immediately follows the header */
+typedef struct
+{
+  MessageType Message;                  /* The block's message: MUST be first so a MessageType* is also the block address */
+  u32 u32BlockSize;                     /* Total bytes in the block including this header */
+  volatile bool bFree;                  /* TRUE once the message has been dequeued; the space is reclaimed by the next allocation */
+  volatile bool bSending;               /* TRUE once a peripheral has given the message to its PDC; the scavenger never reclaims it */
+} MessageBlockType;
 
 typedef struct
 {
   u32 u32Token;                         /* Unigue token for this message; a token is never 0 */
-  MessageStateType eState;              /* State of the message */
-  u32 u32Timestamp;                     /* Time the message status was posted */          
+  volatile u8 u8State;                  /* MessageStateType of the message; a byte so the scavenger can change it with LDREXB/STREXB */
+  u32 u32Timestamp;                     /* Time the message status was posted or last changed */          
+  fnMessageNotify_type pfnNotify;       /* Optional callback run when the message reaches a final state; NULL if none */
+  volatile u32* pu32EventFlags;         /* Optional flag register that gets u32EventMask set at a final state; NULL if none */
+  u32 u32EventMask;                     /* Bit(s) to set in *pu32EventFlags */
+  volatile u32 u32NotifyToken;          /* u32Token while a notification is armed; 0 once delivered or if none */
+  u8 u8QueueId;                         /* Telemetry id of the queue the message was added to */
 } MessageStatus;
 
+/* Running totals of the work done by the stale-message scavenger in MessagingIdle */
+typedef struct
+{
+  u32 u32TimedOut;                      /* Messages marked TIMEOUT because they sat at the head of a queue too long */
+  u32 u32Abandoned;                     /* Waiting messages marked ABANDONED and reclaimed from behind a stuck message */
+  u32 u32BytesReclaimed;                /* Payload bytes of the abandoned messages */
+  u32 u32StatusesAged;                  /* Final status entries removed because they were never queried */
+} MessageScavengerStatsType;
+
+/* Messaging telemetry totals since MessagingInitialize() or the last MessagingResetStats() */
+typedef struct
+{
+  u32 u32Enqueues;                      /* Messages added to a queue */
+  u32 u32Dequeues;                      /* Messages removed from a queue by their peripheral */
+  u32 u32TooLarge;                      /* Reference messages refused with _MESSAGING_MSG_TOO_LARGE */
+  u32 u32QueueFull;                     /* Messages refused with _MESSAGING_TX_QUEUE_FULL (no space in the arena or status queue) */
+  u32 u32QuotaFull;                     /* Messages refused with _MESSAGING_TX_QUOTA_FULL (queue quota or class reserve) */
+  u32 u32ArenaBytesHighWater;           /* Most arena bytes in use at once */
+  u32 u32MessagesHighWater;             /* Most messages in the arena at once */
+} MessagingStatsType;
+
+/* Result of one MessagingBenchmarkQueue() run */
+typedef struct
+{
+  u32 u32Depth;                         /* Messages queued before they were dequeued (may be less than requested) */
+  u32 u32Messages;                      /* Messages queued and dequeued during the run */
+  u32 u32QueueNs;                       /* Average QueueMessage() time in ns */
+  u32 u32StatusNs;                      /* Average UpdateMessageStatus() plus QueryMessageStatus() time in ns */
+  u32 u32DequeueNs;                     /* Average DeQueueMessage() time in ns */
+} MessagingBenchmarkType;
+
+/* Per-queue latency histograms; bucket n counts latencies of 2^(n-1) to 2^n - 1 ms (bucket 0 is 0 ms) */
+typedef struct
+{
+  u32 au32WaitTime[MSG_LATENCY_BUCKETS];  /* Time from queueing to SENDING */
+  u32 au32SendTime[MSG_LATENCY_BUCKETS];  /* Time from SENDING to COMPLETE */
+} MessageLatencyType;
+
 
 /**********************************************************************************************************************
 * Function Declarations
@@ -68,6 +169,11 @@ typedef struct
 /* Public functions */
 /*--------------------------------------------------------------------------------------------------------------------*/
 MessageStateType QueryMessageStatus(u32 u32Token_);
+bool SetMessageNotification(u32 u32Token_, fnMessageNotify_type pfnNotify_, volatile u32* pu32EventFlags_, u32 u32EventMask_);
+void MessagingGetScavengerStats(MessageScavengerStatsType* psStats_);
+void MessagingGetStats(MessagingStatsType* psStats_);
+bool MessagingGetLatency(u8 u8QueueId_, MessageLatencyType* psLatency_);
+void MessagingResetStats(void);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -76,16 +182,48 @@ MessageStateType QueryMessageStatus(u32 u32Token_);
 void MessagingInitialize(void);
 void MessagingRunActiveState(void);
 
-u32 QueueMessage(MessageType** eTargetTxBuffer_, u32 u32MessageSize_, u8* pu8MessageData_);
-void DeQueueMessage(MessageType** pTargetQueue_);
+void InitializeMessageQueue(MessageQueueType* psQueue_);
+void RegisterMessageQueue(MessageQueueType* psQueue_);
+void SetMessageQueuePriority(MessageQueueType* psQueue_, MessagePriorityType ePriority_, u32 u32ByteQuota_);
+u32 QueueMessage(MessageQueueType* psTargetQueue_, u32 u32MessageSize_, u8* pu8MessageData_);
+u32 QueueMessageReference(MessageQueueType* psTargetQueue_, u32 u32MessageSize_, u8* pu8MessageData_);
+u32 IssueMessageToken(u8 u8QueueId_);
+void DeQueueMessage(MessageQueueType* psTargetQueue_);
 
 void UpdateMessageStatus(u32 u32Token_, MessageStateType eNewState_);
+void MarkMessageSending(MessageType* psMessage_);
+
+u32 MessagingBenchmark(void);
+bool MessagingBenchmarkQueue(u32 u32MessageSize_, u32 u32Depth_, MessagingBenchmarkType* psResult_);
+u32 MessagingSelfTest(void);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Private functions */
 /*--------------------------------------------------------------------------------------------------------------------*/
-static void AddNewMessageStatus(u32 u32Token_);
+static bool MessageStatusIsLive(u32 u32Token_);
+static void AddNewMessageStatus(u32 u32Token_, u8 u8QueueId_);
+static void RecordLatency(u32* pu32Histogram_, u32 u32Latency_);
+static void NotifyMessageStatus(MessageStatus* psStatus_);
+static void ScavengeStatusQueue(void);
+static void ScavengeMessageQueue(MessageQueueType* psQueue_);
+static bool MessageSpaceAvailable(MessageQueueType* psTargetQueue_, u32 u32Bytes_);
+static MessageType* AddMessageToQueue(MessageQueueType* psTargetQueue_, u32 u32Size_, u8* pu8Data_, bool bCopy_);
+static void LinkMessage(MessageQueueType* psQueue_, MessageType* psMessage_);
+static bool UnlinkMessage(MessageQueueType* psQueue_, MessageType* psPrevious_, MessageType* psMessage_);
+static u32 MessageBlockSize(u32 u32PayloadSize_);
+static MessageBlockType* AllocateMessageBlock(u32 u32PayloadSize_);
+static void ReleaseMessageBlock(MessageBlockType* psBlock_);
+static void ReclaimMessageBlocks(void);
+static u32 ArenaBytesUsed(void);
+static u32 ArenaLargestPayload(void);
+static void AtomicAdd(volatile u32* pu32Target_, u32 u32Value_);
+static void* LoadExclusivePointer(void* volatile* ppvTarget_);
+static bool StoreExclusivePointer(void* volatile* ppvTarget_, void* pvValue_);
+static bool MessagingIsIdle(void);
+static void InitializeTestQueue(MessageQueueType* psQueue_);
+static u32 BenchmarkTicks(void);
+static u32 BenchmarkTicksToNs(u32 u32Ticks_, u32 u32Operations_);
 
 
 /***********************************************************************************************************************
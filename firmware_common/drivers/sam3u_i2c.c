@@ -4,6 +4,8 @@ File: sam3u_TWI.c
 Description: 
 Provides a driver to use TWI0 peripheral to send and receive data using interrupts.
 Currently Set at - 200kHz Master Mode.
+Message bodies are moved by the TWI PDC channel: the CPU only sets up the transfer, loads the last
+byte (writes) or the last two bytes (reads) so STOP lands in the right place, and handles TXCOMP.
 This is a simpler version of a serial system driver that does not use resource control
 through Request() and Release() calls
 
@@ -15,6 +17,7 @@ Public use Functions:
 
 bool TWI0ReadByte(u8 u8SlaveAddress_, u8* pu8RxBuffer_);
 bool TWI0ReadData(u8 u8SlaveAddress_, u8* pu8RxBuffer_, u32 u32Size_);
+bool TWI0WriteRead(u8 u8SlaveAddress_, u8* pu8TxData_, u8 u8TxSize_, u8* pu8RxBuffer_, u32 u32RxSize_);
 u32 TWIWriteByte(TWIPeripheralType* psTWIPeripheral_, u8 u8Byte_, TWIStopType Send_);
 u32 TWIWriteData(TWIPeripheralType* psTWIPeripheral_, u32 u32Size_, u8* u8Data_, TWIStopType Send_);
 
@@ -24,6 +27,10 @@ Both TWI0ReadByte and TWI0ReadData require that pu8RxBuffer is large enough to h
 As well it is assumed, that since you know the amount of data to be sent, a stop can be sent
 when all bytes have benn received (and not tie the data and clock line low).
 
+TWI0WriteRead is a register-style read in one bus transaction: up to 3 bytes (the register address) are
+written, then a repeated start reads the data.  It uses the peripheral's internal address feature so no
+separate write msg is queued.
+
 WriteByte and WriteData have the option to hold the lines low as it waits for more data 
 to be queue. If a stop condition is not sent only Writes can follow until a stop condition is
 requested (as the current transmission isn't complete).
@@ -63,13 +70,18 @@ static u32 TWI_u32Flags;                          /* Application flags for TWI *
 static TWIPeripheralType TWI_Peripheral0;         /* TWI0 peripheral object */
 static TWIPeripheralType* TWI0;
 
-static u32 TWI_u32CurrentBytesRemaining;                        /* Down counter for number of bytes being clocked out */
-static u8* TWI_pu8CurrentTxData;                                /* Pointer to current message being clocked out */
-static TWIMessageQueueType TWI_MessageBuffer[TX_QUEUE_SIZE];    /* A circular buffer that stores queued msgs stop condition */
+static u32 TWI_u32CurrentBytesRemaining;                        /* Bytes of the current msg left for the CPU after the PDC part */
+static u8* TWI_pu8CurrentTxData;                                /* Pointer to the next byte the CPU loads to THR */
+static TWIMessageQueueType TWI_MessageBuffer[TWI_QUEUE_SIZE];   /* Descriptor ring holding every queued msg and its write data */
 static u8 TWI_MessageBufferNextIndex;                           /* A pointer to the next position to place a message */
 static u8 TWI_MessageBufferCurIndex;                            /* A pointer to the current message that is being processed */
 static u8 TWI_MessageQueueLength;                               /* Counter to track the number of messages stored in the queue */
 
+/* Every message in the ring holds a live IssueMessageToken() token.  The messaging status queue is sized so a token can
+always be issued while no more than MSG_ISSUED_TOKENS of these are live.  The array size goes negative (a compile 
+error) if TWI_QUEUE_SIZE is too big. */
+typedef u8 TWI_QueueSizeCheck[(TWI_QUEUE_SIZE <= MSG_ISSUED_TOKENS) ? 1 : -1];
+
 
 /***********************************************************************************************************************
 Function Definitions
@@ -92,7 +104,7 @@ Promises:
 */
 bool TWI0ReadByte(u8 u8SlaveAddress_, u8* pu8RxBuffer_)
 {
-  if(TWI_MessageQueueLength == TX_QUEUE_SIZE || (TWI0->u32Flags & _TWI_TRANS_NOT_COMP))
+  if(TWI_MessageQueueLength == TWI_QUEUE_SIZE || (TWI0->u32Flags & _TWI_TRANS_NOT_COMP))
   {
     /* TWI Message Task Queue Full or the Tx transmit isn't complete */
     return FALSE;
@@ -105,6 +117,8 @@ bool TWI0ReadByte(u8 u8SlaveAddress_, u8* pu8RxBuffer_)
     TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Address     = u8SlaveAddress_;
     TWI_MessageBuffer[TWI_MessageBufferNextIndex].pu8RxBuffer   = pu8RxBuffer_;
     TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Attempts    = 0;
+    TWI_MessageBuffer[TWI_MessageBufferNextIndex].u32InternalAddress    = 0;
+    TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8InternalAddressSize = 0;
     
     /* Not used by Receive */
     TWI_MessageBuffer[TWI_MessageBufferNextIndex].Stop = NA; 
@@ -112,18 +126,11 @@ bool TWI0ReadByte(u8 u8SlaveAddress_, u8* pu8RxBuffer_)
     /* Update array pointers and size */
     TWI_MessageBufferNextIndex++;
     TWI_MessageQueueLength++;
-    if(TWI_MessageBufferNextIndex == TX_QUEUE_SIZE)
+    if(TWI_MessageBufferNextIndex == TWI_QUEUE_SIZE)
     {
       TWI_MessageBufferNextIndex = 0;
     }
     
-    /* If the system is initializing, we want to manually cycle the TWI task through one iteration
-      to send the message */
-    if(G_u32SystemFlags & _SYSTEM_INITIALIZING)
-    {
-      TWIManualMode();
-    }
-    
     return TRUE;
   }
 
@@ -146,7 +153,7 @@ Promises:
 */
 bool TWI0ReadData(u8 u8SlaveAddress_, u8* pu8RxBuffer_, u32 u32Size_)
 {
-  if(TWI_MessageQueueLength == TX_QUEUE_SIZE || (TWI0->u32Flags & _TWI_TRANS_NOT_COMP))
+  if(TWI_MessageQueueLength == TWI_QUEUE_SIZE || (TWI0->u32Flags & _TWI_TRANS_NOT_COMP))
   {
     /* TWI Message Task Queue Full or the Tx transmit isn't complete */
     return FALSE;
@@ -159,6 +166,8 @@ bool TWI0ReadData(u8 u8SlaveAddress_, u8* pu8RxBuffer_, u32 u32Size_)
     TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Address     = u8SlaveAddress_;
     TWI_MessageBuffer[TWI_MessageBufferNextIndex].pu8RxBuffer   = pu8RxBuffer_;
     TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Attempts    = 0;
+    TWI_MessageBuffer[TWI_MessageBufferNextIndex].u32InternalAddress    = 0;
+    TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8InternalAddressSize = 0;
     
     /* Not used by Receive */
     TWI_MessageBuffer[TWI_MessageBufferNextIndex].Stop = NA; 
@@ -166,18 +175,11 @@ bool TWI0ReadData(u8 u8SlaveAddress_, u8* pu8RxBuffer_, u32 u32Size_)
     /* Update array pointers and size */
     TWI_MessageBufferNextIndex++;
     TWI_MessageQueueLength++;
-    if(TWI_MessageBufferNextIndex == TX_QUEUE_SIZE)
+    if(TWI_MessageBufferNextIndex == TWI_QUEUE_SIZE)
     {
       TWI_MessageBufferNextIndex = 0;
     }
     
-    /* If the system is initializing, we want to manually cycle the TWI task through one iteration
-      to send the message */
-    if(G_u32SystemFlags & _SYSTEM_INITIALIZING)
-    {
-      TWIManualMode();
-    }
-    
     return TRUE;
   }
   
@@ -185,128 +187,151 @@ bool TWI0ReadData(u8 u8SlaveAddress_, u8* pu8RxBuffer_, u32 u32Size_)
 
 
 /*----------------------------------------------------------------------------------------------------------------------
-Function: TWI0WriteByte
+Function: TWI0WriteRead
 
 Description:
-Queues a single byte for transfer on TWI0 peripheral.  
+Queues a combined write-then-read TWI Message into TWI_MessageBuffer, will be processed after all msgs queued
+before it.  The tx bytes are sent as the TWI internal address so the read follows with a repeated start in the
+same bus transaction (e.g. a sensor register read).
 
 Requires:
   - Initialization of the task
+  - pu8TxData_ points to u8TxSize_ bytes (1 to TWI_MAX_INTERNAL_ADDRESS_BYTES), sent first byte first
+  - Requires pu8RxBuffer_ has the space to save u32RxSize_ bytes
 
 Promises:
-  - Creates a 1-byte message at TWI0->pTransmitBuffer that will be sent by the TWI application
-    when it is available.
-  - Returns the message token assigned to the message
+  - Queues the transaction; the tx bytes are copied so pu8TxData_ may be reused immediately
+  - Returns TRUE if the queue was successful; FALSE if the queue is full, a write is holding the bus, 
+    or u8TxSize_ is out of range
 */
-u32 TWI0WriteByte(u8 u8SlaveAddress_, u8 u8Byte_, TWIStopType Send_)
+bool TWI0WriteRead(u8 u8SlaveAddress_, u8* pu8TxData_, u8 u8TxSize_, u8* pu8RxBuffer_, u32 u32RxSize_)
 {
-  u32 u32Token;
-  u8 u8Data = u8Byte_;
+  u32 u32InternalAddress = 0;
   
-  if(TWI_MessageQueueLength == TX_QUEUE_SIZE)
+  if( (u8TxSize_ == 0) || (u8TxSize_ > TWI_MAX_INTERNAL_ADDRESS_BYTES) || (u32RxSize_ == 0) )
   {
-    /* TWI Message Task Queue Full */
-    return 0;
+    return FALSE;
   }
-  else
+  
+  if(TWI_MessageQueueLength == TWI_QUEUE_SIZE || (TWI0->u32Flags & _TWI_TRANS_NOT_COMP))
   {
-    /* Queue Message in message system */
-    u32Token = QueueMessage(&TWI0->pTransmitBuffer, 1, &u8Data);
-    if(u32Token)
-    {
-      /* Queue Relevant data for TWI register setup */
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].Direction     = WRITE;
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].u32Size       = 1;
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Address     = u8SlaveAddress_;
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].Stop          = Send_;
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Attempts    = 0;
-      
-      /* Not used by Transmit */
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].pu8RxBuffer = NULL;
-      
-      /* Update array pointers and size */
-      TWI_MessageBufferNextIndex++;
-      TWI_MessageQueueLength++;
-      if(TWI_MessageBufferNextIndex == TX_QUEUE_SIZE)
-      {
-        TWI_MessageBufferNextIndex = 0;
-      }
+    /* TWI Message Task Queue Full or the Tx transmit isn't complete */
+    return FALSE;
+  }
 
-      /* If the system is initializing, we want to manually cycle the TWI task through one iteration
-      to send the message */
-      if(G_u32SystemFlags & _SYSTEM_INITIALIZING)
-      {
-        TWIManualMode();
-      }
-    }
-    
-    return(u32Token);
+  /* The first byte to send is the most significant byte of IADR */
+  for(u8 i = 0; i < u8TxSize_; i++)
+  {
+    u32InternalAddress = (u32InternalAddress << 8) | pu8TxData_[i];
   }
   
-} /* end TWIWriteByte() */
+  /* Queue Relevant data for TWI register setup */
+  TWI_MessageBuffer[TWI_MessageBufferNextIndex].Direction     = READ;
+  TWI_MessageBuffer[TWI_MessageBufferNextIndex].u32Size       = u32RxSize_;
+  TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Address     = u8SlaveAddress_;
+  TWI_MessageBuffer[TWI_MessageBufferNextIndex].pu8RxBuffer   = pu8RxBuffer_;
+  TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Attempts    = 0;
+  TWI_MessageBuffer[TWI_MessageBufferNextIndex].u32InternalAddress    = u32InternalAddress;
+  TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8InternalAddressSize = u8TxSize_;
+  
+  /* Not used by Receive */
+  TWI_MessageBuffer[TWI_MessageBufferNextIndex].Stop = NA; 
+  
+  /* Update array pointers and size */
+  TWI_MessageBufferNextIndex++;
+  TWI_MessageQueueLength++;
+  if(TWI_MessageBufferNextIndex == TWI_QUEUE_SIZE)
+  {
+    TWI_MessageBufferNextIndex = 0;
+  }
+  
+  return TRUE;
+  
+} /* end TWI0WriteRead() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: TWI0WriteByte
+
+Description:
+Queues a single byte for transfer on TWI0 peripheral.  
+
+Requires:
+  - Initialization of the task
+
+Promises:
+  - Creates a 1-byte message in TWI_MessageBuffer that will be sent by the TWI application
+    when it is available.
+  - Returns the message token assigned to the message; 0 if the ring is full
+*/
+u32 TWI0WriteByte(u8 u8SlaveAddress_, u8 u8Byte_, TWIStopType Send_)
+{
+  return( TWI0WriteData(u8SlaveAddress_, 1, &u8Byte_, Send_) );
+  
+} /* end TWI0WriteByte() */
 
 
 /*----------------------------------------------------------------------------------------------------------------------
 Function: TWI0WriteData
 
 Description:
-Queues a data array for transfer on the  TWI0 peripheral.  
+Queues a data array for transfer on the  TWI0 peripheral.  The data is copied into the TWI descriptor ring,
+so no message arena space is used and the caller's buffer may be reused as soon as this function returns.
 
 Requires:
-  - if a transmission is in progress, the node in the buffer that is currently being sent will not be destroyed during this function.
-  - u32Size_ is the number of bytes in the data array
+  - u32Size_ is the number of bytes in the data array (1 to TWI_MAX_MESSAGE_SIZE)
   - u8Data_ points to the first byte of the data array
 
 Promises:
-  - adds the data message at TWI_Peripheral0->pTransmitBuffer buffer that will be sent by the TWI application
+  - adds the data message in TWI_MessageBuffer that will be sent by the TWI application
     when it is available.
-  - Returns the message token assigned to the message; 0 is returned if the message cannot be queued in which case
-    G_u32MessagingFlags can be checked for the reason
+  - Returns the message token assigned to the message; 0 is returned if the ring is full, u32Size_ is out of range
+    or the messaging task could not issue a token
 */
 u32 TWI0WriteData(u8 u8SlaveAddress_, u32 u32Size_, u8* u8Data_, TWIStopType Send_)
 {
-  u32 u32Token;
+  TWIMessageQueueType* psMessage = &TWI_MessageBuffer[TWI_MessageBufferNextIndex];
     
-  if(TWI_MessageQueueLength == TX_QUEUE_SIZE)
+  if( (u32Size_ == 0) || (u32Size_ > TWI_MAX_MESSAGE_SIZE) || (TWI_MessageQueueLength == TWI_QUEUE_SIZE) )
   {
-    /* Queue Message in message system */
     return 0;
   }
-  else
-  {
-    /* Queue Message in message system */
-    u32Token = QueueMessage(&TWI0->pTransmitBuffer, u32Size_, u8Data_);
-    if(u32Token)
-    {
-      /* Queue Relevant data for TWI register setup */
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].Direction     = WRITE;
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].u32Size       = 1;
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Address     = u8SlaveAddress_;
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].Stop          = Send_;
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Attempts    = 0;
-      
-      /* Not used by Transmit */
-      TWI_MessageBuffer[TWI_MessageBufferNextIndex].pu8RxBuffer = NULL;
-      
-      /* Update array pointers and size */
-      TWI_MessageBufferNextIndex++;
-      TWI_MessageQueueLength++;
-      if(TWI_MessageBufferNextIndex == TX_QUEUE_SIZE)
-      {
-        TWI_MessageBufferNextIndex = 0;
-      }
 
-      /* If the system is initializing, manually cycle the TWI task through one iteration to send the message */
-      if(G_u32SystemFlags & _SYSTEM_INITIALIZING)
-      {
-        TWIManualMode();
-      }
-    }
+  /* Queue Relevant data for TWI register setup */
+  psMessage->Direction     = WRITE;
+  psMessage->u32Size       = u32Size_;
+  psMessage->u8Address     = u8SlaveAddress_;
+  psMessage->Stop          = Send_;
+  psMessage->u8Attempts    = 0;
+  for(u32 i = 0; i < u32Size_; i++)
+  {
+    psMessage->au8Data[i] = u8Data_[i];
+  }
+  
+  /* Not used by Transmit */
+  psMessage->pu8RxBuffer = NULL;
+  psMessage->u32InternalAddress    = 0;
+  psMessage->u8InternalAddressSize = 0;
   
-    return(u32Token);
+  /* Token status is kept by the messaging task so clients can use QueryMessageStatus().  The message is not
+  queued if no token can be issued. */
+  psMessage->u32Token = IssueMessageToken(MSG_NO_QUEUE_ID);
+  if(psMessage->u32Token == 0)
+  {
+    return 0;
   }
   
-} /* end TWIWriteData() */
+  /* Update array pointers and size */
+  TWI_MessageBufferNextIndex++;
+  TWI_MessageQueueLength++;
+  if(TWI_MessageBufferNextIndex == TWI_QUEUE_SIZE)
+  {
+    TWI_MessageBufferNextIndex = 0;
+  }
+
+  return(psMessage->u32Token);
+  
+} /* end TWI0WriteData() */
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -324,7 +349,7 @@ Requires:
 
 Promises:
   - TWI peripheral objects are ready 
-  - TWI application set to Idle
+  - TWI peripheral is reset and the TWI application is set to TWISM_Reset
 */
 void TWIInitialize(void)
 {
@@ -340,31 +365,19 @@ void TWIInitialize(void)
   
   /* Initialize the TWI peripheral structures */
   TWI_Peripheral0.pBaseAddress    = AT91C_BASE_TWI0;
-  TWI_Peripheral0.pTransmitBuffer = NULL;
   TWI_Peripheral0.pu8RxBuffer     = NULL;
   TWI_Peripheral0.u32Flags        = 0;
 
-  /* Software reset of peripheral */
+  /* Software reset of peripheral: TWISM_Reset configures it once the reset time has passed.  Msgs 
+  queued before then wait in the ring. */
   TWI0->pBaseAddress->TWI_CR   |= _TWI_CR_SWRST_BIT;
   TWI_u32Timer = G_u32SystemTime1ms;
-  while( !IsTimeUp(&TWI_u32Timer, 5) );
-  
-  /* Configure Peripheral */
-  TWI0->pBaseAddress->TWI_CWGR = TWI0_CWGR_INIT;
-  TWI0->pBaseAddress->TWI_CR   = TWI0_CR_INIT;
-  TWI0->pBaseAddress->TWI_MMR  = TWI0_MMR_INIT;
-  TWI0->pBaseAddress->TWI_IER  = TWI0_IER_INIT;
-  TWI0->pBaseAddress->TWI_IDR  = TWI0_IDR_INIT;
-  
-  /* Enable TWI interrupts */
-  NVIC_ClearPendingIRQ( (IRQn_Type)u32TargetPerpipheralNumber );
-  NVIC_EnableIRQ( (IRQn_Type)u32TargetPerpipheralNumber );
 
   TWI_u32CurrentBytesRemaining   = 0;
   TWI_pu8CurrentTxData           = NULL;
 
   /* Set application pointer */
-  TWI_StateMachine = TWISM_Idle;
+  TWI_StateMachine = TWISM_Reset;
   
 } /* end TWIInitialize() */
 
@@ -396,95 +409,66 @@ void TWIRunActiveState(void)
 /*--------------------------------------------------------------------------------------------------------------------*/
 
 /*----------------------------------------------------------------------------------------------------------------------
-Function: TWIFillTxBuffer
+Function: TWI0FillTxBuffer
 
 Description:
-Fills the TWI peripheral buffer with bytes from the current messsage that is sending.  
-This function can be called from the TWI ISR!
-Note: if the implemented processor does not have a FIFO, this function can still be used but will only ever
-add one byte to the transmitter.
+Loads the last byte of the current write message once the PDC part has gone out, or finishes a NO_STOP
+message once that byte has moved to the shifter.
+This function is called from the TWI ISR on TXRDY!
 
 Requires:
-  - The TxBuffer is empty
-  - TWI_pu8CurrentTxData points to the next byte in the message to be sent
-  - TWI_u32CurrentBytesRemaining has an accurate count of the bytes remaining in the message data to be sent
-  - Transmit interrupts are off
+  - TXRDY is set and the PDC transmit channel is disabled
+  - TWI_pu8CurrentTxData points to the last byte in the message to be sent
+  - TWI_u32CurrentBytesRemaining is 1 if the last byte has not been loaded yet, otherwise 0
 
 Promises:
-  - Data from *TWI_pu8CurrentTxData is added to the TWI peripheral Tx FIFO until the FIFO is full or there
-    is no more data to send.
+  - STOP messages: STOP is requested, the last byte is loaded and TXCOMP is enabled to end the message
+  - NO_STOP messages: the last byte is loaded; the next TXRDY clears _TWI_TRANSMITTING
 */
 static void TWI0FillTxBuffer(void)
 {
-  u8 u8ByteCount = TWI_TX_FIFO_SIZE;
-  
-  /* Use the active global variables to fill up the transmit FIFO */
-  while( (u8ByteCount != 0) && (TWI_u32CurrentBytesRemaining != 0) )
+  if(TWI_u32CurrentBytesRemaining != 0)
   {
+    /* STOP must be requested before the last character is written */
+    if(TWI_MessageBuffer[TWI_MessageBufferCurIndex].Stop == STOP)
+    {
+      TWI0->pBaseAddress->TWI_CR = _TWI_CR_STOP_BIT;
+    }
+    
     TWI0->pBaseAddress->TWI_THR = *TWI_pu8CurrentTxData;
     TWI_pu8CurrentTxData++;
     TWI_u32CurrentBytesRemaining--;
-    u8ByteCount--;
-  }
-  
-  /* If there are no remaining bytes to load to the TX FIFO, disable the TWI transmit 
-  FIFO empty interrupt */
-  if(TWI_u32CurrentBytesRemaining == 0)
-  {
-    TWI0->pBaseAddress->TWI_IDR = AT91C_TWI_TXRDY_MASTER;
+    
     if(TWI_MessageBuffer[TWI_MessageBufferCurIndex].Stop == STOP)
     {
-      TWI0->pBaseAddress->TWI_CR |= _TWI_CR_STOP_BIT;
+      TWI0->pBaseAddress->TWI_IDR = _TWI_SR_TXRDY;
+      TWI0->pBaseAddress->TWI_IER = _TWI_SR_TXCOMP;
     }
   }
-  /* Otherwise make sure transmit interrupts are enabled */
   else
   {
-    TWI0->pBaseAddress->TWI_IER = AT91C_TWI_TXRDY_MASTER;
+    /* The lines are held for the next message */
+    TWI0->pBaseAddress->TWI_IDR = _TWI_SR_TXRDY;
+    TWI0->u32Flags &= ~_TWI_TRANSMITTING;
   }
   
-} /* end TWIFillTxBuffer() */
-
-
-/*----------------------------------------------------------------------------------------------------------------------
-Function: TWIManualMode
-
-Description:
-Runs a transmit cycle of the TWI application to clock out a message.  This function is used only during
-initialization.
-
-Requires:
-  - TWI application has been initialized.
-
-Promises:
-  - All bytes currently in the TWI Rx FIFO are read out to the application receive circular buffer.
-*/
-static void TWIManualMode(void)
-{
-  TWI_u32Flags |=_TWI_INIT_MODE;
-  TWI_u32Timer  = G_u32SystemTime1ms;
-  
-  while(TWI_u32Flags &_TWI_INIT_MODE)
-  {
-    TWI_StateMachine();
-    IsTimeUp(&TWI_u32Timer, 1);
-  }
-      
-} /* end TWIManualMode() */
+} /* end TWI0FillTxBuffer() */
 
 
 /*----------------------------------------------------------------------------------------------------------------------
 Function: TWI0_IrqHandler
 
 Description:
-Handles the TWI0 Peripheral interrupts
+Handles the TWI0 Peripheral interrupts.  A message costs the same few interrupts regardless of its length:
+ENDTX/ENDRX when the PDC part is done, TXRDY/RXRDY for the bytes around the STOP, and TXCOMP.
 
 Requires:
   - TWI application has been initialized.
 
 Promises:
-  - More data has been queued or error flag raised
-  - Or recieved byte is placed in desied buffer
+  - PDC part done: the PDC channel is disabled and the CPU takes the remaining bytes
+  - Received bytes are placed in the msg receive buffer
+  - _TWI_TRANSMITTING/_TWI_RECEIVING are cleared when the msg is finished, or an error flag is raised
 */
 void TWI0_IrqHandler(void)
 {
@@ -497,88 +481,174 @@ void TWI0_IrqHandler(void)
   /* NACK Received */
   if(u32InterruptStatus & _TWI_SR_NACK )
   {
-    /* Error has occurred, reset the msg */
+    /* Error has occurred: stop the transfer so TWISM_Error can retry or abandon the msg */
+    TWI0->pBaseAddress->TWI_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+    TWI0->pBaseAddress->TWI_IDR = TWI_TRANSFER_INTERRUPTS;
     TWI_u32Flags |= _TWI_ERROR_NACK;
-    
   }
-  /* Receiving Bytes */
-  else if(u32InterruptStatus & _TWI_SR_RXRDY && ( TWI0->u32Flags & _TWI_RECEIVING ) )
+  /* PDC has sent all but the last byte */
+  else if( (u32InterruptStatus & _TWI_SR_ENDTX) && (TWI0->u32Flags & _TWI_TRANSMITTING) )
   {
+    TWI0->pBaseAddress->TWI_PTCR = AT91C_PDC_TXTDIS;
+    TWI0->pBaseAddress->TWI_IDR = _TWI_SR_ENDTX;
+    TWI0->pBaseAddress->TWI_IER = _TWI_SR_TXRDY;
+  }
+  /* PDC has received all but the last two bytes */
+  else if( (u32InterruptStatus & _TWI_SR_ENDRX) && (TWI0->u32Flags & _TWI_RECEIVING) )
+  {
+    TWI0->pBaseAddress->TWI_PTCR = AT91C_PDC_RXTDIS;
+    TWI0->pBaseAddress->TWI_IDR = _TWI_SR_ENDRX;
+    TWI0->pBaseAddress->TWI_IER = _TWI_SR_RXRDY;
+  }
+  /* Receiving the last bytes */
+  else if( (u32InterruptStatus & _TWI_SR_RXRDY) && (TWI0->u32Flags & _TWI_RECEIVING) )
+  {
+    /* STOP is requested before the second last byte is read */
+    if(TWI_u32CurrentBytesRemaining == TWI_RX_CPU_BYTES)
+    {
+      TWI0->pBaseAddress->TWI_CR = _TWI_CR_STOP_BIT;
+    }
+    
     *TWI0->pu8RxBuffer = TWI0->pBaseAddress->TWI_RHR;
     TWI0->pu8RxBuffer++;
     TWI_u32CurrentBytesRemaining--;
     
-    if(TWI_u32CurrentBytesRemaining == 1)
+    if(TWI_u32CurrentBytesRemaining == 0)
     {
-      TWI0->pBaseAddress->TWI_CR |= _TWI_CR_STOP_BIT;
+      TWI0->pBaseAddress->TWI_IDR = _TWI_SR_RXRDY;
+      TWI0->pBaseAddress->TWI_IER = _TWI_SR_TXCOMP;
     }
   }
-  /* Transmitting Bytes */
-  else if(u32InterruptStatus & _TWI_SR_TXRDY && ( TWI0->u32Flags & _TWI_TRANSMITTING ) )
+  /* Transmitting the last byte */
+  else if( (u32InterruptStatus & _TWI_SR_TXRDY) && (TWI0->u32Flags & _TWI_TRANSMITTING) )
   {
-    /* There is more data queued and peripheral ready */
     TWI0FillTxBuffer();
   }
+  /* STOP has been sent */
+  else if(u32InterruptStatus & _TWI_SR_TXCOMP)
+  {
+    TWI0->pBaseAddress->TWI_IDR = _TWI_SR_TXCOMP;
+    TWI0->u32Flags &= ~(_TWI_TRANSMITTING | _TWI_TRANS_NOT_COMP | _TWI_RECEIVING);
+  }
   else
   {
     TWI_u32Flags |= _TWI_ERROR_INTERRUPT;
   }
-}
+  
+} /* end TWI0_IrqHandler() */
 
 /***********************************************************************************************************************
 State Machine Function Definitions
 ***********************************************************************************************************************/
 
 /*-------------------------------------------------------------------------------------------------------------------*/
-/* Wait for a transmit message to be queued.  Received data is handled in interrupts. */
+/* Wait out the software reset started by TWIInitialize, then configure the peripheral and enable its interrupts. */
+void TWISM_Reset(void)
+{
+  if( IsTimeUp(&TWI_u32Timer, TWI_RESET_TIME_MS) )
+  {
+    TWI0->pBaseAddress->TWI_CWGR = TWI0_CWGR_INIT;
+    TWI0->pBaseAddress->TWI_CR   = TWI0_CR_INIT;
+    TWI0->pBaseAddress->TWI_MMR  = TWI0_MMR_INIT;
+    TWI0->pBaseAddress->TWI_IER  = TWI0_IER_INIT;
+    TWI0->pBaseAddress->TWI_IDR  = TWI0_IDR_INIT;
+    
+    /* Enable TWI interrupts */
+    NVIC_ClearPendingIRQ( (IRQn_Type)AT91C_ID_TWI0 );
+    NVIC_EnableIRQ( (IRQn_Type)AT91C_ID_TWI0 );
+    
+    TWI_StateMachine = TWISM_Idle;
+  }
+  
+} /* end TWISM_Reset() */
+
+
+/*-------------------------------------------------------------------------------------------------------------------*/
+/* Wait for a transmit message to be queued.  Received data is handled in interrupts.  The queue length is checked
+rather than the ring indexes, which are also equal when the ring is full. */
 void TWISM_Idle(void)
 {
-  if(TWI_MessageBufferNextIndex != TWI_MessageBufferCurIndex )
+  if(TWI_MessageQueueLength != 0)
   {
-    TWI0->pBaseAddress->TWI_MMR = TWI0_MMR_INIT;
     TWI0->pBaseAddress->TWI_CR = TWI0_CR_INIT;
     
     if(TWI_MessageBuffer[TWI_MessageBufferCurIndex].Direction == WRITE)
     {
       /* insert new address */
-      TWI0->pBaseAddress->TWI_MMR |= ((TWI_MessageBuffer[TWI_MessageBufferCurIndex].u8Address << _TWI_MMR_ADDRESS_SHIFT));
+      TWI0->pBaseAddress->TWI_MMR = TWI0_MMR_INIT | 
+                                    (TWI_MessageBuffer[TWI_MessageBufferCurIndex].u8Address << _TWI_MMR_ADDRESS_SHIFT);
       
       /* Set up to transmit the message */
-      TWI_u32CurrentBytesRemaining = TWI0->pTransmitBuffer->u32Size;
-      TWI_pu8CurrentTxData = TWI0->pTransmitBuffer->pu8Message;
-      TWI0FillTxBuffer();    
+      TWI_u32CurrentBytesRemaining = TWI_MessageBuffer[TWI_MessageBufferCurIndex].u32Size;
+      TWI_pu8CurrentTxData = &TWI_MessageBuffer[TWI_MessageBufferCurIndex].au8Data[0];
       
       /* Update the message's status */
-      UpdateMessageStatus(TWI0->pTransmitBuffer->u32Token, SENDING);
+      UpdateMessageStatus(TWI_MessageBuffer[TWI_MessageBufferCurIndex].u32Token, SENDING);
+      TWI0->u32Flags |= (_TWI_TRANSMITTING | _TWI_TRANS_NOT_COMP);
+      
+      /* The PDC sends all but the last byte (writing THR starts the transfer); the ISR loads the last one */
+      if(TWI_u32CurrentBytesRemaining > 1)
+      {
+        TWI0->pBaseAddress->TWI_TPR = (u32)TWI_pu8CurrentTxData;
+        TWI0->pBaseAddress->TWI_TCR = TWI_u32CurrentBytesRemaining - 1;
+        TWI_pu8CurrentTxData += TWI_u32CurrentBytesRemaining - 1;
+        TWI_u32CurrentBytesRemaining = 1;
+        
+        TWI0->pBaseAddress->TWI_IER = _TWI_SR_ENDTX;
+        TWI0->pBaseAddress->TWI_PTCR = AT91C_PDC_TXTEN;
+      }
+      else
+      {
+        TWI0->pBaseAddress->TWI_IER = _TWI_SR_TXRDY;
+      }
   
       /* Proceed to next state to let the current message send */
-      TWI0->u32Flags |= (_TWI_TRANSMITTING | _TWI_TRANS_NOT_COMP);
       TWI_StateMachine = TWISM_Transmitting;
     }
     else if(TWI_MessageBuffer[TWI_MessageBufferCurIndex].Direction == READ)
     {
-      /* insert new address and set Read bit */
-      TWI0->pBaseAddress->TWI_MMR |= (((TWI_MessageBuffer[TWI_MessageBufferCurIndex].u8Address) << _TWI_MMR_ADDRESS_SHIFT) & _TWI_MMR_MREAD_BIT);
+      /* insert new address and set Read bit; a nonzero internal address size makes the peripheral write the 
+      internal address bytes and issue the repeated start itself */
+      TWI0->pBaseAddress->TWI_MMR = TWI0_MMR_INIT | _TWI_MMR_MREAD_BIT |
+                                    (TWI_MessageBuffer[TWI_MessageBufferCurIndex].u8Address << _TWI_MMR_ADDRESS_SHIFT) |
+                                    (TWI_MessageBuffer[TWI_MessageBufferCurIndex].u8InternalAddressSize << _TWI_MMR_IADRSZ_SHIFT);
+      TWI0->pBaseAddress->TWI_IADR = TWI_MessageBuffer[TWI_MessageBufferCurIndex].u32InternalAddress;
       
       /* Grab number of desired bytes and the pointer to store the buffer */
       TWI_u32CurrentBytesRemaining = TWI_MessageBuffer[TWI_MessageBufferCurIndex].u32Size;
       TWI0->pu8RxBuffer = TWI_MessageBuffer[TWI_MessageBufferCurIndex].pu8RxBuffer;
+      TWI0->u32Flags |= _TWI_RECEIVING;
       
-      if(TWI_u32CurrentBytesRemaining == 1)
+      /* The PDC receives all but the last two bytes; the ISR reads those so STOP is set in time */
+      if(TWI_u32CurrentBytesRemaining > TWI_RX_CPU_BYTES)
       {
-        /* Start and Stop need to be set at same time */
-        TWI0->pBaseAddress->TWI_CR |= (_TWI_CR_START_BIT | _TWI_CR_STOP_BIT);
+        TWI0->pBaseAddress->TWI_RPR = (u32)TWI0->pu8RxBuffer;
+        TWI0->pBaseAddress->TWI_RCR = TWI_u32CurrentBytesRemaining - TWI_RX_CPU_BYTES;
+        TWI0->pu8RxBuffer += TWI_u32CurrentBytesRemaining - TWI_RX_CPU_BYTES;
+        TWI_u32CurrentBytesRemaining = TWI_RX_CPU_BYTES;
+        
+        TWI0->pBaseAddress->TWI_IER = _TWI_SR_ENDRX;
+        TWI0->pBaseAddress->TWI_PTCR = AT91C_PDC_RXTEN;
+        TWI0->pBaseAddress->TWI_CR = _TWI_CR_START_BIT;
       }
       else
       {
-        /* Just start bit, stop will be handled by interrupt */
-        TWI0->pBaseAddress->TWI_CR |= _TWI_CR_START_BIT;
+        if(TWI_u32CurrentBytesRemaining == 1)
+        {
+          /* Start and Stop need to be set at same time */
+          TWI0->pBaseAddress->TWI_CR = (_TWI_CR_START_BIT | _TWI_CR_STOP_BIT);
+        }
+        else
+        {
+          /* Just start bit, stop will be handled by interrupt */
+          TWI0->pBaseAddress->TWI_CR = _TWI_CR_START_BIT;
+        }
+        
+        TWI0->pBaseAddress->TWI_IER = _TWI_SR_RXRDY;
       }
       
-      /* Proceed to receiving state and set flag */
-      TWI0->u32Flags |= _TWI_RECEIVING;
+      /* Proceed to receiving state */
       TWI_StateMachine = TWISM_Receiving;
-      
     }  
     
     /* Check for errors */
@@ -592,47 +662,22 @@ void TWISM_Idle(void)
      
 
 /*-------------------------------------------------------------------------------------------------------------------*/
-/* Transmit in progress until current bytes have reached 0.  On exit, the transmit message must be dequeued.
+/* Transmit in progress until the ISR clears _TWI_TRANSMITTING (TXCOMP for STOP msgs, last TXRDY for NO_STOP).
+On exit, the transmit message must be dequeued.
 */
 void TWISM_Transmitting(void)
 {
-  /* Check if a stop condition has been requested */
-  if(TWI_MessageBuffer[TWI_MessageBufferCurIndex].Stop == STOP)
-  {
-    /* Check if all of the message bytes have completely finished sending and transmission complete */
-    if( (TWI_u32CurrentBytesRemaining == 0) && 
-        (TWI0->pBaseAddress->TWI_SR & _TWI_SR_TXRDY) &&
-        (TWI0->pBaseAddress->TWI_SR & _TWI_SR_TXCOMP) )
-    {
-      /*  Clear flags */
-      TWI0->u32Flags &= ~(_TWI_TRANSMITTING | _TWI_TRANS_NOT_COMP);
-    }
-  }
-  else
-  {
-    /* Check if all of the message bytes have completely finished sending */
-    if( (TWI_u32CurrentBytesRemaining == 0) && 
-        (TWI0->pBaseAddress->TWI_SR & _TWI_SR_TXRDY) )
-    { 
-      /* Clear flag */
-      TWI0->u32Flags &= ~_TWI_TRANSMITTING;
-    }
-  }
-  
   if( !(TWI0->u32Flags & _TWI_TRANSMITTING) )
   {
-    /* Update the status queue and then dequeue the message */
-    UpdateMessageStatus(TWI0->pTransmitBuffer->u32Token, COMPLETE);
-    DeQueueMessage(&TWI0->pTransmitBuffer);
+    /* Update the status queue; the ring entry is released below */
+    UpdateMessageStatus(TWI_MessageBuffer[TWI_MessageBufferCurIndex].u32Token, COMPLETE);
     
-    /* Make sure _TWI_INIT_MODE flag is clear in case this was a manual cycle */
-    TWI_u32Flags &= ~_TWI_INIT_MODE;
     TWI_StateMachine = TWISM_Idle;
     
     /* Update queue pointers */
     TWI_MessageBufferCurIndex++;
     TWI_MessageQueueLength--;
-    if(TWI_MessageBufferCurIndex == TX_QUEUE_SIZE)
+    if(TWI_MessageBufferCurIndex == TWI_QUEUE_SIZE)
     {
       TWI_MessageBufferCurIndex = 0;
     }
@@ -648,25 +693,18 @@ void TWISM_Transmitting(void)
 } /* end TWISM_Transmitting() */
 
 /*-------------------------------------------------------------------------------------------------------------------*/
-/* Receive in progress until current bytes have reached 0.
+/* Receive in progress until the ISR clears _TWI_RECEIVING on TXCOMP.
 */
 void TWISM_Receiving(void)
 {
-  if( (TWI_u32CurrentBytesRemaining == 0) &&
-      (TWI0->pBaseAddress->TWI_SR & _TWI_SR_RXRDY) &&
-      (TWI0->pBaseAddress->TWI_SR & _TWI_SR_TXCOMP) )
+  if( !(TWI0->u32Flags & _TWI_RECEIVING) )
   {
-    /* Clear flag */
-    TWI0->u32Flags &= ~_TWI_RECEIVING;
-    
-    /* Make sure _TWI_INIT_MODE flag is clear in case this was a manual cycle */
-    TWI_u32Flags &= ~_TWI_INIT_MODE;
     TWI_StateMachine = TWISM_Idle;
     
     /* Update queue pointers */
     TWI_MessageBufferCurIndex++;
     TWI_MessageQueueLength--;
-    if(TWI_MessageBufferCurIndex == TX_QUEUE_SIZE)
+    if(TWI_MessageBufferCurIndex == TWI_QUEUE_SIZE)
     {
       TWI_MessageBufferCurIndex = 0;
     }
@@ -689,22 +727,21 @@ void TWISM_Error(void)
   if( TWI_u32Flags & _TWI_ERROR_NACK )
   {
     /* Msg attempted too many times */
-    if( ++TWI_MessageBuffer[TWI_MessageBufferNextIndex].u8Attempts == MAX_ATTEMPTS )
+    if( ++TWI_MessageBuffer[TWI_MessageBufferCurIndex].u8Attempts == MAX_ATTEMPTS )
     {
+      if( TWI0->u32Flags & _TWI_TRANSMITTING )
+      {
+        /* Update Status */ 
+        UpdateMessageStatus(TWI_MessageBuffer[TWI_MessageBufferCurIndex].u32Token, ABANDONED);
+      }
+
       /* Remove the message from buffer queue */
       TWI_MessageBufferCurIndex++;
       TWI_MessageQueueLength--;
-      if(TWI_MessageBufferCurIndex == TX_QUEUE_SIZE)
+      if(TWI_MessageBufferCurIndex == TWI_QUEUE_SIZE)
       {
         TWI_MessageBufferCurIndex = 0;
       }
-      
-      if( TWI0->u32Flags & _TWI_TRANSMITTING )
-      {
-        /* Dequeue Msg and Update Status */ 
-        UpdateMessageStatus(TWI0->pTransmitBuffer->u32Token, ABANDONED);
-        DeQueueMessage(&TWI0->pTransmitBuffer);
-      }
     }
 
     /* Reset the msg flags */
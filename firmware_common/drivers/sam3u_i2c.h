@@ -13,13 +13,16 @@ Header file for sam3u_TWI.c
 /**********************************************************************************************************************
 Type Definitions
 **********************************************************************************************************************/
+/* Descriptor ring sizing: the TWI keeps its own messages so I2C bursts do not use the shared message arena */
+#define TWI_QUEUE_SIZE                 (u8)32            /* Number of entries in TWI_MessageBuffer */
+#define TWI_MAX_MESSAGE_SIZE           (u8)44            /* Bytes of write data held inline in each entry */
+
 typedef enum {STOP, NO_STOP, NA} TWIStopType;
 typedef enum {WRITE, READ} TWIMessageType;
 
 typedef struct 
 {
   AT91PS_TWI pBaseAddress;            /* Base address of the associated peripheral */
-  MessageType* pTransmitBuffer;       /* Pointer to the transmit message linked list */
   u8* pu8RxBuffer;                    /* Pointer to receive buffer in user application */
   u32 u32Flags;                       /* Flags for peripheral */
 } TWIPeripheralType;
@@ -33,9 +36,13 @@ typedef struct
   
   /* Only Applicable to Write Operations */
   TWIStopType Stop;                   
+  u32 u32Token;                       /* Message token for status queries */
+  u8 au8Data[TWI_MAX_MESSAGE_SIZE];   /* Copy of the data to write */
   
   /* Only Applicable to Read Operations */
   u8* pu8RxBuffer;                    /* Pointer to receive buffer in user application */
+  u32 u32InternalAddress;             /* Register bytes written before the repeated start (TWI0WriteRead) */
+  u8 u8InternalAddressSize;           /* Number of bytes in u32InternalAddress; 0 for a plain read */
 }TWIMessageQueueType;
 
 /* TWIx_u32Flags definitions in TWIPeripheralType*/
@@ -49,8 +56,6 @@ typedef struct
 Constants / Definitions
 **********************************************************************************************************************/
 /* TWI_u32Flags (TWI application flags) */
-#define _TWI_INIT_MODE                 (u32)0x00000001   /* Set to push a transmit cycle during initialization mode */
-
 #define _TWI_ERROR_NACK                (u32)0x01000000   /* Set if a NACK is received */
 #define _TWI_ERROR_INTERRUPT           (u32)0x02000000   /* Set if an unexpected interrupt occurs */
 
@@ -64,6 +69,7 @@ Constants / Definitions
 #define TWI_RX_FIFO_SIZE               (u8)1             /* Size of the peripheral's receive FIFO in bytes */
 
 #define TWI_INIT_MSG_TIMEOUT           (u32)1000           /* Time in ms for init message to send */
+#define TWI_RESET_TIME_MS              (u32)5              /* Time in ms allowed for the software reset before configuring */
 
 #define _TWI_CR_START_BIT              (u32)(1 << 0)       /* Start Condition Control Bit */
 #define _TWI_CR_STOP_BIT               (u32)(1 << 1)       /* Stop Condition Control Bit */
@@ -74,12 +80,20 @@ Constants / Definitions
 #define _TWI_MMR_MREAD_MASK            (u32)0xFFFFEFFF     /* And with MMR to set Write */
 #define _TWI_MMR_DADR_MASK             (u32)0xFF80FFFF     /* And with MMR to Clear DADR (address) */
 #define _TWI_MMR_ADDRESS_SHIFT         (u8)0x10            /* Used with << to shift address to correct position in MMR */
+#define _TWI_MMR_IADRSZ_SHIFT          (u8)0x08            /* Used with << to shift internal address size to IADRSZ in MMR */
+
+#define TWI_MAX_INTERNAL_ADDRESS_BYTES (u8)3               /* Most bytes TWI0WriteRead() can send before the repeated start */
 
 #define _TWI_SR_TXCOMP                 (u32)(1<<0)         /* Transmission Complete used for both TX/RX */
 #define _TWI_SR_RXRDY                  (u32)(1<<1)         /* Receive Holding register ready Bit */
 #define _TWI_SR_TXRDY                  (u32)(1<<2)         /* Transmit Holding register ready Bit */
 #define _TWI_SR_OVRE                   (u32)(1<<6)         /* Rx Holding Buffer Overflow Bit */
 #define _TWI_SR_NACK                   (u32)(1<<8)         /* NACK Received */
+#define _TWI_SR_ENDRX                  (u32)(1<<12)        /* PDC receive counter reached 0 */
+#define _TWI_SR_ENDTX                  (u32)(1<<13)        /* PDC transmit counter reached 0 */
+
+#define TWI_TRANSFER_INTERRUPTS        (u32)(_TWI_SR_TXCOMP | _TWI_SR_RXRDY | _TWI_SR_TXRDY | _TWI_SR_ENDRX | _TWI_SR_ENDTX)
+#define TWI_RX_CPU_BYTES               (u32)2              /* Bytes at the end of a read taken from RHR so STOP can be timed */
 
 
 /**********************************************************************************************************************
@@ -91,6 +105,7 @@ Constants / Definitions
 /*--------------------------------------------------------------------------------------------------------------------*/
 bool TWI0ReadByte(u8 u8SlaveAddress_, u8* pu8RxBuffer_);
 bool TWI0ReadData(u8 u8SlaveAddress_, u8* pu8RxBuffer_, u32 u32Size_);
+bool TWI0WriteRead(u8 u8SlaveAddress_, u8* pu8TxData_, u8 u8TxSize_, u8* pu8RxBuffer_, u32 u32RxSize_);
 u32 TWI0WriteByte(u8 u8SlaveAddress_, u8 u8Byte_, TWIStopType Send_);
 u32 TWI0WriteData(u8 u8SlaveAddress_, u32 u32Size_, u8* u8Data_, TWIStopType Send_);
 
@@ -104,13 +119,13 @@ void TWIRunActiveState(void);
 /* Private functions */
 /*--------------------------------------------------------------------------------------------------------------------*/
 static void TWI0FillTxBuffer(void);
-static void TWIManualMode(void);
 void TWI0_IRQHandler(void);
 void TWI1_IRQHandler(void);
 
 /***********************************************************************************************************************
 State Machine Declarations
 ***********************************************************************************************************************/
+void TWISM_Reset(void);
 void TWISM_Idle(void);
 void TWISM_Transmitting(void);
 void TWISM_Receiving(void);
@@ -15,8 +15,9 @@ can be used (the bytes would have to be pre-flipped for transmit and post-flippe
 
 API:
 SspPeripheralType* SspRequest(SspConfigurationType* psSspConfig_)  BLADE_SSP
-Request a SSP peripheral for your task.  No other tasks in the system will be able to access 
-the specific peripheral you request.
+Request a SSP device for your task.  A Slave gets the peripheral to itself.  Masters may share a peripheral: each
+gets its own device object (queue, receive state, CS and US_MR/US_BRGR settings) and the driver runs their transfers
+one after the other, reloading the settings only when the device changes.  Request once and keep the device.
 e.g. MyTaskSsp = SspRequest(&MyTaskSspConfig);
 
 void SspRelease(SspPeripheralType* psSspPeripheral_)
@@ -34,6 +35,11 @@ e.g.
 u8 au8SData[] = {1, 2, 3, 4, 5, 6};
 u32CurrentMessageToken = SspWriteData(&MyTaskSsp, sizeof(au8SData), au8Sting);
 
+u32 SspTxQueueCount(SspPeripheralType* psSspPeripheral_)
+Returns the number of messages still in the device's transmit queue.  A client that sends from its own buffer with
+SspWriteDataReference() can reuse the buffer once its message has left the queue, even if the status was lost.
+e.g. if(SspTxQueueCount(MyTaskSsp) == 0) ...
+
 Master mode only:
 u32 SspReadByte(SspPeripheralType* psSspPeripheral_)
 Creates a dummy byte message of 1 byte to transmit and subsequently receive a byte. Returns the message token that can be monitored
@@ -45,6 +51,11 @@ Creates a dummy byte array to transmit and subsequently receive u32Size_ bytes.
 to see when the message has been sent, and thus when the received data should be in the pre-configured receive buffer.
 e.g. u32CurrentMessageToken = SspReadData(&MyTaskSsp, 10);
 
+bool SspTransfer(SspPeripheralType* psSspPeripheral_, u8* pu8TxData_, u8* pu8RxData_, u16 u16Size_)
+Full duplex transfer: sends u16Size_ bytes from pu8TxData_ while receiving u16Size_ bytes to pu8RxData_.  Pass NULL
+for pu8TxData_ to receive only; dummy bytes are then sent from a small block filled once at initialization.  Monitor with SspQueryReceiveStatus().
+e.g. if( SspTransfer(MyTaskSsp, au8Command, au8Response, sizeof(au8Command)) ) ...
+
 
 INITIALIZATION (should take place in application's initialization function):
 1. Create a variable of SspConfigurationType in your application and initialize it to the desired SSP peripheral,
@@ -54,8 +65,9 @@ and the size & address of the receive buffer in the application.
 SspPeripheralType object created that will be used by your application.
 
 3. If the application no longer needs the SSP resource, call SspRelease().  
-Note: if multiple slaves share an SSP resource, SspRequest() and SspRelease() must be used frequently to
-allow traffic to both devices. 
+Note: multiple slave devices on one SSP resource each call SspRequest() once; there is no need to release
+the resource between transactions.  A SPI_MASTER_MANUAL_CS device holds the bus from SspAssertCS() until
+SspDeAssertCS() so other devices never see their transfers land inside its CS window.
 
 MASTER MODE DATA TRANSFER:
 Transmitted data is queued using one of two functions, SspWriteByte() and SspWriteData() which both return a message
@@ -72,8 +84,9 @@ service routine that may add additional characters at any time.
 
 SSP traffic is always full duplex, but protocols are typically half duplex.  To receive
 data requested from an SSP slave, call SspReadByte() for a single byte or SspReadData() for multiple
-bytes.  These functions will automatically queue SSP_DUMMY bytes to transmit and activate the clock
-to receive data into your application's receive buffer.
+bytes.  These functions will automatically send SSP_DUMMY bytes and activate the clock
+to receive data into your application's receive buffer.  SspTransfer() does the same with separate
+transmit and receive buffers of the caller's choosing when real data has to go out while receiving.
 
 
 SLAVE MODE DATA TRANSFER:
@@ -121,18 +134,24 @@ Variable names shall start with "SSP_" and be declared as static.
 ***********************************************************************************************************************/
 static fnCode_type Ssp_pfnStateMachine;          /* The SSP application state machine */
 
-static u32 SSP_u32Timer;                         /* Timeout counter used across states */
 static u32 SSP_u32Flags;                         /* Application flags for SSP */
 
 static SspPeripheralType SSP_Peripheral0;        /* SSP0 peripheral object */
 static SspPeripheralType SSP_Peripheral1;        /* SSP1 peripheral object */
 static SspPeripheralType SSP_Peripheral2;        /* SSP2 peripheral object */
 
-static SspPeripheralType* SSP_psCurrentSsp;      /* Current SSP peripheral being processed task */
+static SspPeripheralType SSP_asSharedDevices[SSP_SHARED_DEVICES]; /* Extra device objects for shared buses */
+
+static SspPeripheralType* const SSP_apsPeripherals[SSP_PERIPHERALS] = 
+{&SSP_Peripheral0, &SSP_Peripheral1, &SSP_Peripheral2}; /* Each peripheral's own device object by bus index */
+static SspPeripheralType* const SSP_apsDevices[SSP_DEVICES] = 
+{&SSP_Peripheral0, &SSP_Peripheral1, &SSP_Peripheral2,
+ &SSP_asSharedDevices[0], &SSP_asSharedDevices[1]};    /* All device objects in service order */
+static SspBusType SSP_asBuses[SSP_PERIPHERALS];  /* Arbitration state of each peripheral */
 static SspPeripheralType* SSP_psCurrentISR;      /* Current SSP peripheral being processed in ISR */
 static u32* SSP_pu32SspApplicationFlagsISR;      /* Current SSP application status flags in ISR */
 
-//static u8 SSP_au8Dummies[MAX_TX_MESSAGE_LENGTH]; /* Array of dummy bytes sent to receive bytes from a slave */
+static u8 SSP_au8Dummies[SSP_DUMMY_BLOCK_SIZE];   /* Dummy bytes sent (repeatedly) to receive bytes from a slave */
 
 static u32 SSP_u32Int0Count = 0;                 /* Debug counter for SSP0 interrupts */
 static u32 SSP_u32Int1Count = 0;                 /* Debug counter for SSP1 interrupts */
@@ -159,20 +178,22 @@ SPI_SLAVE: transmit through Message Task; receive set up per-byte using current
 SPI_SLAVE_FLOW_CONTROL:
 
 Requires:
-  - SSP peripheral register initialization values in configuration.h must be set correctly; currently this does not support
-    different SSP configurations for multiple slaves on the same bus - all peripherals on the bus must work with
-    the same setup.
-  - psSspConfig_ has the SSP peripheral number, address of the RxBuffer and the RxBuffer size
+  - SSP peripheral register initialization values in configuration.h must be set correctly; a device that needs a 
+    different clock or mode on a shared bus sets u32ModeRegister/u32BaudRateRegister
+  - psSspConfig_ has the SSP peripheral number, address of the RxBuffer and the RxBuffer size, and the
+    transmit priority class and byte quota
   - the calling application is ready to start using the peripheral
 
 Promises:
-  - Returns a pointer to the requested SSP peripheral object if the resource is available; otherwise returns NULL
-  - Peripheral is enabled
-  - Peripheral interrupts are enabled.
+  - Returns a pointer to a device object on the requested SSP peripheral if one is available; otherwise returns NULL.
+    A Slave needs the peripheral to itself; Masters may share it up to SSP_SHARED_DEVICES extra devices in total.
+  - The first device on a peripheral enables it and its interrupts; later devices only add their settings
 */
 SspPeripheralType* SspRequest(SspConfigurationType* psSspConfig_)
 {
   SspPeripheralType* psRequestedSsp; 
+  SspBusType* psBus;
+  u8 u8Bus;
   u32 u32TargetCR, u32TargetMR, u32TargetIER, u32TargetIDR, u32TargetBRGR;
 
   /* Set the peripheral pointer to the correct resource */
@@ -180,7 +201,7 @@ SspPeripheralType* SspRequest(SspConfigurationType* psSspConfig_)
   {
     case USART0:
     {
-      psRequestedSsp = &SSP_Peripheral0;
+      u8Bus = 0;
       
       u32TargetCR   = USART0_US_CR_INIT;
       u32TargetMR   = USART0_US_MR_INIT; 
@@ -191,7 +212,7 @@ SspPeripheralType* SspRequest(SspConfigurationType* psSspConfig_)
     }
     case USART1:
     {
-      psRequestedSsp = &SSP_Peripheral1;
+      u8Bus = 1;
       
       u32TargetCR   = USART1_US_CR_INIT;
       u32TargetMR   = USART1_US_MR_INIT; 
@@ -202,7 +223,7 @@ SspPeripheralType* SspRequest(SspConfigurationType* psSspConfig_)
     }
     case USART2:
     {
-      psRequestedSsp = &SSP_Peripheral2;
+      u8Bus = 2;
       
       u32TargetCR   = USART2_US_CR_INIT;
       u32TargetMR   = USART2_US_MR_INIT; 
@@ -218,15 +239,42 @@ SspPeripheralType* SspRequest(SspConfigurationType* psSspConfig_)
     }
   } /* end switch */
   
-  /* If the requested peripheral is already assigned, return NULL now */
-  if(psRequestedSsp->u32PrivateFlags & _SSP_PERIPHERAL_ASSIGNED)
+  /* A bus in use can only take another Master, and only if no Slave is on it */
+  psBus = &SSP_asBuses[u8Bus];
+  psRequestedSsp = SSP_apsPeripherals[u8Bus];
+  if(psBus->u8Devices != 0)
   {
-    return(NULL);
+    if( (psSspConfig_->eSspMode == SPI_SLAVE) || (psSspConfig_->eSspMode == SPI_SLAVE_FLOW_CONTROL) ||
+        (psBus->psActiveDevice->eSspMode == SPI_SLAVE) || 
+        (psBus->psActiveDevice->eSspMode == SPI_SLAVE_FLOW_CONTROL) )
+    {
+      return(NULL);
+    }
+    
+    /* Use the peripheral's own object if it is free, otherwise a shared one */
+    if(psRequestedSsp->u32PrivateFlags & _SSP_PERIPHERAL_ASSIGNED)
+    {
+      psRequestedSsp = NULL;
+      for(u8 i = 0; i < SSP_SHARED_DEVICES; i++)
+      {
+        if( !(SSP_asSharedDevices[i].u32PrivateFlags & _SSP_PERIPHERAL_ASSIGNED) )
+        {
+          psRequestedSsp = &SSP_asSharedDevices[i];
+          break;
+        }
+      }
+      
+      if(psRequestedSsp == NULL)
+      {
+        return(NULL);
+      }
+      
+      psRequestedSsp->pBaseAddress   = SSP_apsPeripherals[u8Bus]->pBaseAddress;
+      psRequestedSsp->u8PeripheralId = SSP_apsPeripherals[u8Bus]->u8PeripheralId;
+      psRequestedSsp->u8BusIndex     = u8Bus;
+    }
   }
 
-  /* Activate and configure the peripheral */
-  AT91C_BASE_PMC->PMC_PCER |= (1 << psRequestedSsp->u8PeripheralId);
-  
   psRequestedSsp->pCsGpioAddress = psSspConfig_->pCsGpioAddress;
   psRequestedSsp->u32CsPin       = psSspConfig_->u32CsPin;
   psRequestedSsp->eBitOrder      = psSspConfig_->eBitOrder;
@@ -237,12 +285,39 @@ SspPeripheralType* SspRequest(SspConfigurationType* psSspConfig_)
   psRequestedSsp->ppu8RxNextByte  = psSspConfig_->ppu8RxNextByte;
   psRequestedSsp->u16RxBufferSize = psSspConfig_->u16RxBufferSize;
   psRequestedSsp->u32PrivateFlags |= _SSP_PERIPHERAL_ASSIGNED;
+  SetMessageQueuePriority(&psRequestedSsp->sTransmitQueue, psSspConfig_->eTxPriority, psSspConfig_->u32TxByteQuota);
+
+  /* Keep the device's register settings to reload whenever the bus switches to it */
+  psRequestedSsp->u32ControlRegister  = u32TargetCR;
+  psRequestedSsp->u32ModeRegister     = u32TargetMR;
+  psRequestedSsp->u32BaudRateRegister = u32TargetBRGR;
+  if(psSspConfig_->u32ModeRegister != 0)
+  {
+    psRequestedSsp->u32ModeRegister = psSspConfig_->u32ModeRegister;
+  }
+  if(psSspConfig_->u32BaudRateRegister != 0)
+  {
+    psRequestedSsp->u32BaudRateRegister = psSspConfig_->u32BaudRateRegister;
+  }
+
+  /* The other devices on a shared bus already have the peripheral running */
+  psBus->u8Devices++;
+  if(psBus->u8Devices != 1)
+  {
+    return(psRequestedSsp);
+  }
+  
+  /* Activate and configure the peripheral */
+  AT91C_BASE_PMC->PMC_PCER |= (1 << psRequestedSsp->u8PeripheralId);
+  psBus->psActiveDevice     = psRequestedSsp;
+  psBus->psConfiguredDevice = psRequestedSsp;
+  psBus->psCsOwner          = NULL;
    
   psRequestedSsp->pBaseAddress->US_CR   = u32TargetCR;
-  psRequestedSsp->pBaseAddress->US_MR   = u32TargetMR;
+  psRequestedSsp->pBaseAddress->US_MR   = psRequestedSsp->u32ModeRegister;
   psRequestedSsp->pBaseAddress->US_IER  = u32TargetIER;
   psRequestedSsp->pBaseAddress->US_IDR  = u32TargetIDR;
-  psRequestedSsp->pBaseAddress->US_BRGR = u32TargetBRGR;
+  psRequestedSsp->pBaseAddress->US_BRGR = psRequestedSsp->u32BaudRateRegister;
   
   if(psRequestedSsp->eSspMode == SPI_SLAVE)
   {
@@ -285,11 +360,12 @@ Requires:
 
 Promises:
   - Resets peripheral object's pointers and data to safe values
-  - Peripheral is disabled
-  - Peripheral interrupts are disabled.
+  - The bus forgets the device; the peripheral interrupts stay disabled once its last device is released
 */
 void SspRelease(SspPeripheralType* psSspPeripheral_)
 {
+  SspBusType* psBus = &SSP_asBuses[psSspPeripheral_->u8BusIndex];
+  
   /* Check to see if the peripheral is already released */
   if(psSspPeripheral_->pu8RxBuffer == NULL)
   {
@@ -299,20 +375,46 @@ void SspRelease(SspPeripheralType* psSspPeripheral_)
   /* First disable the interrupts */
   NVIC_DisableIRQ( (IRQn_Type)(psSspPeripheral_->u8PeripheralId) );
   NVIC_ClearPendingIRQ( (IRQn_Type)(psSspPeripheral_->u8PeripheralId) );
+  
+  /* Take the device off the bus; the peripheral's own object stands in as the ISR target */
+  psBus->u8Devices--;
+  if(psBus->psCsOwner == psSspPeripheral_)
+  {
+    psBus->psCsOwner = NULL;
+  }
+  if(psBus->psConfiguredDevice == psSspPeripheral_)
+  {
+    psBus->psConfiguredDevice = NULL;
+  }
+  if(psBus->psActiveDevice == psSspPeripheral_)
+  {
+    psBus->psActiveDevice = SSP_apsPeripherals[psSspPeripheral_->u8BusIndex];
+  }
  
   /* Now it's safe to release all of the resources in the target peripheral */
   psSspPeripheral_->pCsGpioAddress = NULL;
   psSspPeripheral_->pu8RxBuffer    = NULL;
   psSspPeripheral_->ppu8RxNextByte  = NULL;
+  psSspPeripheral_->pu8TransferTxData = NULL;
+  psSspPeripheral_->pu8TransferRxData = NULL;
+  psSspPeripheral_->u16RxBytes      = 0;
+  psSspPeripheral_->u16DummyBytes   = 0;
   psSspPeripheral_->u32PrivateFlags = 0;
   psSspPeripheral_->fnSlaveTxFlowCallback = NULL;
   psSspPeripheral_->fnSlaveRxFlowCallback = NULL;
 
   /* Empty the transmit buffer if there were leftover messages */
-  while(psSspPeripheral_->psTransmitBuffer != NULL)
+  while(psSspPeripheral_->sTransmitQueue.psHead != NULL)
+  {
+    UpdateMessageStatus(psSspPeripheral_->sTransmitQueue.psHead->u32Token, ABANDONED);
+    DeQueueMessage(&psSspPeripheral_->sTransmitQueue);
+  }
+  SetMessageQueuePriority(&psSspPeripheral_->sTransmitQueue, MSG_PRIORITY_NORMAL, 0);
+
+  /* Other devices on the bus carry on */
+  if(psBus->u8Devices != 0)
   {
-    UpdateMessageStatus(psSspPeripheral_->psTransmitBuffer->u32Token, ABANDONED);
-    DeQueueMessage(&psSspPeripheral_->psTransmitBuffer);
+    NVIC_EnableIRQ( (IRQn_Type)(psSspPeripheral_->u8PeripheralId) );
   }
   
   /* Ensure the SM is in the Idle state */
@@ -325,19 +427,34 @@ void SspRelease(SspPeripheralType* psSspPeripheral_)
 Function: SspAssertCS
 
 Description:
-Asserts (CLEARS) the CS line on the target SSP peripheral.  
+Asserts (CLEARS) the CS line on the target SSP peripheral and holds the bus for it until SspDeAssertCS().  
 
 Requires:
   - psSspPeripheral_ has been requested.
 
 Promises:
-  - Target's CS line is LOW
+  - Target's CS line is LOW now if the bus is free or already working for this device; otherwise it goes LOW
+    when this device's next transfer starts (so it is never asserted under another device's transfer)
+  - A message already queued for the device is started if the bus is free
 */
 void SspAssertCS(SspPeripheralType* psSspPeripheral_)
 {
-  //u32 u32Test = psSspPeripheral_->u32CsPin;
-  //u32 u32Test2 = psSspPeripheral_->pCsGpioAddress->PIO_CODR;
-  psSspPeripheral_->pCsGpioAddress->PIO_CODR = psSspPeripheral_->u32CsPin;
+  SspBusType* psBus = &SSP_asBuses[psSspPeripheral_->u8BusIndex];
+  
+  NVIC_DisableIRQ( (IRQn_Type)(psSspPeripheral_->u8PeripheralId) );
+  psSspPeripheral_->u32PrivateFlags |= _SSP_PERIPHERAL_CS_HELD;
+  
+  if( ( (psBus->psCsOwner == NULL) || (psBus->psCsOwner == psSspPeripheral_) ) &&
+      ( (psBus->psActiveDevice == psSspPeripheral_) || 
+       !(psBus->psActiveDevice->u32PrivateFlags & (_SSP_PERIPHERAL_TX | _SSP_PERIPHERAL_RX)) ) )
+  {
+    psBus->psCsOwner = psSspPeripheral_;
+    psSspPeripheral_->pCsGpioAddress->PIO_CODR = psSspPeripheral_->u32CsPin;
+  }
+  NVIC_EnableIRQ( (IRQn_Type)(psSspPeripheral_->u8PeripheralId) );
+  
+  /* Messages queued before CS was asserted were held back by SspStartTransfer() */
+  SspStartTransfer(psSspPeripheral_);
   
 } /* end SspAssertCS() */
 
@@ -346,17 +463,30 @@ void SspAssertCS(SspPeripheralType* psSspPeripheral_)
 Function: SspDeAssertCS
 
 Description:
-Deasserts (SETS) the CS line on the target SSP peripheral.  
+Deasserts (SETS) the CS line on the target SSP peripheral and lets the other devices on the bus run.  
 
 Requires:
   - psSspPeripheral_ has been requested.
+  - No transfer of this device is in progress
 
 Promises:
   - Target's CS line is HIGH
+  - The bus is no longer held for the device and the next waiting device is started
 */
 void SspDeAssertCS(SspPeripheralType* psSspPeripheral_)
 {
+  SspBusType* psBus = &SSP_asBuses[psSspPeripheral_->u8BusIndex];
+  
+  NVIC_DisableIRQ( (IRQn_Type)(psSspPeripheral_->u8PeripheralId) );
   psSspPeripheral_->pCsGpioAddress->PIO_SODR = psSspPeripheral_->u32CsPin;
+  psSspPeripheral_->u32PrivateFlags &= ~_SSP_PERIPHERAL_CS_HELD;
+  if(psBus->psCsOwner == psSspPeripheral_)
+  {
+    psBus->psCsOwner = NULL;
+  }
+  NVIC_EnableIRQ( (IRQn_Type)(psSspPeripheral_->u8PeripheralId) );
+  
+  SspBusStartNext(psSspPeripheral_);
   
 } /* end SspDessertCS() */
 
@@ -372,7 +502,7 @@ Requires:
   - The chip select line of the SSP device should be asserted
 
 Promises:
-  - Creates a 1-byte message at psSspPeripheral_->psTransmitBuffer that will be sent by the SSP application
+  - Creates a 1-byte message in psSspPeripheral_->sTransmitQueue that will be sent by the SSP application
     when it is available.
   - Returns the message token assigned to the message
 */
@@ -381,15 +511,11 @@ u32 SspWriteByte(SspPeripheralType* psSspPeripheral_, u8 u8Byte_)
   u32 u32Token;
   u8 u8Data = u8Byte_;
   
-  u32Token = QueueMessage(&psSspPeripheral_->psTransmitBuffer, 1, &u8Data);
+  u32Token = QueueMessage(&psSspPeripheral_->sTransmitQueue, 1, &u8Data);
   if( u32Token != 0 )
   {
-    /* If the system is initializing, we want to manually cycle the SSP task through one iteration
-    to send the message */
-    if(G_u32SystemFlags & _SYSTEM_INITIALIZING)
-    {
-      SspManualMode();
-    }
+    /* Start right away if the peripheral is idle */
+    SspStartTransfer(psSspPeripheral_);
   }
   
   return(u32Token);
@@ -411,7 +537,7 @@ Requires:
   - u8Data_ points to the first byte of the data array
 
 Promises:
-  - adds the data message at psSspPeripheral_->psTransmitBuffer that will be sent by the SSP application
+  - adds the data message in psSspPeripheral_->sTransmitQueue that will be sent by the SSP application
     when it is available.
   - Returns the message token assigned to the message; 0 is returned if the message cannot be queued in which case
     G_u32MessagingFlags can be checked for the reason
@@ -420,21 +546,56 @@ u32 SspWriteData(SspPeripheralType* psSspPeripheral_, u32 u32Size_, u8* pu8Data_
 {
   u32 u32Token;
 
-  u32Token = QueueMessage(&psSspPeripheral_->psTransmitBuffer, u32Size_, pu8Data_);
+  u32Token = QueueMessage(&psSspPeripheral_->sTransmitQueue, u32Size_, pu8Data_);
   if( u32Token == 0 )
   {
     return(0);
   }
   
-  /* If the system is initializing, manually cycle the SSP task through one iteration to send the message */
-  if(G_u32SystemFlags & _SYSTEM_INITIALIZING)
+  /* Start right away if the peripheral is idle */
+  SspStartTransfer(psSspPeripheral_);
+
+  return(u32Token);
+
+} /* end SspWriteData() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: SspWriteDataReference
+
+Description:
+Queues a data array for transfer on the target SSP peripheral without copying it.  The PDC sends
+directly from pu8Data_ (see QueueMessageReference for the ownership rules).
+
+Requires:
+  - psSspPeripheral_ has been requested
+  - The chip select line of the SSP device should be asserted
+  - u32Size_ is the number of bytes in the data array
+  - pu8Data_ points to the first byte of the data array which must not change until the status of the 
+    returned token is COMPLETE or ABANDONED, or SspTxQueueCount() shows that the message has left the queue (a 
+    TIMEOUT message is still queued)
+
+Promises:
+  - adds a message referencing pu8Data_ in psSspPeripheral_->sTransmitQueue that will be sent by the SSP application
+    when it is available.
+  - Returns the message token assigned to the message; 0 is returned if the message cannot be queued
+*/
+u32 SspWriteDataReference(SspPeripheralType* psSspPeripheral_, u32 u32Size_, u8* pu8Data_)
+{
+  u32 u32Token;
+
+  u32Token = QueueMessageReference(&psSspPeripheral_->sTransmitQueue, u32Size_, pu8Data_);
+  if( u32Token == 0 )
   {
-    SspManualMode();
+    return(0);
   }
+  
+  /* Start right away if the peripheral is idle */
+  SspStartTransfer(psSspPeripheral_);
 
   return(u32Token);
 
-} /* end SspWriteData() */
+} /* end SspWriteDataReference() */
 
 
 /*----------------------------------------------------------------------------------------------------------------------
@@ -448,22 +609,14 @@ Requires:
   - 
 
 Promises:
-  - Creates a message with one SSP_DUMMY_BYTE at psSspPeripheral_->psTransmitBuffer that will be sent by the SSP application
+  - Creates a message with one SSP_DUMMY_BYTE in psSspPeripheral_->sTransmitQueue that will be sent by the SSP application
     when it is available and thus clock in a received byte to the target receive buffer.
   - Returns the Token of the transmitted dummy message used to read data.
 
 */
 bool SspReadByte(SspPeripheralType* psSspPeripheral_)
 {
-  /* Make sure no receive function is already in progress based on the bytes in the buffer */
-  if( psSspPeripheral_->u16RxBytes != 0)
-  {
-    return FALSE;
-  }
-  
-  /* Load the counter and return success */
-  psSspPeripheral_->u16RxBytes = 1;
-  return TRUE;
+  return( SspTransfer(psSspPeripheral_, NULL, psSspPeripheral_->pu8RxBuffer, 1) );
   
 } /* end SspReadByte() */
 
@@ -493,17 +646,55 @@ bool SspReadData(SspPeripheralType* psSspPeripheral_, u16 u16Size_)
     return FALSE;
   }
   
+  return( SspTransfer(psSspPeripheral_, NULL, psSspPeripheral_->pu8RxBuffer, u16Size_) );
+    
+} /* end SspReadData() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: SspTransfer
+
+Description:
+Master mode only.  Clocks u16Size_ bytes in both directions at once: pu8TxData_ is sent while the slave's bytes are
+received to pu8RxData_.  For a receive-only transfer pass NULL for pu8TxData_ and SSP_DUMMY_BYTEs are sent from 
+SSP_au8Dummies (filled once in SspInitialize) so nothing has to be filled per transfer.  The block is only 
+SSP_DUMMY_BLOCK_SIZE bytes, so the PDC sends it repeatedly (see SspLoadDummies).  The transfer uses the 
+PDC in both directions and completes like SspReadData() (see SspQueryReceiveStatus).
+
+Requires:
+  - If CS is under manual control for the target SSP peripheral, it should already be asserted
+  - pu8TxData_ points to u16Size_ bytes to send that must not change until the transfer is complete; or is NULL 
+    to send dummy bytes
+  - pu8RxData_ has room for u16Size_ bytes
+  - u16Size_ is the number of bytes to transfer
+
+Promises:
+  - Returns TRUE and the transfer is started (or will be as soon as the peripheral is idle)
+  - Returns FALSE if the size is invalid or the peripheral already has a read/transfer request
+*/
+bool SspTransfer(SspPeripheralType* psSspPeripheral_, u8* pu8TxData_, u8* pu8RxData_, u16 u16Size_)
+{
+  if(u16Size_ == 0)
+  {
+    return FALSE;
+  }
+  
   /* Make sure no receive function is already in progress based on the bytes in the buffer */
   if( psSspPeripheral_->u16RxBytes != 0)
   {
     return FALSE;
   }
   
-  /* Load the counter and return success */
+  psSspPeripheral_->pu8TransferTxData = pu8TxData_;
+  psSspPeripheral_->pu8TransferRxData = pu8RxData_;
+  psSspPeripheral_->u16DummyBytes = (pu8TxData_ == NULL) ? u16Size_ : 0;
+
+  /* Load the counter, start right away if the peripheral is idle and return success */
   psSspPeripheral_->u16RxBytes = u16Size_;
+  SspStartTransfer(psSspPeripheral_);
   return TRUE;
     
-} /* end SspReadData() */
+} /* end SspTransfer() */
 
 
 /*----------------------------------------------------------------------------------------------------------------------
@@ -513,7 +704,7 @@ Description:
 Returns status of currently requested receive data.
 
 Requires:
-  - SSP_psCurrentSsp->u16RxBytes
+  - psSspPeripheral_->u16RxBytes
 
 Promises:
   - Returns the message token of the dummy message used to read data
@@ -552,6 +743,27 @@ SspRxStatusType SspQueryReceiveStatus(SspPeripheralType* psSspPeripheral_)
 } /* end SspQueryReceiveStatus() */
 
 
+/*----------------------------------------------------------------------------------------------------------------------
+Function: SspTxQueueCount
+
+Description:
+Reports how many messages are still in a device's transmit queue.  A message leaves the queue only once the PDC has 
+read all of its bytes (or the scavenger has abandoned it), so a client whose queue is empty knows that none of its
+reference messages is still using its buffer.
+
+Requires:
+  - psSspPeripheral_ has been requested
+
+Promises:
+  - Returns psSspPeripheral_->sTransmitQueue.u32Count
+*/
+u32 SspTxQueueCount(SspPeripheralType* psSspPeripheral_)
+{
+  return(psSspPeripheral_->sTransmitQueue.u32Count);
+  
+} /* end SspTxQueueCount() */
+
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Protected Functions */
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -577,35 +789,61 @@ void SspInitialize(void)
   /* Initialize the SSP peripheral structures */
   SSP_Peripheral0.pBaseAddress     = AT91C_BASE_US0;
   SSP_Peripheral0.pCsGpioAddress   = NULL;
-  SSP_Peripheral0.psTransmitBuffer = NULL;
+  InitializeMessageQueue(&SSP_Peripheral0.sTransmitQueue);
+  RegisterMessageQueue(&SSP_Peripheral0.sTransmitQueue);
   SSP_Peripheral0.pu8RxBuffer      = NULL;
   SSP_Peripheral0.u16RxBufferSize  = 0;
   SSP_Peripheral0.ppu8RxNextByte    = NULL;
   SSP_Peripheral0.u32PrivateFlags  = 0;
   SSP_Peripheral0.u8PeripheralId   = AT91C_ID_US0;
+  SSP_Peripheral0.u8BusIndex       = 0;
   
   SSP_Peripheral1.pBaseAddress     = AT91C_BASE_US1;
   SSP_Peripheral1.pCsGpioAddress   = NULL;
-  SSP_Peripheral1.psTransmitBuffer = NULL;
+  InitializeMessageQueue(&SSP_Peripheral1.sTransmitQueue);
+  RegisterMessageQueue(&SSP_Peripheral1.sTransmitQueue);
   SSP_Peripheral1.pu8RxBuffer      = NULL;
   SSP_Peripheral1.u16RxBufferSize  = 0;
   SSP_Peripheral1.ppu8RxNextByte    = NULL;
   SSP_Peripheral1.u32PrivateFlags  = 0;
   SSP_Peripheral1.u8PeripheralId   = AT91C_ID_US1;
+  SSP_Peripheral1.u8BusIndex       = 1;
 
   SSP_Peripheral2.pBaseAddress     = AT91C_BASE_US2;
   SSP_Peripheral2.pCsGpioAddress   = NULL;
-  SSP_Peripheral2.psTransmitBuffer = NULL;
+  InitializeMessageQueue(&SSP_Peripheral2.sTransmitQueue);
+  RegisterMessageQueue(&SSP_Peripheral2.sTransmitQueue);
   SSP_Peripheral2.pu8RxBuffer      = NULL;
   SSP_Peripheral2.u16RxBufferSize  = 0;
   SSP_Peripheral2.ppu8RxNextByte    = NULL;
   SSP_Peripheral2.u32PrivateFlags  = 0;
   SSP_Peripheral2.u8PeripheralId   = AT91C_ID_US2;
+  SSP_Peripheral2.u8BusIndex       = 2;
 
-  SSP_psCurrentSsp                = &SSP_Peripheral0;
-  
-  /* Fill the dummy array with SSP_DUMMY bytes */
-  //memset(SSP_au8Dummies, SSP_DUMMY_BYTE, MAX_TX_MESSAGE_LENGTH);
+  /* Shared device objects get their peripheral when they are requested */
+  for(u8 i = 0; i < SSP_SHARED_DEVICES; i++)
+  {
+    SSP_asSharedDevices[i].pBaseAddress    = NULL;
+    SSP_asSharedDevices[i].pCsGpioAddress  = NULL;
+    InitializeMessageQueue(&SSP_asSharedDevices[i].sTransmitQueue);
+    RegisterMessageQueue(&SSP_asSharedDevices[i].sTransmitQueue);
+    SSP_asSharedDevices[i].pu8RxBuffer     = NULL;
+    SSP_asSharedDevices[i].u16RxBufferSize = 0;
+    SSP_asSharedDevices[i].ppu8RxNextByte  = NULL;
+    SSP_asSharedDevices[i].u32PrivateFlags = 0;
+  }
+
+  /* Each bus starts out idle with its own object as the ISR target */
+  for(u8 i = 0; i < SSP_PERIPHERALS; i++)
+  {
+    SSP_asBuses[i].psActiveDevice     = SSP_apsPeripherals[i];
+    SSP_asBuses[i].psConfiguredDevice = NULL;
+    SSP_asBuses[i].psCsOwner          = NULL;
+    SSP_asBuses[i].u8Devices          = 0;
+  }
+
+  /* Fill the dummy array with SSP_DUMMY bytes once; receive-only transfers send straight from it */
+  memset(SSP_au8Dummies, SSP_DUMMY_BYTE, SSP_DUMMY_BLOCK_SIZE);
 
   /* Set application pointer */
   Ssp_pfnStateMachine = SspSM_Idle;
@@ -635,41 +873,250 @@ void SspRunActiveState(void)
 } /* end SspRunActiveState */
 
 
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Private functions */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+
 /*----------------------------------------------------------------------------------------------------------------------
-Function: SspManualMode
+Function: SspStartTransfer
 
 Description:
-Runs a transmit cycle of the SSP application to clock out a message.  This function is used only during
-initialization.
+Starts the next piece of work on an SSP device if its bus is idle: a pending receive (dummy bytes are sent) or
+the message at the head of the transmit queue.  Called every pass of SspSM_Idle(), straight from the 
+write/read API functions so a transfer to an idle bus starts without waiting for the state machine, and from
+the SSP ISR (SspBusStartNext) so transfers on a bus run back to back.  The device's US_MR/US_BRGR settings are
+loaded first if another device used the bus last.
 
 Requires:
-  - SSP application has been initialized.
+  - For Master devices sending a message, psSsp_->sTransmitQueue.psHead->pu8Data points to the application transmit buffer
+  - For Master devices receiving a message, psSsp_->u16RxBytes != 0
 
 Promises:
-  - All bytes currently in the SSP Tx FIFO are sent out and thus all the expected received bytes
-    are read into the application receive circular buffer.
+  - If psSsp_ has work pending, its bus is not transmitting or receiving and not held by another device's CS,
+    the transfer is started, psSsp_ becomes the bus's active device and _SSP_PERIPHERAL_RX or _SSP_PERIPHERAL_TX
+    is set; otherwise nothing changes
+  - A SPI_MASTER_MANUAL_CS message is not started until the device has called SspAssertCS()
 */
-void SspManualMode(void)
+static void SspStartTransfer(SspPeripheralType* psSsp_)
 {
-  /* Set up for manual mode */
-  SSP_u32Flags |= _SSP_MANUAL_MODE;
-  SSP_psCurrentSsp = &SSP_Peripheral0;
-
-  /* Run a full cycle of the SSP state machine so all SSP peripherals send their current message */  
-  while(SSP_u32Flags & _SSP_MANUAL_MODE)
+  u32 u32Byte;
+  SspBusType* psBus = &SSP_asBuses[psSsp_->u8BusIndex];
+  
+  if( (psSsp_->sTransmitQueue.psHead == NULL) && (psSsp_->u16RxBytes == 0) )
   {
-    Ssp_pfnStateMachine();
-    
-    SSP_u32Timer = G_u32SystemTime1ms;
-    IsTimeUp(&SSP_u32Timer, 1);
+    return;
   }
+  
+  /* A manual CS message must not be clocked out before its CS is asserted.  Receives are allowed with CS
+  deasserted since they are how the dummy clocks are sent (e.g. the SD card wakeup). */
+  if( (psSsp_->eSspMode == SPI_MASTER_MANUAL_CS) && (psSsp_->u16RxBytes == 0) &&
+      !(psSsp_->u32PrivateFlags & _SSP_PERIPHERAL_CS_HELD) )
+  {
+    return;
+  }
+  
+  /* The ISR can also start transfers on this bus, so keep it out while the bus is checked and claimed */
+  NVIC_DisableIRQ( (IRQn_Type)psSsp_->u8PeripheralId );
+  if( !(psBus->psActiveDevice->u32PrivateFlags & (_SSP_PERIPHERAL_TX | _SSP_PERIPHERAL_RX)) &&
+       ( (psBus->psCsOwner == NULL) || (psBus->psCsOwner == psSsp_) ) )
+  {
+    /* Switch the peripheral to this device's clock and mode if another device used it last */
+    if(psBus->psConfiguredDevice != psSsp_)
+    {
+      psSsp_->pBaseAddress->US_CR   = AT91C_US_RSTRX | AT91C_US_RSTTX;
+      psSsp_->pBaseAddress->US_MR   = psSsp_->u32ModeRegister;
+      psSsp_->pBaseAddress->US_BRGR = psSsp_->u32BaudRateRegister;
+      psSsp_->pBaseAddress->US_CR   = psSsp_->u32ControlRegister;
+      psBus->psConfiguredDevice = psSsp_;
+    }
+    psBus->psActiveDevice = psSsp_;
+    
+    /* A SPI_MASTER_MANUAL_CS device that asked for CS while the bus was busy gets it now */
+    if( (psSsp_->u32PrivateFlags & _SSP_PERIPHERAL_CS_HELD) && (psBus->psCsOwner != psSsp_) )
+    {
+      psBus->psCsOwner = psSsp_;
+      psSsp_->pCsGpioAddress->PIO_CODR = psSsp_->u32CsPin;
+    }
+    
+    /* For an SPI_MASTER_AUTO_CS device, start by asserting chip select 
+   (SPI_MASTER_MANUAL_CS devices should already have asserted CS in the user's task) */
+    if(psSsp_->eSspMode == SPI_MASTER_AUTO_CS)
+    {
+      psSsp_->pCsGpioAddress->PIO_CODR = psSsp_->u32CsPin;
+    }
+       
+    /* Check if the message is receiving based on expected byte count */
+    if(psSsp_->u16RxBytes !=0)
+    {
+      /* Receiving: flag that the peripheral is now busy */
+      psSsp_->u32PrivateFlags |= _SSP_PERIPHERAL_RX;    
       
-} /* end SspManualMode() */
+      /* Load the PDC counter and pointer registers.  The transmit side sends the caller's data or the
+      dummy byte block (see SspTransfer). */
+      psSsp_->pBaseAddress->US_RPR = (unsigned int)psSsp_->pu8TransferRxData; 
+      psSsp_->pBaseAddress->US_RCR = psSsp_->u16RxBytes;
+      if(psSsp_->u16DummyBytes != 0)
+      {
+        /* Fill both the current and the next transmit registers with a dummy block */
+        psSsp_->pBaseAddress->US_TCR = 0;
+        SspLoadDummies(psSsp_);
+        if(psSsp_->u16DummyBytes != 0)
+        {
+          SspLoadDummies(psSsp_);
+        }
+      }
+      else
+      {
+        psSsp_->pBaseAddress->US_TPR = (unsigned int)psSsp_->pu8TransferTxData; 
+        psSsp_->pBaseAddress->US_TCR = psSsp_->u16RxBytes;
+      }
 
+      /* When RCR is loaded, the ENDRX flag is cleared so it is safe to enable the interrupt */
+      psSsp_->pBaseAddress->US_IER = AT91C_US_ENDRX;
+      
+      /* Enable the receiver and transmitter to start the transfer */
+      psSsp_->pBaseAddress->US_PTCR = AT91C_PDC_RXTEN | AT91C_PDC_TXTEN;
+    } /* End of receive function */
+    else
+    {
+      /* Transmitting: update the message's status and flag that the peripheral is now busy */
+      MarkMessageSending(psSsp_->sTransmitQueue.psHead);
+      psSsp_->u32PrivateFlags |= _SSP_PERIPHERAL_TX;    
+      
+      /* TRANSMIT SPI_SPI_SLAVE_FLOW_CONTROL */
+      /* A Slave device with flow control uses interrupt-driven single byte transfers */
+      if(psSsp_->eSspMode == SPI_SLAVE_FLOW_CONTROL)
+      {
+        /* At this point, CS is asserted and the master is waiting for flow control.
+        Load in the message parameters. */
+        psSsp_->u32CurrentTxBytesRemaining = psSsp_->sTransmitQueue.psHead->u32Size;
+        psSsp_->pu8CurrentTxData = psSsp_->sTransmitQueue.psHead->pu8Data;
 
-/*--------------------------------------------------------------------------------------------------------------------*/
-/* Private functions */
-/*--------------------------------------------------------------------------------------------------------------------*/
+        /* If we need LSB first, use inline assembly to flip bits with a single instruction. */
+        u32Byte = 0x000000FF & *psSsp_->pu8CurrentTxData;
+        if(psSsp_->eBitOrder == LSB_FIRST)
+        {
+          u32Byte = __RBIT(u32Byte)>>24;
+        }
+        
+        /* Reset the transmitter since we have not been managing dummy bytes and it tends to be
+        in the middle of a transmission or something that causes the wrong byte to get sent (at least on startup). */
+        psSsp_->pBaseAddress->US_CR = (AT91C_US_RSTTX);
+        psSsp_->pBaseAddress->US_CR = (AT91C_US_TXEN);
+        psSsp_->pBaseAddress->US_THR = (u8)u32Byte;
+        psSsp_->pBaseAddress->US_IDR = AT91C_US_RXRDY;
+        psSsp_->pBaseAddress->US_IER = AT91C_US_TXEMPTY;
+        psSsp_->fnSlaveTxFlowCallback();
+      }
+      
+      /* TRANSMIT SPI_MASTER_AUTO_CS, SPI_MASTER_MANUAL_CS, SPI_SLAVE NO FLOW CONTROL */
+      /* A Master or Slave device without flow control uses the PDC */
+      else
+      {
+        /* Load the PDC counter and pointer registers */
+        psSsp_->pBaseAddress->US_TPR = (unsigned int)psSsp_->sTransmitQueue.psHead->pu8Data; 
+        psSsp_->pBaseAddress->US_TCR = psSsp_->sTransmitQueue.psHead->u32Size;
+   
+        /* When TCR is loaded, the ENDTX flag is cleared so it is safe to enable the interrupt */
+        psSsp_->pBaseAddress->US_IER = AT91C_US_ENDTX;
+        
+        /* Enable the transmitter to start the transfer */
+        psSsp_->pBaseAddress->US_PTCR = AT91C_PDC_TXTEN;
+      }
+    } /* End of transmitting function */
+  }
+  NVIC_EnableIRQ( (IRQn_Type)psSsp_->u8PeripheralId );
+  
+} /* end SspStartTransfer() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: SspLoadDummies
+
+Description:
+Loads the next SSP_DUMMY_BLOCK_SIZE (or fewer) dummy bytes of a receive-only transfer in to the next PDC transmit
+registers so the PDC moves straight on to them, the same way UartChainTransmit() chains messages.  Called twice
+when the transfer starts and then from ENDTX each time the PDC moves on, until every dummy byte is loaded.
+The master clocks the slave's bytes in only as dummy bytes go out, so a late ENDTX only pauses the clock.
+
+Requires:
+  - psSsp_->u16DummyBytes != 0 is the number of dummy bytes not yet loaded in to the PDC
+  - US_TNCR is 0
+
+Promises:
+  - The next block is loaded in to US_TNPR/US_TNCR, or straight in to US_TPR/US_TCR if the PDC had stopped, and
+    u16DummyBytes is reduced by its size
+  - ENDTX is enabled while dummy bytes remain and disabled once all of them are loaded
+*/
+static void SspLoadDummies(SspPeripheralType* psSsp_)
+{
+  u16 u16Block = psSsp_->u16DummyBytes;
+  
+  if(u16Block > SSP_DUMMY_BLOCK_SIZE)
+  {
+    u16Block = SSP_DUMMY_BLOCK_SIZE;
+  }
+  
+  psSsp_->pBaseAddress->US_TNPR = (u32)&SSP_au8Dummies[0];
+  psSsp_->pBaseAddress->US_TNCR = u16Block;
+  psSsp_->u16DummyBytes -= u16Block;
+  
+  /* If the current block ran out just before TNCR was written (or nothing was loaded yet) the PDC has stopped, 
+  so load the block directly */
+  if( (psSsp_->pBaseAddress->US_TCR == 0) && (psSsp_->pBaseAddress->US_TNCR != 0) )
+  {
+    psSsp_->pBaseAddress->US_TPR  = psSsp_->pBaseAddress->US_TNPR;
+    psSsp_->pBaseAddress->US_TCR  = psSsp_->pBaseAddress->US_TNCR;
+    psSsp_->pBaseAddress->US_TNCR = 0;
+  }
+  
+  if(psSsp_->u16DummyBytes != 0)
+  {
+    psSsp_->pBaseAddress->US_IER = AT91C_US_ENDTX;
+  }
+  else
+  {
+    psSsp_->pBaseAddress->US_IDR = AT91C_US_ENDTX;
+  }
+  
+} /* end SspLoadDummies() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: SspBusStartNext
+
+Description:
+Offers the bus of psFinished_ to each device on it in turn, starting with the one after psFinished_ so the devices
+are served round robin.  Called from the SSP ISR when a Master transfer completes and when a device gives up CS.
+
+Requires:
+  - psFinished_ is a device on the bus that just became free
+
+Promises:
+  - The first device on the bus with work pending (see SspStartTransfer) is started; the bus stays idle if none
+*/
+static void SspBusStartNext(SspPeripheralType* psFinished_)
+{
+  u8 u8Index = 0;
+  SspPeripheralType* psDevice;
+  
+  while( (u8Index < SSP_DEVICES) && (SSP_apsDevices[u8Index] != psFinished_) )
+  {
+    u8Index++;
+  }
+  
+  for(u8 i = 1; i <= SSP_DEVICES; i++)
+  {
+    psDevice = SSP_apsDevices[(u8Index + i) % SSP_DEVICES];
+    if( (psDevice->u32PrivateFlags & _SSP_PERIPHERAL_ASSIGNED) &&
+        (psDevice->u8BusIndex == psFinished_->u8BusIndex) )
+    {
+      SspStartTransfer(psDevice);
+    }
+  }
+  
+} /* end SspBusStartNext() */
 
 
 /*----------------------------------------------------------------------------------------------------------------------
@@ -692,7 +1139,7 @@ Promises:
 void SSP0_IRQHandler(void)
 {
   /* Set the current ISR pointers to SSP0 targets */
-  SSP_psCurrentISR = &SSP_Peripheral0;                         /* Current SSP ISR */
+  SSP_psCurrentISR = SSP_asBuses[0].psActiveDevice;                         /* Current SSP ISR */
   SSP_pu32SspApplicationFlagsISR = &G_u32Ssp0ApplicationFlags; /* Current SSP application status flags */
   SSP_u32Int0Count++;
 
@@ -717,7 +1164,7 @@ Promises:
 void SSP1_IRQHandler(void)
 {
   /* Set the current ISR pointers to SSP1 targets */
-  SSP_psCurrentISR = &SSP_Peripheral1;                      /* Current SSP ISR */
+  SSP_psCurrentISR = SSP_asBuses[1].psActiveDevice;                      /* Current SSP ISR */
   SSP_pu32SspApplicationFlagsISR = &G_u32Ssp1ApplicationFlags; /* Current SSP application status flags */
   SSP_u32Int1Count++;
 
@@ -737,7 +1184,7 @@ Handles the enabled SSP2 interrupts.
 void SSP2_IRQHandler(void)
 {
   /* Set the current ISR pointers to SSP2 targets */
-  SSP_psCurrentISR = &SSP_Peripheral2;                      /* Current SSP ISR */
+  SSP_psCurrentISR = SSP_asBuses[2].psActiveDevice;                      /* Current SSP ISR */
   SSP_pu32SspApplicationFlagsISR = &G_u32Ssp2ApplicationFlags; /* Current SSP application status flags */
   SSP_u32Int2Count++;
 
@@ -756,6 +1203,8 @@ Handles the enabled interrupts for the current SSP.
 Chip select: only enabled for SLAVE peripherals.  A Slave peripheral needs this signal to know it is communicating.  
 If it is supposed to be transmitting and does not have any flow control, the data should already be ready.
 Transmit: An End Transmit interrupt will occur when the PDC has finished sending all of the bytes for Master or Slave.
+A Master then waits for the TXEMPTY interrupt to complete the message and release an automatic CS once the last
+byte has been shifted out.
 Receive: An End Receive interrupt will occur when the PDC has finished receiving all of the expected bytes for Master or a single byte for Slave.
 Receive RXBUFF: An Rx Buffer empty interrupt occurs on a Slave when both the current and next send counters are 0.
 
@@ -772,8 +1221,8 @@ Promises:
 void SspGenericHandler(void)
 {
   u32 u32Byte;
-  u32 u32Timeout;
   u32 u32Current_CSR;
+  bool bStartNext = FALSE;
   
   /* Get a copy of CSR because reading it changes it */
   u32Current_CSR = SSP_psCurrentISR->pBaseAddress->US_CSR;
@@ -802,9 +1251,30 @@ void SspGenericHandler(void)
     }
   } /* end CS change state interrupt */
 
-  /*** SSP ISR transmit handling for flow-control devices that do not use DMA ***/
-  if( (SSP_psCurrentISR->pBaseAddress->US_IMR & AT91C_US_TXEMPTY) && 
+  /*** TXEMPTY after a Master PDC transmit: the last byte has left the shift register ***/
+  if( (SSP_psCurrentISR->u32PrivateFlags & _SSP_PERIPHERAL_TX_DRAINING) &&
+      (SSP_psCurrentISR->pBaseAddress->US_IMR & AT91C_US_TXEMPTY) && 
       (u32Current_CSR & AT91C_US_TXEMPTY) )
+  {
+    SSP_psCurrentISR->pBaseAddress->US_IDR = AT91C_US_TXEMPTY;
+    SSP_psCurrentISR->u32PrivateFlags &= ~_SSP_PERIPHERAL_TX_DRAINING;
+    
+    /* Deassert chip select now that the buffer and shift register are totally empty */
+    if(SSP_psCurrentISR->eSspMode == SPI_MASTER_AUTO_CS)
+    {
+      SSP_psCurrentISR->pCsGpioAddress->PIO_SODR = SSP_psCurrentISR->u32CsPin;
+    }
+
+    /* Update this message token status and then DeQueue it */
+    UpdateMessageStatus(SSP_psCurrentISR->sTransmitQueue.psHead->u32Token, COMPLETE);
+    DeQueueMessage( &SSP_psCurrentISR->sTransmitQueue );
+    SSP_psCurrentISR->u32PrivateFlags &= ~_SSP_PERIPHERAL_TX;
+    bStartNext = TRUE;
+  } /* end TXEMPTY drain handling */
+
+  /*** SSP ISR transmit handling for flow-control devices that do not use DMA ***/
+  else if( (SSP_psCurrentISR->pBaseAddress->US_IMR & AT91C_US_TXEMPTY) && 
+           (u32Current_CSR & AT91C_US_TXEMPTY) )
   {
     /* Decrement counter and read the dummy byte so the SSP peripheral doesn't overrun */
     SSP_psCurrentISR->u32CurrentTxBytesRemaining--;
@@ -832,8 +1302,8 @@ void SspGenericHandler(void)
       
       /* Clean up the message status and flags */
       SSP_psCurrentISR->u32PrivateFlags &= ~_SSP_PERIPHERAL_TX;  
-      UpdateMessageStatus(SSP_psCurrentISR->psTransmitBuffer->u32Token, COMPLETE);
-      DeQueueMessage(&SSP_psCurrentISR->psTransmitBuffer);
+      UpdateMessageStatus(SSP_psCurrentISR->sTransmitQueue.psHead->u32Token, COMPLETE);
+      DeQueueMessage(&SSP_psCurrentISR->sTransmitQueue);
  
       /* Re-enable Rx interrupt and clean-up the operation */    
       SSP_psCurrentISR->pBaseAddress->US_IER = AT91C_US_RXRDY;
@@ -887,7 +1357,7 @@ void SspGenericHandler(void)
       SSP_u32RxCounter++;
       
       /* Deassert CS for SPI_MASTER_AUTO_CS transfers */
-      if(SSP_psCurrentSsp->eSspMode == SPI_MASTER_AUTO_CS)
+      if(SSP_psCurrentISR->eSspMode == SPI_MASTER_AUTO_CS)
       {
         SSP_psCurrentISR->pCsGpioAddress->PIO_SODR = SSP_psCurrentISR->u32CsPin;
       }
@@ -895,6 +1365,7 @@ void SspGenericHandler(void)
       /* Disable the receiver and transmitter */
       SSP_psCurrentISR->pBaseAddress->US_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
       SSP_psCurrentISR->pBaseAddress->US_IDR  = AT91C_US_ENDRX;
+      bStartNext = TRUE;
     }
     /* Otherwise the peripheral is a Slave that just received a byte */
     /* ENDRX Interrupt when a byte has been received (RNCR is moved to RCR; RNPR is copied to RPR))*/
@@ -916,38 +1387,43 @@ void SspGenericHandler(void)
   } /* end ENDRX handling */
 
 
-  /* ENDTX Interrupt when all requested transmit bytes have been sent (if enabled) */
-  if( (SSP_psCurrentISR->pBaseAddress->US_IMR & AT91C_US_ENDTX) && 
+  /* ENDTX Interrupt when the PDC has moved on to the next dummy block of a receive-only transfer */
+  if( (SSP_psCurrentISR->u32PrivateFlags & _SSP_PERIPHERAL_RX) &&
+      (SSP_psCurrentISR->pBaseAddress->US_IMR & AT91C_US_ENDTX) && 
       (u32Current_CSR & AT91C_US_ENDTX) )
   {
-    /* Update this message token status and then DeQueue it */
-    UpdateMessageStatus(SSP_psCurrentISR->psTransmitBuffer->u32Token, COMPLETE);
-    DeQueueMessage( &SSP_psCurrentISR->psTransmitBuffer );
-    SSP_psCurrentISR->u32PrivateFlags &= ~_SSP_PERIPHERAL_TX;
-        
+    SspLoadDummies(SSP_psCurrentISR);
+  }
+  
+  /* ENDTX Interrupt when all requested transmit bytes have been loaded by the PDC (if enabled) */
+  else if( (SSP_psCurrentISR->pBaseAddress->US_IMR & AT91C_US_ENDTX) && 
+           (u32Current_CSR & AT91C_US_ENDTX) )
+  {
     /* Disable the transmitter and interrupt source */
     SSP_psCurrentISR->pBaseAddress->US_PTCR = AT91C_PDC_TXTDIS;
     SSP_psCurrentISR->pBaseAddress->US_IDR  = AT91C_US_ENDTX;
 
-    /* Allow the peripheral to finish clocking out the Tx byte */
-    u32Timeout = 0;
-    while ( !(SSP_psCurrentISR->pBaseAddress->US_CSR & AT91C_US_TXEMPTY) && 
-            u32Timeout < SSP_TXEMPTY_TIMEOUT)
+    if( (SSP_psCurrentISR->eSspMode == SPI_MASTER_AUTO_CS)  ||
+        (SSP_psCurrentISR->eSspMode == SPI_MASTER_MANUAL_CS) ) 
     {
-      u32Timeout++;
-    } 
-    
-    if(SSP_psCurrentISR->eSspMode == SPI_MASTER_AUTO_CS)
+      /* The last byte is still in THR or the shift register: finish on TXEMPTY so CS is not released early */
+      SSP_psCurrentISR->u32PrivateFlags |= _SSP_PERIPHERAL_TX_DRAINING;
+      SSP_psCurrentISR->pBaseAddress->US_IER = AT91C_US_TXEMPTY;
+    }
+    else
     {
-      /* Deassert chip select when the buffer and shift register are totally empty */
-      if(SSP_psCurrentSsp->eSspMode == SPI_MASTER_AUTO_CS)
-      {
-        SSP_psCurrentISR->pCsGpioAddress->PIO_SODR = SSP_psCurrentISR->u32CsPin;
-      }
-      //SSP_psCurrentISR->pCsGpioAddress->PIO_SODR = SSP_psCurrentISR->u32CsPin;
+      /* A slave's last byte goes whenever the master clocks it, so the message is done now */
+      UpdateMessageStatus(SSP_psCurrentISR->sTransmitQueue.psHead->u32Token, COMPLETE);
+      DeQueueMessage( &SSP_psCurrentISR->sTransmitQueue );
+      SSP_psCurrentISR->u32PrivateFlags &= ~_SSP_PERIPHERAL_TX;
     }
   } /* end ENDTX interrupt handling */
 
+  /* Only now that every status bit of the finished transfer has been handled can the bus start the next one */
+  if(bStartNext)
+  {
+    SspBusStartNext(SSP_psCurrentISR);
+  }
   
 } /* end SspGenericHandler() */
 
@@ -957,126 +1433,23 @@ State Machine Function Definitions
 
 The SSP state machine monitors messaging activity on the available SSP Master peripherals.  It manages all SSP outgoing messages and will
 transmit any message that has been queued.  All configured SSP peripherals can be transmitting and receiving
-simultaneously.
+simultaneously, so every idle peripheral with work pending is started in the same pass.
 
 ***********************************************************************************************************************/
 
 /*-------------------------------------------------------------------------------------------------------------------*/
 /* Wait for a transmit message to be queued -- this can include a dummy transmission to receive bytes.
-Half duplex transmissions are always assumed. Check one peripheral per iteration. */
+Half duplex transmissions are always assumed. Check every peripheral each iteration; the API functions also start
+an idle peripheral as soon as work is queued so this pass mostly picks up work left behind a busy peripheral. */
 void SspSM_Idle(void)
 {
- static u8 au8SspErrorInvalidSsp[] = "Invalid SSP attempt\r\n";
- u32 u32Byte;
-  
-  /* Check all SPI/SSP peripherals for message activity or skip the current peripheral if it is already busy.
-  Slave devices receive outside of the state machine.
-  For Master devices sending a message, SSP_psCurrentSsp->psTransmitBuffer->pu8Message will point to the application transmit buffer.
-  For Master devices receiving a message, SSP_psCurrentSsp->u16RxBytes will != 0. Dummy bytes are sent.  */
-  if( ( (SSP_psCurrentSsp->psTransmitBuffer != NULL) || (SSP_psCurrentSsp->u16RxBytes !=0) ) && 
-     !(SSP_psCurrentSsp->u32PrivateFlags & (_SSP_PERIPHERAL_TX | _SSP_PERIPHERAL_RX)       ) 
-    )
+  /* Start every idle SPI/SSP peripheral that has work pending in this pass; each has its own PDC channel
+  and SspStartTransfer() lets only one device per peripheral go.  Slave devices receive outside of the state machine. */
+  for(u8 i = 0; i < SSP_DEVICES; i++)
   {
-    /* For an SPI_MASTER_AUTO_CS device, start by asserting chip select 
-   (SPI_MASTER_MANUAL_CS devices should already have asserted CS in the user's task) */
-    if(SSP_psCurrentSsp->eSspMode == SPI_MASTER_AUTO_CS)
-    {
-      SSP_psCurrentSsp->pCsGpioAddress->PIO_CODR = SSP_psCurrentSsp->u32CsPin;
-    }
-       
-    /* Check if the message is receiving based on expected byte count */
-    if(SSP_psCurrentSsp->u16RxBytes !=0)
-    {
-      /* Receiving: flag that the peripheral is now busy */
-      SSP_psCurrentSsp->u32PrivateFlags |= _SSP_PERIPHERAL_RX;    
-      
-      /* Clear the receive buffer so we can see (most) data changes but also so we send
-      predictable dummy bytes since we'll point to this buffer to source the transmit dummies */
-      memset(SSP_psCurrentSsp->pu8RxBuffer, SSP_DUMMY_BYTE, SSP_psCurrentSsp->u16RxBufferSize);
-
-      /* Load the PDC counter and pointer registers */
-      SSP_psCurrentSsp->pBaseAddress->US_RPR = (unsigned int)SSP_psCurrentSsp->pu8RxBuffer; 
-      SSP_psCurrentSsp->pBaseAddress->US_TPR = (unsigned int)SSP_psCurrentSsp->pu8RxBuffer; 
-      SSP_psCurrentSsp->pBaseAddress->US_RCR = SSP_psCurrentSsp->u16RxBytes;
-      SSP_psCurrentSsp->pBaseAddress->US_TCR = SSP_psCurrentSsp->u16RxBytes;
-
-      /* When RCR is loaded, the ENDRX flag is cleared so it is safe to enable the interrupt */
-      SSP_psCurrentSsp->pBaseAddress->US_IER = AT91C_US_ENDRX;
-      
-      /* Enable the receiver and transmitter to start the transfer */
-      SSP_psCurrentSsp->pBaseAddress->US_PTCR = AT91C_PDC_RXTEN | AT91C_PDC_TXTEN;
-    } /* End of receive function */
-    else
-    {
-      /* Transmitting: update the message's status and flag that the peripheral is now busy */
-      UpdateMessageStatus(SSP_psCurrentSsp->psTransmitBuffer->u32Token, SENDING);
-      SSP_psCurrentSsp->u32PrivateFlags |= _SSP_PERIPHERAL_TX;    
-      
-      /* TRANSMIT SPI_SPI_SLAVE_FLOW_CONTROL */
-      /* A Slave device with flow control uses interrupt-driven single byte transfers */
-      if(SSP_psCurrentSsp->eSspMode == SPI_SLAVE_FLOW_CONTROL)
-      {
-        /* At this point, CS is asserted and the master is waiting for flow control.
-        Load in the message parameters. */
-        SSP_psCurrentSsp->u32CurrentTxBytesRemaining = SSP_psCurrentSsp->psTransmitBuffer->u32Size;
-        SSP_psCurrentSsp->pu8CurrentTxData = SSP_psCurrentSsp->psTransmitBuffer->pu8Message;
-
-        /* If we need LSB first, use inline assembly to flip bits with a single instruction. */
-        u32Byte = 0x000000FF & *SSP_psCurrentSsp->pu8CurrentTxData;
-        if(SSP_psCurrentSsp->eBitOrder == LSB_FIRST)
-        {
-          u32Byte = __RBIT(u32Byte)>>24;
-        }
-        
-        /* Reset the transmitter since we have not been managing dummy bytes and it tends to be
-        in the middle of a transmission or something that causes the wrong byte to get sent (at least on startup). */
-        SSP_psCurrentSsp->pBaseAddress->US_CR = (AT91C_US_RSTTX);
-        SSP_psCurrentSsp->pBaseAddress->US_CR = (AT91C_US_TXEN);
-        SSP_psCurrentSsp->pBaseAddress->US_THR = (u8)u32Byte;
-        SSP_psCurrentSsp->pBaseAddress->US_IDR = AT91C_US_RXRDY;
-        SSP_psCurrentSsp->pBaseAddress->US_IER = AT91C_US_TXEMPTY;
-        SSP_psCurrentSsp->fnSlaveTxFlowCallback();
-      }
-      
-      /* TRANSMIT SPI_MASTER_AUTO_CS, SPI_MASTER_MANUAL_CS, SPI_SLAVE NO FLOW CONTROL */
-      /* A Master or Slave device without flow control uses the PDC */
-      else
-      {
-        /* Load the PDC counter and pointer registers */
-        SSP_psCurrentSsp->pBaseAddress->US_TPR = (unsigned int)SSP_psCurrentSsp->psTransmitBuffer->pu8Message; 
-        SSP_psCurrentSsp->pBaseAddress->US_TCR = SSP_psCurrentSsp->psTransmitBuffer->u32Size;
-   
-        /* When TCR is loaded, the ENDTX flag is cleared so it is safe to enable the interrupt */
-        SSP_psCurrentSsp->pBaseAddress->US_IER = AT91C_US_ENDTX;
-        
-        /* Enable the transmitter to start the transfer */
-        SSP_psCurrentSsp->pBaseAddress->US_PTCR = AT91C_PDC_TXTEN;
-      }
-    } /* End of transmitting function */
+    SspStartTransfer(SSP_apsDevices[i]);
   }
   
-  /* Adjust to check the next peripheral next time through */
-  switch (SSP_psCurrentSsp->u8PeripheralId)
-  {
-    case AT91C_ID_US0:
-      SSP_psCurrentSsp = &SSP_Peripheral1;
-      break;
-
-    case AT91C_ID_US1:
-      SSP_psCurrentSsp = &SSP_Peripheral2;
-      break;
-
-    case AT91C_ID_US2:
-      SSP_psCurrentSsp = &SSP_Peripheral0;
-      SSP_u32Flags &= ~_SSP_MANUAL_MODE;
-      break;
-
-    default:
-      DebugPrintf(au8SspErrorInvalidSsp);
-      SSP_psCurrentSsp = &SSP_Peripheral0;
-      break;
-  } /* end switch */
-  
 } /* end SspSM_Idle() */
 
 
@@ -30,6 +30,10 @@ typedef struct
   u8* pu8RxBufferAddress;             /* Address to circular receive buffer */
   u8** ppu8RxNextByte;                /* Location of pointer to next byte to write in buffer for SPI_SLAVE_FLOW_CONTROL only */
   u16 u16RxBufferSize;                /* Size of receive buffer in bytes */
+  MessagePriorityType eTxPriority;    /* Priority class of the transmit queue (0 is MSG_PRIORITY_NORMAL) */
+  u32 u32TxByteQuota;                 /* Max message arena bytes the transmit queue may hold; 0 for no quota */
+  u32 u32ModeRegister;                /* US_MR for this device (clock polarity/phase); 0 for the configuration.h value */
+  u32 u32BaudRateRegister;            /* US_BRGR for this device (SPI clock); 0 for the configuration.h value */
 } SspConfigurationType;
 
 typedef struct 
@@ -47,19 +51,37 @@ typedef struct
   u8** ppu8RxNextByte;                /* Pointer to buffer location where next received byte will be placed (SPI_SLAVE_FLOW_CONTROL only) */
   u16 u16RxBufferSize;                /* Size of receive buffer in bytes */
   u16 u16RxBytes;                     /* Number of bytes to receive (DMA transfers) */
+  u16 u16DummyBytes;                  /* Receive-only transfer: dummy bytes not yet loaded in to the PDC */
   u8 u8PeripheralId;                  /* Simple peripheral ID number */
 //  u8 u8Pad;                           /* Preserve 4-byte alignment */
-  MessageType* psTransmitBuffer;      /* Pointer to the transmit message struct linked list */
+  MessageQueueType sTransmitQueue;    /* Transmit message queue */
 //  MessageType* psReceiveBuffer;       /* Pointer to the transmit message struct linked list */
   u32 u32CurrentTxBytesRemaining;     /* Counter for bytes remaining in current transfer */
   u8* pu8CurrentTxData;               /* Pointer to current location in the Tx buffer */
+  u8* pu8TransferTxData;              /* Master transfer: PDC transmit source; NULL if receive only (dummy bytes are sent) */
+  u8* pu8TransferRxData;              /* Master receive/transfer: PDC receive destination */
+  u32 u32ControlRegister;             /* US_CR value that enables the peripheral for this device */
+  u32 u32ModeRegister;                /* US_MR value for this device */
+  u32 u32BaudRateRegister;            /* US_BRGR value for this device */
+  u8 u8BusIndex;                      /* Index of the USART (bus) in SSP_apsPeripherals this device is on */
 } SspPeripheralType;
 
+/* One per USART: arbitrates the Master devices that share it */
+typedef struct 
+{
+  SspPeripheralType* psActiveDevice;  /* Device whose transfer owns the registers and interrupts (last one started) */
+  SspPeripheralType* psConfiguredDevice; /* Device whose US_MR/US_BRGR are loaded; NULL forces a reload */
+  SspPeripheralType* psCsOwner;       /* SPI_MASTER_MANUAL_CS device holding CS across transfers; NULL if none */
+  u8 u8Devices;                       /* Number of devices requested on the bus */
+} SspBusType;
+
 /* u32PrivateFlags */
 #define _SSP_PERIPHERAL_ASSIGNED      (u32)0x00100000    /* Set when the peripheral is in use */
 #define _SSP_PERIPHERAL_TX            (u32)0x00200000    /* Set when the peripheral is transmitting */
 #define _SSP_PERIPHERAL_RX            (u32)0x00400000    /* Set when the peripheral is receiving */
 #define _SSP_PERIPHERAL_RX_COMPLETE   (u32)0x00800000    /* Set when the peripheral is finished receiving */
+#define _SSP_PERIPHERAL_TX_DRAINING   (u32)0x01000000    /* Set from ENDTX until TXEMPTY on a Master (last byte shifting out) */
+#define _SSP_PERIPHERAL_CS_HELD       (u32)0x08000000    /* Set from SspAssertCS() until SspDeAssertCS() */
 
 
 /**********************************************************************************************************************
@@ -73,16 +95,17 @@ Constants / Definitions
 /* end G_u32SspxApplicationFlags */
 
 /* SSP_u32Flags (local SSP application flags) */
-#define _SSP_MANUAL_MODE              (u32)0x00000001   /* Set to push a cycle during initialization mode */
-
 #define _SSP_ERROR_INVALID_SSP        (u32)0x01000000   /* Set if a function case switches to default */
 
 #define SSP_ERROR_FLAG_MASK           (u32)0xFF000000   /* AND to SSP_u32Flags to get just error flags */
 /* end of SSP_u32Flags flags */
 
 #define SSP_DUMMY_BYTE                (u8)0x00          /* Byte to send for dummy */
+#define SSP_DUMMY_BLOCK_SIZE          (u16)32           /* Dummy bytes the PDC sends per reload during a receive-only transfer */
 
-#define SSP_TXEMPTY_TIMEOUT           (u32)100           /* Instruction cycles of a while loop that waits for a register to clear */
+#define SSP_PERIPHERALS               (u8)3             /* USART0-2 */
+#define SSP_SHARED_DEVICES            (u8)2             /* Extra device objects for Masters that share a USART */
+#define SSP_DEVICES                   (u8)(SSP_PERIPHERALS + SSP_SHARED_DEVICES)
 
 
 /**********************************************************************************************************************
@@ -100,10 +123,13 @@ void SspDeAssertCS(SspPeripheralType* psSspPeripheral_);
 
 u32 SspWriteByte(SspPeripheralType* psSspPeripheral_, u8 u8Byte_);
 u32 SspWriteData(SspPeripheralType* psSspPeripheral_, u32 u32Size_, u8* u8Data_);
+u32 SspWriteDataReference(SspPeripheralType* psSspPeripheral_, u32 u32Size_, u8* pu8Data_);
 
 bool SspReadData(SspPeripheralType* psSspPeripheral_, u16 u16Size_);
 bool SspReadByte(SspPeripheralType* psSspPeripheral_);
+bool SspTransfer(SspPeripheralType* psSspPeripheral_, u8* pu8TxData_, u8* pu8RxData_, u16 u16Size_);
 SspRxStatusType SspQueryReceiveStatus(SspPeripheralType* psSspPeripheral_);
+u32 SspTxQueueCount(SspPeripheralType* psSspPeripheral_);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -112,8 +138,6 @@ SspRxStatusType SspQueryReceiveStatus(SspPeripheralType* psSspPeripheral_);
 void SspInitialize(void);
 void SspRunActiveState(void);
 
-void SspManualMode(void);
-
 
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Private functions */
@@ -122,6 +146,9 @@ void SSP0_IRQHandler(void);
 void SSP1_IRQHandler(void);
 void SSP2_IRQHandler(void);
 void SspGenericHandler(void);
+static void SspStartTransfer(SspPeripheralType* psSsp_);
+static void SspBusStartNext(SspPeripheralType* psFinished_);
+static void SspLoadDummies(SspPeripheralType* psSsp_);
 
 
 /***********************************************************************************************************************
@@ -41,9 +41,38 @@ u32CurrentMessageToken = UartWriteData(&MyTaskUart, strlen(au8Sting), au8Sting);
 All receive functionality is automatic. Incoming bytes are deposited to the 
 buffer specified in psUartConfig_
 
-Both Tx and Rx use the peripheral DMA controller, though received bytes
-are always received one at a time to allow use of a circular buffer by the
-client task.
+bool UartSetBaudRate(UartPeripheralType* psUartPeripheral_, u32 u32BaudRate_);
+Changes the baud rate of the peripheral once it has finished sending.  Returns FALSE if it is busy (try again)
+or the rate cannot be generated accurately.  Set bHardwareFlowControl in the configuration to use RTS/CTS on a 
+USART so high rates do not overrun the receiver.
+e.g. if( UartSetBaudRate(MyTaskUart, 921600) ) ...
+
+u16 UartRxByteCount(UartPeripheralType* psUartPeripheral_);
+Returns the number of received bytes that have not been read with the functions below.
+
+u16 UartPeekContiguous(UartPeripheralType* psUartPeripheral_, u8** ppu8Data_);
+Points *ppu8Data_ at the oldest unread byte and returns how many unread bytes follow it before the end of the 
+receive buffer.  Nothing is consumed, so the span can be scanned in place (e.g. with memchr) and then released
+with UartSkipBytes().  If the unread bytes wrap, a second call after UartSkipBytes() returns the rest.
+e.g.
+u8* pu8Span;
+u16 u16Length = UartPeekContiguous(MyTaskUart, &pu8Span);
+u8* pu8Return = memchr(pu8Span, '\r', u16Length);
+
+void UartSkipBytes(UartPeripheralType* psUartPeripheral_, u16 u16Count_);
+Consumes u16Count_ unread bytes (limited to the number available).
+
+u16 UartReadBytes(UartPeripheralType* psUartPeripheral_, u8* pu8Destination_, u16 u16MaxSize_);
+Copies up to u16MaxSize_ unread bytes (both spans if the data wraps) to pu8Destination_, consumes them and 
+returns the number copied.
+e.g. u16Count = UartReadBytes(MyTaskUart, au8Line, sizeof(au8Line));
+
+Both Tx and Rx use the peripheral DMA controller.  By default received bytes
+are received one at a time to allow use of a circular buffer by the
+client task.  A USART requested with eRxMode = UART_RX_BLOCK instead has the PDC fill
+each half of the circular buffer in one transfer and uses the receiver time-out to
+flush partial blocks when the line goes idle; fnRxCallback is still called once for every
+byte so the client sees the same circular buffer behaviour with far fewer interrupts.
 
 INITIALIZATION (should take place in application's initialization function):
 1. Create a variable of UartConfigurationType in your application and initialize it to the desired UART peripheral,
@@ -58,13 +87,14 @@ accessible to your application.
 DATA TRANSFER:
 1. Received bytes on the allocated peripheral will be dropped into the application's designated receive
 buffer.  The buffer is written circularly, with no provision to monitor bytes that are overwritten.  The 
-application is responsible for processing all received data.  The application must provide its own parsing
-pointer to read the receive buffer and properly wrap around.  This pointer will not be impacted by the interrupt
-service routine that may add additional characters at any time.
+application is responsible for processing all received data.  The application either provides its own parsing
+pointer to read the receive buffer and properly wrap around, or uses the UartRxByteCount(), UartPeekContiguous(),
+UartSkipBytes() and UartReadBytes() functions which keep a read pointer in the peripheral object.  Neither is
+impacted by the interrupt service routine that may add additional characters at any time.
 
 2. Transmitted data is queued using one of two functions, UartWriteByte() and UartWriteData().  Once the data
-is queued, it is sent as soon as possible.  Each UART resource has a transmit queue, but only one UART resource
-will send data at any given time from this state machine.  However, all UART resources may receive data simultaneously
+is queued, it is sent as soon as possible.  Each UART resource has a transmit queue and its own PDC channel, so all
+UART resources may send data at the same time.  All UART resources may also receive data simultaneously
 through their respective interrupt handlers based on interrupt priority.
 
 **********************************************************************************************************************/
@@ -100,13 +130,15 @@ static fnCode_type Uart_pfnStateMachine;        /* The UART application state ma
 
 static u32 UART_u32Timer;                       /* Counter used across states */
 static u32 UART_u32Flags;                       /* Application flags for UART */
-static u8 UART_u8ActiveUarts = 0;               /* Counting semaphore for # of active UARTs */
 
 static UartPeripheralType UART_Peripheral;      /* UART peripheral object */
 static UartPeripheralType UART_Peripheral0;     /* USART0 peripheral object (used as UART) */
 static UartPeripheralType UART_Peripheral1;     /* USART1 peripheral object (used as UART) */
 static UartPeripheralType UART_Peripheral2;     /* USART2 peripheral object (used as UART) */
 
+static UartPeripheralType* const UART_apsPeripherals[UART_PERIPHERALS] = 
+{&UART_Peripheral, &UART_Peripheral0, &UART_Peripheral1, &UART_Peripheral2}; /* All peripherals in service order */
+
 static UartPeripheralType* UART_psCurrentUart;   /* Current UART peripheral being processed */
 static UartPeripheralType* UART_psCurrentISR;    /* Current UART peripheral being processed in ISR */
 static u32* UART_pu32ApplicationFlagsISR;        /* Current UART application status flags in ISR */
@@ -246,8 +278,12 @@ Requires:
   - UART_Peripheralx perihperal objects have been initialized
   - USART Peripheralx registers are not write-protected (WPEN)
   - UART peripheral register initialization values in configuration.h must be set correctly
-  - psUartConfig_ has the UART peripheral number, address of the RxBuffer, and the RxBuffer size and the calling
-    application is ready to start using the peripheral.
+  - psUartConfig_ has the UART peripheral number, address of the RxBuffer, the RxBuffer size, the transmit
+    priority class and byte quota and the receive mode, and the calling application is ready to start using the peripheral.
+  - If bHardwareFlowControl is TRUE the peripheral's RTS and CTS pins are assigned to it in the board GPIO setup;
+    the option is ignored for the DBGU (UART) which has no handshaking
+  - UART_RX_BLOCK is only honoured on the USARTs with a receive buffer of at least UART_RX_BLOCK_MIN_BUFFER bytes;
+    otherwise the peripheral receives one byte per interrupt.  Either way fnRxCallback is called once per byte.
   - UART/USART peripheral registers configured here are available and at the same address offset regardless of the peripheral. 
 
 Promises:
@@ -260,6 +296,7 @@ UartPeripheralType* UartRequest(UartConfigurationType* psUartConfig_)
 {
   UartPeripheralType* psRequestedUart;
   u32 u32TargetCR, u32TargetMR, u32TargetIER, u32TargetIDR, u32TargetBRGR;
+  u16 u16RxBlockSize;
   
   switch(psUartConfig_->UartPeripheral)
   {
@@ -324,6 +361,13 @@ UartPeripheralType* UartRequest(UartConfigurationType* psUartConfig_)
     return(NULL);
   }
   
+  /* RTS/CTS handshaking is a USART mode (the DBGU does not have it).  The receiver raises RTS when both receive
+  PDC counters reach 0 so the sender pauses instead of overrunning the client buffer. */
+  if( psUartConfig_->bHardwareFlowControl && (psUartConfig_->UartPeripheral != UART) )
+  {
+    u32TargetMR = (u32TargetMR & ~AT91C_US_USMODE) | AT91C_US_USMODE_HWHSH;
+  }
+  
   /* Activate and configure the peripheral */
   AT91C_BASE_PMC->PMC_PCER |= (1 << psRequestedUart->u8PeripheralId);
 
@@ -331,7 +375,9 @@ UartPeripheralType* UartRequest(UartConfigurationType* psUartConfig_)
   psRequestedUart->u16RxBufferSize = psUartConfig_->u16RxBufferSize;
   psRequestedUart->pu8RxNextByte   = psUartConfig_->pu8RxNextByte;
   psRequestedUart->fnRxCallback    = psUartConfig_->fnRxCallback;
+  psRequestedUart->pu8RxReadByte   = psUartConfig_->pu8RxBufferAddress;
   psRequestedUart->u32PrivateFlags |= _UART_PERIPHERAL_ASSIGNED;
+  SetMessageQueuePriority(&psRequestedUart->sTransmitQueue, psUartConfig_->eTxPriority, psUartConfig_->u32TxByteQuota);
   
   psRequestedUart->pBaseAddress->US_CR   = u32TargetCR;
   psRequestedUart->pBaseAddress->US_MR   = u32TargetMR;
@@ -339,11 +385,33 @@ UartPeripheralType* UartRequest(UartConfigurationType* psUartConfig_)
   psRequestedUart->pBaseAddress->US_IDR  = u32TargetIDR;
   psRequestedUart->pBaseAddress->US_BRGR = u32TargetBRGR;
 
-  /* Preset the receive PDC pointers and counters; the receive buffer must be starting from [0] and be at least 2 bytes long)*/
-  psRequestedUart->pBaseAddress->US_RPR  = (unsigned int)psUartConfig_->pu8RxBufferAddress;
-  psRequestedUart->pBaseAddress->US_RNPR = (unsigned int)((psUartConfig_->pu8RxBufferAddress) + 1);
-  psRequestedUart->pBaseAddress->US_RCR  = 1;
-  psRequestedUart->pBaseAddress->US_RNCR = 1;
+  /* Block receive needs the USART receiver time-out which the DBGU does not have, and two useful halves of buffer */
+  if( (psUartConfig_->eRxMode == UART_RX_BLOCK) && (psUartConfig_->UartPeripheral != UART) &&
+      (psUartConfig_->u16RxBufferSize >= UART_RX_BLOCK_MIN_BUFFER) )
+  {
+    /* The PDC fills the two halves of the circular buffer back to back; ENDRX reloads the half that just finished */
+    u16RxBlockSize = psUartConfig_->u16RxBufferSize / 2;
+    psRequestedUart->u32PrivateFlags  |= _UART_PERIPHERAL_RX_BLOCK;
+    psRequestedUart->pu8RxReportedByte = psUartConfig_->pu8RxBufferAddress;
+    
+    psRequestedUart->pBaseAddress->US_RPR  = (unsigned int)psUartConfig_->pu8RxBufferAddress;
+    psRequestedUart->pBaseAddress->US_RNPR = (unsigned int)(psUartConfig_->pu8RxBufferAddress + u16RxBlockSize);
+    psRequestedUart->pBaseAddress->US_RCR  = u16RxBlockSize;
+    psRequestedUart->pBaseAddress->US_RNCR = psUartConfig_->u16RxBufferSize - u16RxBlockSize;
+
+    /* Bytes that do not fill a block are flushed once the line has been idle; STTTO holds the counter until the next byte */
+    psRequestedUart->pBaseAddress->US_RTOR = UART_RX_TIMEOUT_BITS;
+    psRequestedUart->pBaseAddress->US_CR   = AT91C_US_STTTO;
+    psRequestedUart->pBaseAddress->US_IER  = AT91C_US_ENDRX | AT91C_US_TIMEOUT;
+  }
+  else
+  {
+    /* Preset the receive PDC pointers and counters; the receive buffer must be starting from [0] and be at least 2 bytes long)*/
+    psRequestedUart->pBaseAddress->US_RPR  = (unsigned int)psUartConfig_->pu8RxBufferAddress;
+    psRequestedUart->pBaseAddress->US_RNPR = (unsigned int)((psUartConfig_->pu8RxBufferAddress) + 1);
+    psRequestedUart->pBaseAddress->US_RCR  = 1;
+    psRequestedUart->pBaseAddress->US_RNCR = 1;
+  }
   
   /* Enable the receiver and transmitter requests */
   psRequestedUart->pBaseAddress->US_PTCR = AT91C_PDC_RXTEN | AT91C_PDC_TXTEN;
@@ -383,19 +451,35 @@ void UartRelease(UartPeripheralType* psUartPeripheral_)
   /* First disable the interrupts */
   NVIC_DisableIRQ( (IRQn_Type)(psUartPeripheral_->u8PeripheralId) );
   NVIC_ClearPendingIRQ( (IRQn_Type)(psUartPeripheral_->u8PeripheralId) );
+  
+  /* Stop any transmit in progress since its messages are abandoned below */
+  psUartPeripheral_->pBaseAddress->US_PTCR = AT91C_PDC_TXTDIS;
+  psUartPeripheral_->pBaseAddress->US_IDR  = AT91C_US_ENDTX | AT91C_US_TXBUFE;
+  psUartPeripheral_->pBaseAddress->US_TNCR = 0;
+  psUartPeripheral_->pBaseAddress->US_TCR  = 0;
+ 
+  /* Stop the receiver time-out used by block receive */
+  if(psUartPeripheral_->u32PrivateFlags & _UART_PERIPHERAL_RX_BLOCK)
+  {
+    psUartPeripheral_->pBaseAddress->US_IDR  = AT91C_US_TIMEOUT;
+    psUartPeripheral_->pBaseAddress->US_RTOR = 0;
+  }
  
   /* Now it's safe to release all of the resources in the target peripheral */
   psUartPeripheral_->pu8RxBuffer    = NULL;
   psUartPeripheral_->pu8RxNextByte  = NULL;
+  psUartPeripheral_->pu8RxReportedByte = NULL;
+  psUartPeripheral_->pu8RxReadByte  = NULL;
   psUartPeripheral_->fnRxCallback   = NULL;
   psUartPeripheral_->u32PrivateFlags = 0;
 
   /* Empty the transmit buffer if there were leftover messages */
-  while(psUartPeripheral_->psTransmitBuffer != NULL)
+  while(psUartPeripheral_->sTransmitQueue.psHead != NULL)
   {
-    UpdateMessageStatus(psUartPeripheral_->psTransmitBuffer->u32Token, ABANDONED);
-    DeQueueMessage(&psUartPeripheral_->psTransmitBuffer);
+    UpdateMessageStatus(psUartPeripheral_->sTransmitQueue.psHead->u32Token, ABANDONED);
+    DeQueueMessage(&psUartPeripheral_->sTransmitQueue);
   }
+  SetMessageQueuePriority(&psUartPeripheral_->sTransmitQueue, MSG_PRIORITY_NORMAL, 0);
   
   /* Ensure the SM is in the Idle state */
   Uart_pfnStateMachine = UartSM_Idle;
@@ -413,7 +497,7 @@ Requires:
   - psUartPeripheral_ has been requested.
 
 Promises:
-  - Creates a 1-byte message at psUartPeripheral_->pTransmitBuffer that will be sent by the UART application
+  - Creates a 1-byte message in psUartPeripheral_->sTransmitQueue that will be sent by the UART application
     when it is available.
   - Returns the message token assigned to the message
 */
@@ -422,16 +506,7 @@ u32 UartWriteByte(UartPeripheralType* psUartPeripheral_, u8 u8Byte_)
   u32 u32Token;
   u8 u8Data = u8Byte_;
   
-  u32Token = QueueMessage(&psUartPeripheral_->psTransmitBuffer, 1, &u8Data);
-  if( u32Token != 0 )
-  {
-    /* If the system is initializing, we want to manually cycle the UART task through one iteration
-    to send the message */
-    if(G_u32SystemFlags & _SYSTEM_INITIALIZING)
-    {
-      UartManualMode();
-    }
-  }
+  u32Token = QueueMessage(&psUartPeripheral_->sTransmitQueue, 1, &u8Data);
   
   return(u32Token);
   
@@ -451,7 +526,7 @@ Requires:
   - u8Data_ points to the first byte of the data array
 
 Promises:
-  - adds the data message at psUartPeripheral_->pTransmitBuffer that will be sent by the UART application
+  - adds the data message in psUartPeripheral_->sTransmitQueue that will be sent by the UART application
     when it is available.
   - Returns the message token assigned to the message; 0 is returned if the message cannot be queued in which case
     G_u32MessagingFlags can be checked for the reason
@@ -460,19 +535,237 @@ u32 UartWriteData(UartPeripheralType* psUartPeripheral_, u32 u32Size_, u8* u8Dat
 {
   u32 u32Token;
 
-  u32Token = QueueMessage(&psUartPeripheral_->psTransmitBuffer, u32Size_, u8Data_);
-  if(u32Token)
+  u32Token = QueueMessage(&psUartPeripheral_->sTransmitQueue, u32Size_, u8Data_);
+  
+  return(u32Token);
+  
+} /* end UartWriteData() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartWriteDataReference
+
+Description:
+Queues a data array for transfer on the target UART peripheral without copying it.  The PDC sends
+directly from u8Data_ (see QueueMessageReference for the ownership rules).
+
+Requires:
+  - psUartPeripheral_ has been requested
+  - u32Size_ is the number of bytes in the data array
+  - u8Data_ points to the first byte of the data array which must not change until the status of the 
+    returned token is COMPLETE, TIMEOUT or ABANDONED
+
+Promises:
+  - adds a message referencing u8Data_ in psUartPeripheral_->sTransmitQueue that will be sent by the UART application
+    when it is available.
+  - Returns the message token assigned to the message; 0 is returned if the message cannot be queued
+*/
+u32 UartWriteDataReference(UartPeripheralType* psUartPeripheral_, u32 u32Size_, u8* u8Data_)
+{
+  u32 u32Token;
+
+  u32Token = QueueMessageReference(&psUartPeripheral_->sTransmitQueue, u32Size_, u8Data_);
+  
+  return(u32Token);
+  
+} /* end UartWriteDataReference() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartSetBaudRate
+
+Description:
+Changes the baud rate of a requested UART peripheral at run time, e.g. to move a long telemetry dump to 921600 baud.
+The divider is worked out from the master clock with 16x oversampling:  BAUD = MCK / (16 * (CD + FP / 8)).
+The USARTs use the fractional part (FP); the DBGU only has CD.
+
+Requires:
+  - psUartPeripheral_ has been requested
+  - The device on the other end changes its rate to match; bytes received across the change may be corrupted
+
+Promises:
+  - Returns FALSE and leaves the rate unchanged if a message is sending or the last character has not left the 
+    transmitter (try again later), or if the rate cannot be made within UART_BAUD_MAX_ERROR_PERCENT
+  - Otherwise US_BRGR is updated and returns TRUE
+*/
+bool UartSetBaudRate(UartPeripheralType* psUartPeripheral_, u32 u32BaudRate_)
+{
+  u32 u32Eighths;
+  u32 u32ActualBaud;
+  u32 u32Error;
+  
+  if(u32BaudRate_ == 0)
+  {
+    return(FALSE);
+  }
+  
+  /* Do not change the rate under a character that is still going out.  Only the state machine starts a transmit
+  on an idle peripheral, so it stays idle for the rest of this function. */
+  if( (psUartPeripheral_->u32PrivateFlags & _UART_PERIPHERAL_TX) ||
+     !(psUartPeripheral_->pBaseAddress->US_CSR & AT91C_US_TXEMPTY) )
+  {
+    return(FALSE);
+  }
+  
+  /* The divider in eighths is MCK / (2 * BAUD); add half of the divisor to round to the nearest */
+  u32Eighths = (UART_MCK + u32BaudRate_) / (2 * u32BaudRate_);
+  if(psUartPeripheral_->u8PeripheralId == AT91C_ID_DBGU)
+  {
+    u32Eighths = (u32Eighths + 4) & ~(u32)0x07;
+  }
+  
+  if( (u32Eighths < 8) || ( (u32Eighths >> 3) > 0xFFFF) )
+  {
+    return(FALSE);
+  }
+  
+  /* Reject rates the divider cannot get close enough to */
+  u32ActualBaud = UART_MCK / (2 * u32Eighths);
+  u32Error = (u32ActualBaud > u32BaudRate_) ? (u32ActualBaud - u32BaudRate_) : (u32BaudRate_ - u32ActualBaud);
+  if( (u32Error * 100) > (u32BaudRate_ * UART_BAUD_MAX_ERROR_PERCENT) )
+  {
+    return(FALSE);
+  }
+  
+  psUartPeripheral_->pBaseAddress->US_BRGR = ( (u32Eighths & 0x07) << 16) | (u32Eighths >> 3);
+  return(TRUE);
+  
+} /* end UartSetBaudRate() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartRxByteCount
+
+Description:
+Counts the received bytes that have not yet been read with UartPeekContiguous()/UartSkipBytes()/UartReadBytes().
+
+Requires:
+  - psUartPeripheral_ has been requested and its fnRxCallback advances the pointer at pu8RxNextByte
+
+Promises:
+  - Returns the number of unread bytes in the receive buffer
+*/
+u16 UartRxByteCount(UartPeripheralType* psUartPeripheral_)
+{
+  u8* pu8WriteByte = *psUartPeripheral_->pu8RxNextByte;
+  
+  if(pu8WriteByte >= psUartPeripheral_->pu8RxReadByte)
+  {
+    return( (u16)(pu8WriteByte - psUartPeripheral_->pu8RxReadByte) );
+  }
+  
+  return( (u16)(psUartPeripheral_->u16RxBufferSize - (psUartPeripheral_->pu8RxReadByte - pu8WriteByte)) );
+  
+} /* end UartRxByteCount() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartPeekContiguous
+
+Description:
+Returns the oldest run of unread bytes that is contiguous in memory without consuming it.
+
+Requires:
+  - psUartPeripheral_ has been requested and its fnRxCallback advances the pointer at pu8RxNextByte
+  - ppu8Data_ points to where the start of the span is returned
+
+Promises:
+  - *ppu8Data_ points to the oldest unread byte
+  - Returns the number of unread bytes from *ppu8Data_ up to the newest byte or the end of the receive buffer,
+    whichever is first; 0 if there are none
+*/
+u16 UartPeekContiguous(UartPeripheralType* psUartPeripheral_, u8** ppu8Data_)
+{
+  u8* pu8WriteByte = *psUartPeripheral_->pu8RxNextByte;
+  
+  *ppu8Data_ = psUartPeripheral_->pu8RxReadByte;
+  if(pu8WriteByte >= psUartPeripheral_->pu8RxReadByte)
+  {
+    return( (u16)(pu8WriteByte - psUartPeripheral_->pu8RxReadByte) );
+  }
+  
+  /* The unread bytes wrap, so this span stops at the end of the buffer */
+  return( (u16)(psUartPeripheral_->pu8RxBuffer + psUartPeripheral_->u16RxBufferSize - psUartPeripheral_->pu8RxReadByte) );
+  
+} /* end UartPeekContiguous() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartSkipBytes
+
+Description:
+Consumes unread bytes, usually after they were processed in place with UartPeekContiguous().
+
+Requires:
+  - psUartPeripheral_ has been requested
+  - u16Count_ is the number of bytes to consume
+
+Promises:
+  - The read pointer advances (wrapping around the receive buffer) by u16Count_ or the number of unread bytes,
+    whichever is smaller
+*/
+void UartSkipBytes(UartPeripheralType* psUartPeripheral_, u16 u16Count_)
+{
+  u16 u16Available = UartRxByteCount(psUartPeripheral_);
+  u16 u16ToEnd;
+  
+  if(u16Count_ > u16Available)
+  {
+    u16Count_ = u16Available;
+  }
+  
+  u16ToEnd = (u16)(psUartPeripheral_->pu8RxBuffer + psUartPeripheral_->u16RxBufferSize - psUartPeripheral_->pu8RxReadByte);
+  if(u16Count_ >= u16ToEnd)
+  {
+    psUartPeripheral_->pu8RxReadByte = psUartPeripheral_->pu8RxBuffer + (u16Count_ - u16ToEnd);
+  }
+  else
+  {
+    psUartPeripheral_->pu8RxReadByte += u16Count_;
+  }
+  
+} /* end UartSkipBytes() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartReadBytes
+
+Description:
+Copies unread bytes out of the receive buffer and consumes them in one call.
+
+Requires:
+  - psUartPeripheral_ has been requested and its fnRxCallback advances the pointer at pu8RxNextByte
+  - pu8Destination_ has room for u16MaxSize_ bytes
+
+Promises:
+  - Up to u16MaxSize_ of the oldest unread bytes are copied to pu8Destination_ in order, taking both spans
+    if the unread data wraps around the end of the receive buffer
+  - The copied bytes are consumed
+  - Returns the number of bytes copied
+*/
+u16 UartReadBytes(UartPeripheralType* psUartPeripheral_, u8* pu8Destination_, u16 u16MaxSize_)
+{
+  u8* pu8Span;
+  u16 u16SpanSize;
+  u16 u16Copied = 0;
+  
+  /* At most two spans: up to the end of the buffer and then from the start */
+  for(u8 i = 0; (i < 2) && (u16Copied < u16MaxSize_); i++)
   {
-    /* If the system is initializing, manually cycle the UART task through one iteration to send the message */
-    if(G_u32SystemFlags & _SYSTEM_INITIALIZING)
+    u16SpanSize = UartPeekContiguous(psUartPeripheral_, &pu8Span);
+    if(u16SpanSize > (u16MaxSize_ - u16Copied))
     {
-      UartManualMode();
+      u16SpanSize = u16MaxSize_ - u16Copied;
     }
+    
+    memcpy(pu8Destination_ + u16Copied, pu8Span, u16SpanSize);
+    UartSkipBytes(psUartPeripheral_, u16SpanSize);
+    u16Copied += u16SpanSize;
   }
   
-  return(u32Token);
+  return(u16Copied);
   
-} /* end UartWriteData() */
+} /* end UartReadBytes() */
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -561,34 +854,46 @@ void UartInitialize(void)
   
   /* Initialize the UART peripheral structures */
   UART_Peripheral.pBaseAddress     = (AT91S_USART*)AT91C_BASE_DBGU;
-  UART_Peripheral.psTransmitBuffer = NULL;
+  InitializeMessageQueue(&UART_Peripheral.sTransmitQueue);
+  RegisterMessageQueue(&UART_Peripheral.sTransmitQueue);
   UART_Peripheral.pu8RxBuffer      = NULL;
   UART_Peripheral.u16RxBufferSize  = 0;
   UART_Peripheral.pu8RxNextByte    = NULL;
+  UART_Peripheral.pu8RxReportedByte = NULL;
+  UART_Peripheral.pu8RxReadByte = NULL;
   UART_Peripheral.u32PrivateFlags  = 0;
   UART_Peripheral.u8PeripheralId  = AT91C_ID_DBGU;
 
   UART_Peripheral0.pBaseAddress    = AT91C_BASE_US0;
-  UART_Peripheral0.psTransmitBuffer = NULL;
+  InitializeMessageQueue(&UART_Peripheral0.sTransmitQueue);
+  RegisterMessageQueue(&UART_Peripheral0.sTransmitQueue);
   UART_Peripheral0.pu8RxBuffer     = NULL;
   UART_Peripheral0.u16RxBufferSize = 0;
   UART_Peripheral0.pu8RxNextByte   = NULL;
+  UART_Peripheral0.pu8RxReportedByte = NULL;
+  UART_Peripheral0.pu8RxReadByte = NULL;
   UART_Peripheral0.u32PrivateFlags = 0;
   UART_Peripheral0.u8PeripheralId  = AT91C_ID_US0;
 
   UART_Peripheral1.pBaseAddress    = AT91C_BASE_US1;
-  UART_Peripheral1.psTransmitBuffer = NULL;
+  InitializeMessageQueue(&UART_Peripheral1.sTransmitQueue);
+  RegisterMessageQueue(&UART_Peripheral1.sTransmitQueue);
   UART_Peripheral1.pu8RxBuffer     = NULL;
   UART_Peripheral1.u16RxBufferSize = 0;
   UART_Peripheral1.pu8RxNextByte   = NULL;
+  UART_Peripheral1.pu8RxReportedByte = NULL;
+  UART_Peripheral1.pu8RxReadByte = NULL;
   UART_Peripheral1.u32PrivateFlags = 0;
   UART_Peripheral1.u8PeripheralId  = AT91C_ID_US1;
 
   UART_Peripheral2.pBaseAddress    = AT91C_BASE_US2;
-  UART_Peripheral2.psTransmitBuffer = NULL;
+  InitializeMessageQueue(&UART_Peripheral2.sTransmitQueue);
+  RegisterMessageQueue(&UART_Peripheral2.sTransmitQueue);
   UART_Peripheral2.pu8RxBuffer     = NULL;
   UART_Peripheral2.u16RxBufferSize = 0;
   UART_Peripheral2.pu8RxNextByte   = NULL;
+  UART_Peripheral2.pu8RxReportedByte = NULL;
+  UART_Peripheral2.pu8RxReadByte = NULL;
   UART_Peripheral2.u32PrivateFlags = 0;
   UART_Peripheral2.u8PeripheralId  = AT91C_ID_US2;
   
@@ -716,31 +1021,234 @@ static void UartReadRxBuffer(UartPeripheralType* psTargetUart_)
 #endif
 
 /*----------------------------------------------------------------------------------------------------------------------
-Function: UartManualMode
+Function: UartRxReportBytes
 
 Description:
-Runs a transmit cycle of the UART application to clock out a message.  This function is used only during
-initialization.
+Reports the bytes the PDC has written since the last report by calling fnRxCallback once per byte, exactly as 
+byte mode would have, so the client's next byte pointer stays in step with the buffer.
+This function is only called from the UART ISR.
 
 Requires:
-  - UART application has been initialized.
+  - psTargetUart_ receives in UART_RX_BLOCK mode
+  - psTargetUart_->pu8RxReportedByte is the first byte not yet reported
 
 Promises:
-  - All bytes currently in the UART Rx FIFO are read out to the application receive circular buffer.
+  - fnRxCallback is called once for each byte between pu8RxReportedByte and the PDC receive pointer; if the PDC
+    has stopped (RCR and RNCR are 0) with its pointer back on pu8RxReportedByte, the whole buffer is new and 
+    u16RxBufferSize bytes are reported
+  - pu8RxReportedByte is advanced (wrapping around the circular buffer) to the PDC receive pointer
 */
-static void UartManualMode(void)
+static void UartRxReportBytes(UartPeripheralType* psTargetUart_)
 {
-  UART_u32Flags |=_UART_MANUAL_MODE;
-  UART_psCurrentUart = &UART_Peripheral;
+  u8* pu8BufferEnd = psTargetUart_->pu8RxBuffer + psTargetUart_->u16RxBufferSize;
+  u8* pu8WriteByte = (u8*)psTargetUart_->pBaseAddress->US_RPR;
+  u16 u16NewBytes;
+
+  /* RPR sits on the end of the buffer only when both halves are full */
+  if(pu8WriteByte >= pu8BufferEnd)
+  {
+    pu8WriteByte = psTargetUart_->pu8RxBuffer;
+  }
   
-  while(UART_u32Flags &_UART_MANUAL_MODE)
+  if(pu8WriteByte >= psTargetUart_->pu8RxReportedByte)
   {
-    Uart_pfnStateMachine();
-    UART_u32Timer  = G_u32SystemTime1ms;
-    IsTimeUp(&UART_u32Timer, 1);
+    u16NewBytes = (u16)(pu8WriteByte - psTargetUart_->pu8RxReportedByte);
   }
-      
-} /* end UartManualMode() */
+  else
+  {
+    u16NewBytes = (u16)(pu8BufferEnd - psTargetUart_->pu8RxReportedByte + (pu8WriteByte - psTargetUart_->pu8RxBuffer));
+  }
+  
+  /* Both halves filled since the last report: the PDC has lapped the reported pointer, so no bytes would show */
+  if( (u16NewBytes == 0) &&
+      (psTargetUart_->pBaseAddress->US_RCR == 0) && (psTargetUart_->pBaseAddress->US_RNCR == 0) )
+  {
+    u16NewBytes = psTargetUart_->u16RxBufferSize;
+  }
+  
+  for(u16 i = 0; i < u16NewBytes; i++)
+  {
+    psTargetUart_->fnRxCallback();
+    
+    psTargetUart_->pu8RxReportedByte++;
+    if(psTargetUart_->pu8RxReportedByte == pu8BufferEnd)
+    {
+      psTargetUart_->pu8RxReportedByte = psTargetUart_->pu8RxBuffer;
+    }
+  }
+  
+} /* end UartRxReportBytes() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartRxBlockComplete
+
+Description:
+Handles ENDRX in UART_RX_BLOCK mode: the PDC has finished one half of the receive buffer and moved on to the other.
+The finished half is reported and queued again as the next PDC buffer.
+This function is only called from the UART ISR.
+
+Requires:
+  - psTargetUart_ receives in UART_RX_BLOCK mode and ENDRX is set
+
+Promises:
+  - All received bytes are reported with UartRxReportBytes()
+  - If the PDC is still receiving, RNPR/RNCR are loaded with the half of the buffer it is not using
+  - If both halves filled before this interrupt was serviced, every byte of them is reported, the PDC restarts 
+    at the reported pointer (the start of either half) and _UART_RX_BUFFER_OVERRUN is flagged to the application
+  - ENDRX is cleared
+*/
+static void UartRxBlockComplete(UartPeripheralType* psTargetUart_)
+{
+  u16 u16BlockSize = psTargetUart_->u16RxBufferSize / 2;
+  u8* pu8SecondBlock = psTargetUart_->pu8RxBuffer + u16BlockSize;
+
+  UartRxReportBytes(psTargetUart_);
+
+  if(psTargetUart_->pBaseAddress->US_RCR == 0)
+  {
+    /* Both blocks are full: restart where the reported pointer is now */
+    if(psTargetUart_->pu8RxReportedByte == pu8SecondBlock)
+    {
+      psTargetUart_->pBaseAddress->US_RPR  = (u32)pu8SecondBlock;
+      psTargetUart_->pBaseAddress->US_RCR  = psTargetUart_->u16RxBufferSize - u16BlockSize;
+      psTargetUart_->pBaseAddress->US_RNPR = (u32)psTargetUart_->pu8RxBuffer;
+      psTargetUart_->pBaseAddress->US_RNCR = u16BlockSize;
+    }
+    else
+    {
+      psTargetUart_->pBaseAddress->US_RPR  = (u32)psTargetUart_->pu8RxBuffer;
+      psTargetUart_->pBaseAddress->US_RCR  = u16BlockSize;
+      psTargetUart_->pBaseAddress->US_RNPR = (u32)pu8SecondBlock;
+      psTargetUart_->pBaseAddress->US_RNCR = psTargetUart_->u16RxBufferSize - u16BlockSize;
+    }
+    *UART_pu32ApplicationFlagsISR |= _UART_RX_BUFFER_OVERRUN;
+  }
+  else if(psTargetUart_->pBaseAddress->US_RPR >= (u32)pu8SecondBlock)
+  {
+    /* The PDC is in the second block so the first one is next */
+    psTargetUart_->pBaseAddress->US_RNPR = (u32)psTargetUart_->pu8RxBuffer;
+    psTargetUart_->pBaseAddress->US_RNCR = u16BlockSize;
+  }
+  else
+  {
+    /* The PDC is in the first block so the second one is next */
+    psTargetUart_->pBaseAddress->US_RNPR = (u32)pu8SecondBlock;
+    psTargetUart_->pBaseAddress->US_RNCR = psTargetUart_->u16RxBufferSize - u16BlockSize;
+  }
+  
+} /* end UartRxBlockComplete() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartLoadTransmit
+
+Description:
+Loads the head message of the transmit queue in to the current PDC transmit registers and chains the message
+behind it.  Called from the state machine to start a peripheral and from the ISR to restart it.
+
+Requires:
+  - psTargetUart_->sTransmitQueue.psHead is not NULL
+  - The PDC transmit counters are both 0
+
+Promises:
+  - The head message is SENDING and loaded in US_TPR/US_TCR (which clears ENDTX)
+  - UartChainTransmit() has run
+*/
+static void UartLoadTransmit(UartPeripheralType* psTargetUart_)
+{
+  MessageType* psHead = psTargetUart_->sTransmitQueue.psHead;
+  
+  MarkMessageSending(psHead);
+  psTargetUart_->pBaseAddress->US_TPR = (u32)psHead->pu8Data;
+  psTargetUart_->pBaseAddress->US_TCR = psHead->u32Size;
+  
+  UartChainTransmit(psTargetUart_);
+  
+} /* end UartLoadTransmit() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartChainTransmit
+
+Description:
+Loads the message after the head of the transmit queue in to the next PDC transmit registers so the PDC moves
+straight on to it when the head finishes.  ENDTX is used while a message is chained; with nothing to chain the
+ISR waits for TXBUFE instead.  MarkMessageSending() stops the scavenger reclaiming the chained message.
+
+Requires:
+  - The head message is in the current PDC transmit registers and nothing is chained
+
+Promises:
+  - If the queue has a second message: it is SENDING, loaded in US_TNPR/US_TNCR, _UART_PERIPHERAL_TX_CHAINED
+    is set and only ENDTX is enabled
+  - Otherwise only TXBUFE is enabled
+*/
+static void UartChainTransmit(UartPeripheralType* psTargetUart_)
+{
+  MessageType* psNext = (MessageType*)psTargetUart_->sTransmitQueue.psHead->psNextMessage;
+  
+  if(psNext != NULL)
+  {
+    MarkMessageSending(psNext);
+    psTargetUart_->u32PrivateFlags |= _UART_PERIPHERAL_TX_CHAINED;
+    psTargetUart_->pBaseAddress->US_TNPR = (u32)psNext->pu8Data;
+    psTargetUart_->pBaseAddress->US_TNCR = psNext->u32Size;
+    
+    /* If the current transfer ran out just before TNCR was written the PDC has stopped, so start the chained 
+    message directly.  The ENDTX that follows still completes the head first. */
+    if( (psTargetUart_->pBaseAddress->US_TCR == 0) && (psTargetUart_->pBaseAddress->US_TNCR != 0) )
+    {
+      psTargetUart_->pBaseAddress->US_TPR  = psTargetUart_->pBaseAddress->US_TNPR;
+      psTargetUart_->pBaseAddress->US_TCR  = psTargetUart_->pBaseAddress->US_TNCR;
+      psTargetUart_->pBaseAddress->US_TNCR = 0;
+    }
+    
+    psTargetUart_->pBaseAddress->US_IDR = AT91C_US_TXBUFE;
+    psTargetUart_->pBaseAddress->US_IER = AT91C_US_ENDTX;
+  }
+  else
+  {
+    psTargetUart_->pBaseAddress->US_IDR = AT91C_US_ENDTX;
+    psTargetUart_->pBaseAddress->US_IER = AT91C_US_TXBUFE;
+  }
+  
+} /* end UartChainTransmit() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: UartTransmitComplete
+
+Description:
+Handles the PDC running out of transmit data: the head message is complete.  If more messages were queued while
+it was sending the PDC is restarted right away; otherwise the transmitter is shut down.
+This function is only called from the UART ISR.
+
+Requires:
+  - The head message has been sent and nothing is chained
+
+Promises:
+  - The head message is COMPLETE and dequeued
+  - The next message is loaded with UartLoadTransmit(); OR
+  - _UART_PERIPHERAL_TX is cleared and the PDC transmitter and its interrupts are disabled
+*/
+static void UartTransmitComplete(UartPeripheralType* psTargetUart_)
+{
+  UpdateMessageStatus(psTargetUart_->sTransmitQueue.psHead->u32Token, COMPLETE);
+  DeQueueMessage(&psTargetUart_->sTransmitQueue);
+  
+  if(psTargetUart_->sTransmitQueue.psHead != NULL)
+  {
+    UartLoadTransmit(psTargetUart_);
+  }
+  else
+  {
+    psTargetUart_->u32PrivateFlags &= ~_UART_PERIPHERAL_TX;
+    psTargetUart_->pBaseAddress->US_PTCR = AT91C_PDC_TXTDIS;
+    psTargetUart_->pBaseAddress->US_IDR  = AT91C_US_ENDTX | AT91C_US_TXBUFE;
+  }
+  
+} /* end UartTransmitComplete() */
 
 
 #ifdef USE_SIMPLE_USART0
@@ -925,11 +1433,13 @@ Description:
 Receive: A requested UART peripheral is always enabled and ready to receive data.  Receive interrupts will occur when a
 new byte has been read by the peripheral. All incoming data is dumped into the circular receive data buffer configured.
 No processing is done on the data - it is up to the processing application to parse incoming data to find useful information
-and to manage dummy bytes.  All data reception is done with DMA, but only 1 byte at a time.  Receiving is done by using
-the two reception pointers to ensure no data is missed.
+and to manage dummy bytes.  All data reception is done with DMA, by default only 1 byte at a time.  Receiving is done by using
+the two reception pointers to ensure no data is missed.  In UART_RX_BLOCK mode the two pointers cover the two halves of the
+receive buffer: ENDRX reports a full half and reloads it, and TIMEOUT reports the bytes of a partial half once the line is idle.
 
-Transmit: All data bytes in the transmit buffer are sent using DMA and interrupts. Once the full message has been sent,
-the message status is updated.
+Transmit: All data bytes in the transmit buffer are sent using DMA and interrupts. The PDC next pointer holds the message
+after the one sending, so queued messages go out back to back: ENDTX completes the head message and chains the next one,
+and TXBUFE completes the last message and restarts the PDC if more were queued in the meantime.
 */
 void UartGenericHandler(void)
 {
@@ -940,45 +1450,65 @@ void UartGenericHandler(void)
     /* Flag that a byte has arrived */
     *UART_pu32ApplicationFlagsISR |= _UART_RX_COMPLETE;
 
-    /* Update the "next" DMA pointer to the next valid Rx location */
-    UART_psCurrentISR->pBaseAddress->US_RNPR++;
-    if(UART_psCurrentISR->pBaseAddress->US_RNPR == (u32)(UART_psCurrentISR->pu8RxBuffer + (u32)UART_psCurrentISR->u16RxBufferSize) )
+    if(UART_psCurrentISR->u32PrivateFlags & _UART_PERIPHERAL_RX_BLOCK)
     {
-      UART_psCurrentISR->pBaseAddress->US_RNPR = (u32)UART_psCurrentISR->pu8RxBuffer;  /* !!!!! CHECK */
+      UartRxBlockComplete(UART_psCurrentISR);
     }
+    else
+    {
+      /* Update the "next" DMA pointer to the next valid Rx location */
+      UART_psCurrentISR->pBaseAddress->US_RNPR++;
+      if(UART_psCurrentISR->pBaseAddress->US_RNPR == (u32)(UART_psCurrentISR->pu8RxBuffer + (u32)UART_psCurrentISR->u16RxBufferSize) )
+      {
+        UART_psCurrentISR->pBaseAddress->US_RNPR = (u32)UART_psCurrentISR->pu8RxBuffer;  /* !!!!! CHECK */
+      }
 
-    /* Invoke the callback */
-    UART_psCurrentISR->fnRxCallback();
-    
-    /* Write RNCR to 1 to clear the ENDRX flag */
-    UART_psCurrentISR->pBaseAddress->US_RNCR = 1;
+      /* Invoke the callback */
+      UART_psCurrentISR->fnRxCallback();
+      
+      /* Write RNCR to 1 to clear the ENDRX flag */
+      UART_psCurrentISR->pBaseAddress->US_RNCR = 1;
+    }
+  }
+
+  /* TIMEOUT Interrupt when the line has gone idle with a partial block in the buffer (UART_RX_BLOCK mode only) */
+  if( (UART_psCurrentISR->pBaseAddress->US_IMR & AT91C_US_TIMEOUT) && 
+      (UART_psCurrentISR->pBaseAddress->US_CSR & AT91C_US_TIMEOUT) )
+  {
+    *UART_pu32ApplicationFlagsISR |= _UART_RX_COMPLETE;
+    UartRxReportBytes(UART_psCurrentISR);
+
+    /* Clear TIMEOUT and hold the counter until the next byte arrives */
+    UART_psCurrentISR->pBaseAddress->US_CR = AT91C_US_STTTO;
   }
 
   
-  /* ENDTX Interrupt when all requested transmit bytes have been sent (if enabled) */
+  /* ENDTX Interrupt when the head message has been sent and the PDC has moved on to the chained message (if enabled) */
   if( (UART_psCurrentISR->pBaseAddress->US_IMR & AT91C_US_ENDTX) && 
       (UART_psCurrentISR->pBaseAddress->US_CSR & AT91C_US_ENDTX) )
   {
     /* Update this message token status and then DeQueue it */
-    UpdateMessageStatus(UART_psCurrentISR->psTransmitBuffer->u32Token, COMPLETE);
-    DeQueueMessage( &UART_psCurrentISR->psTransmitBuffer );
-    UART_psCurrentISR->u32PrivateFlags &= ~_UART_PERIPHERAL_TX;
-        
-    /* Disable the transmitter and interrupt source */
-    UART_psCurrentISR->pBaseAddress->US_PTCR = AT91C_PDC_TXTDIS;
-    UART_psCurrentISR->pBaseAddress->US_IDR  = AT91C_US_ENDTX;
+    UpdateMessageStatus(UART_psCurrentISR->sTransmitQueue.psHead->u32Token, COMPLETE);
+    DeQueueMessage( &UART_psCurrentISR->sTransmitQueue );
+    UART_psCurrentISR->u32PrivateFlags &= ~_UART_PERIPHERAL_TX_CHAINED;
     
-    /* Decrement # of active UARTs */
-    if(UART_u8ActiveUarts != 0)
+    if(UART_psCurrentISR->pBaseAddress->US_CSR & AT91C_US_TXBUFE)
     {
-      UART_u8ActiveUarts--;
+      /* The chained message also finished before this interrupt was serviced */
+      UartTransmitComplete(UART_psCurrentISR);
     }
     else
     {
-      /* If UART_u8ActiveUarts is already 0, then we are not properly synchronized */
-      DebugPrintf("\n\rUART counter out of sync\n\r");
+      /* Keep the PDC busy with the message after the one now sending */
+      UartChainTransmit(UART_psCurrentISR);
     }
   }
+  /* TXBUFE Interrupt when the last message loaded in to the PDC has been sent (if enabled) */
+  else if( (UART_psCurrentISR->pBaseAddress->US_IMR & AT91C_US_TXBUFE) && 
+           (UART_psCurrentISR->pBaseAddress->US_CSR & AT91C_US_TXBUFE) )
+  {
+    UartTransmitComplete(UART_psCurrentISR);
+  }
   
 } /* end SspGenericHandler() */
 
@@ -987,8 +1517,8 @@ void UartGenericHandler(void)
 State Machine Function Definitions
 
 The UART state machine monitors messaging activity on the available UART peripherals.  It manages outgoing messages and will
-transmit any bytes that has been queued.  Only one message will be transferred at once (e.g. UART1 and UART2 will not both 
-send at the same time, though both peripherals will continue to receive simultaneously).
+transmit any bytes that has been queued.  Each peripheral has its own PDC channel, so every peripheral with a queued message
+starts sending in the same pass (e.g. UART1 and UART2 send at the same time while all peripherals continue to receive).
 Since all transmit and receive bytes are transferred using interrupts, the SM does not have to worry about prioritizing.
 
 Transmitting on USART 0:
@@ -1009,6 +1539,8 @@ assume they won't.
 /* Wait for a transmit message to be queued.  Received data is handled in interrupts. */
 void UartSM_Idle(void)
 {
+  UartPeripheralType* psUart;
+  
 #if USE_SIMPLE_USART0
   u8 u8Temp;
 
@@ -1032,57 +1564,25 @@ void UartSM_Idle(void)
   }
 #endif /* USE_SIMPLE_USART0 */
 
-  /* Check all UART peripherals for message activity or skip the current peripheral if it is already busy sending.
-  All receive functions take place outside of the state machine.
-  Devices sending a message will have UART_psCurrentSsp->psTransmitBuffer->pu8Message pointing to the message to send. */
-  if( (UART_psCurrentUart->psTransmitBuffer != NULL) && 
-     !(UART_psCurrentUart->u32PrivateFlags & _UART_PERIPHERAL_TX ) )
+  /* Start a transfer on every UART peripheral that has a message waiting and is not already sending.  Each peripheral
+  has its own PDC transmit channel so all of them can send at once.  All receive functions take place outside of the 
+  state machine. */
+  for(u8 i = 0; i < UART_PERIPHERALS; i++)
   {
-    /* Transmitting: update the message's status and flag that the peripheral is now busy */
-    UpdateMessageStatus(UART_psCurrentUart->psTransmitBuffer->u32Token, SENDING);
-    UART_psCurrentUart->u32PrivateFlags |= _UART_PERIPHERAL_TX;    
-      
-    /* Load the PDC counter and pointer registers */
-    UART_psCurrentUart->pBaseAddress->US_TPR = (unsigned int)UART_psCurrentUart->psTransmitBuffer->pu8Message; /* CHECK */
-    UART_psCurrentUart->pBaseAddress->US_TCR = UART_psCurrentUart->psTransmitBuffer->u32Size;
-
-    /* When TCR is loaded, the ENDTX flag is cleared so it is safe to enable the interrupt */
-    UART_psCurrentUart->pBaseAddress->US_IER = AT91C_US_ENDTX;
+    psUart = UART_apsPeripherals[i];
     
-    /* Update active UART count and enable the transmitter to start the transfer */
-    UART_u8ActiveUarts++;
-    UART_psCurrentUart->pBaseAddress->US_PTCR = AT91C_PDC_TXTEN;
-  }
-  
-  /* Adjust to check the next peripheral next time through */
-  switch (UART_psCurrentUart->u8PeripheralId)
-  {
-    case AT91C_ID_DBGU:
-      UART_psCurrentUart = &UART_Peripheral0;
-      break;
-
-    case AT91C_ID_US0:
-      UART_psCurrentUart = &UART_Peripheral1;
-      break;
-
-    case AT91C_ID_US1:
-      UART_psCurrentUart = &UART_Peripheral2;
-      break;
-
-    case AT91C_ID_US2:
-      UART_psCurrentUart = &UART_Peripheral;
+    if( (psUart->sTransmitQueue.psHead != NULL) && 
+       !(psUart->u32PrivateFlags & _UART_PERIPHERAL_TX ) )
+    {
+      /* Transmitting: flag that the peripheral is now busy and load the PDC.  From here the ISR keeps the
+      PDC going until the queue is empty. */
+      psUart->u32PrivateFlags |= _UART_PERIPHERAL_TX;    
+      UartLoadTransmit(psUart);
       
-      /* Only clear _UART_MANUAL_MODE if all UARTs are done sending to ensure messages are sent during initialization */
-      if( (G_u32SystemFlags & _SYSTEM_INITIALIZING) && !UART_u8ActiveUarts)
-      {
-        UART_u32Flags &= ~_UART_MANUAL_MODE;
-      }
-      break;
-
-    default:
-      UART_psCurrentUart = &UART_Peripheral;
-      break;
-  } /* end switch */
+      /* Enable the transmitter to start the transfer */
+      psUart->pBaseAddress->US_PTCR = AT91C_PDC_TXTEN;
+    }
+  }
   
 } /* end UartSM_Idle() */
 
@@ -1098,8 +1598,8 @@ void UartSM_Transmitting(void)
       (UART_psCurrentUart->pBaseAddress->US_IER & AT91C_US_TXEMPTY) )
   {
     /* Update the status queue and then dequeue the message */
-    UpdateMessageStatus(UART_psCurrentUart->pTransmitBuffer->u32Token, COMPLETE);
-    DeQueueMessage(&UART_psCurrentUart->pTransmitBuffer);
+    UpdateMessageStatus(UART_psCurrentUart->sTransmitQueue.psHead->u32Token, COMPLETE);
+    DeQueueMessage(&UART_psCurrentUart->sTransmitQueue);
 
     /* Make sure _UART_INIT_MODE flag is clear in case this was a manual cycle */
     UART_u32Flags &= ~_UART_INIT_MODE;
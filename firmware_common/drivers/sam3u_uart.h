@@ -13,6 +13,8 @@ Header file for sam3u_uart.c
 /**********************************************************************************************************************
 Type Definitions
 **********************************************************************************************************************/
+typedef enum {UART_RX_BYTE = 0, UART_RX_BLOCK} UartRxModeType;
+
 typedef struct 
 {
   PeripheralType UartPeripheral;      /* Easy name of peripheral */
@@ -20,17 +22,23 @@ typedef struct
   u8* pu8RxBufferAddress;             /* Address to circular receive buffer */
   u8** pu8RxNextByte;                 /* Pointer to buffer location where next received byte will be placed */
   fnCode_type fnRxCallback;           /* Callback function for receiving data */
+  MessagePriorityType eTxPriority;    /* Priority class of the transmit queue (0 is MSG_PRIORITY_NORMAL) */
+  u32 u32TxByteQuota;                 /* Max message arena bytes the transmit queue may hold; 0 for no quota */
+  UartRxModeType eRxMode;             /* UART_RX_BYTE (one interrupt per byte) or UART_RX_BLOCK (PDC blocks + idle timeout) */
+  bool bHardwareFlowControl;          /* TRUE for RTS/CTS handshaking (USARTs only) */
 } UartConfigurationType;
 
 typedef struct 
 {
   AT91PS_USART pBaseAddress;          /* Base address of the associated peripheral */
   u32 u32PrivateFlags;            /* Flags for peripheral */
-  MessageType* psTransmitBuffer;      /* Pointer to the transmit message linked list */
+  MessageQueueType sTransmitQueue;    /* Transmit message queue */
   u32 u32CurrentTxBytesRemaining;     /* Counter for bytes remaining in current transfer */
   u8* pu8CurrentTxData;               /* Pointer to current location in the Tx buffer */
   u8* pu8RxBuffer;                    /* Pointer to circular receive buffer in user application */
   u8** pu8RxNextByte;                 /* Pointer to buffer location where next received byte will be placed */
+  u8* pu8RxReportedByte;              /* UART_RX_BLOCK: first byte written by the PDC not yet reported with fnRxCallback */
+  u8* pu8RxReadByte;                  /* Oldest byte not yet read through UartPeekContiguous()/UartSkipBytes()/UartReadBytes() */
   fnCode_type fnRxCallback;           /* Callback function for receiving data */
   u16 u16RxBufferSize;                /* Size of receive buffer in bytes */
   u8 u8PeripheralId;                  /* Simple peripheral ID number */
@@ -40,6 +48,8 @@ typedef struct
 /* u32PrivateFlags */
 #define   _UART_PERIPHERAL_ASSIGNED     (u32)0x00000001   /* Set when the peripheral is in use */
 #define   _UART_PERIPHERAL_TX           (u32)0x00200000   /* Set when the peripheral is transmitting */
+#define   _UART_PERIPHERAL_RX_BLOCK     (u32)0x00400000   /* Set when the peripheral receives in UART_RX_BLOCK mode */
+#define   _UART_PERIPHERAL_TX_CHAINED   (u32)0x00800000   /* Set when the message after the head is loaded in US_TNPR/US_TNCR */
 
 /**********************************************************************************************************************
 Constants / Definitions
@@ -52,7 +62,6 @@ Constants / Definitions
 /* end G_u32UartxApplicationFlags */
 
 /* UART_u32Flags (UART application flags) */
-#define _UART_MANUAL_MODE               (u32)0x00000001   /* Set to push a transmit cycle during initialization mode */
 #define _UART_U0_SENDING                (u32)0x00000002   /* Set when the first Tx byte of the simple USART0 is loaded */
 
 #define _UART_ERROR_INVALID_UART        (u32)0x01000000   /* Set if an undefined UART is attempted to be parsed */
@@ -75,6 +84,12 @@ casted back to integers for comparisons as far as we could tell! */
 #define UART_BASE_US3                   (u32)0x4009C000
 
 #define UART_INIT_MSG_TIMEOUT           (u32)1000           /* Time in ms for init message to send */
+#define UART_PERIPHERALS                (u8)4               /* DBGU and USART0-2 */
+
+#define UART_RX_BLOCK_MIN_BUFFER        (u16)8              /* Smallest receive buffer that UART_RX_BLOCK mode will split in two */
+#define UART_MCK                        (u32)(CCLK_VALUE)   /* Master clock feeding the baud rate generators */
+#define UART_BAUD_MAX_ERROR_PERCENT     (u32)2              /* Largest baud rate error UartSetBaudRate() accepts */
+#define UART_RX_TIMEOUT_BITS            (u32)20             /* Idle bit periods (2 characters at 8-N-1) before a partial block is flushed */
 
 
 /***********************************************************************************************************************
@@ -98,6 +113,14 @@ void UartRelease(UartPeripheralType* psUartPeripheral_);
 
 u32 UartWriteByte(UartPeripheralType* psUartPeripheral_, u8 u8Byte_);
 u32 UartWriteData(UartPeripheralType* psUartPeripheral_, u32 u32Size_, u8* u8Data_);
+u32 UartWriteDataReference(UartPeripheralType* psUartPeripheral_, u32 u32Size_, u8* u8Data_);
+
+bool UartSetBaudRate(UartPeripheralType* psUartPeripheral_, u32 u32BaudRate_);
+
+u16 UartRxByteCount(UartPeripheralType* psUartPeripheral_);
+u16 UartPeekContiguous(UartPeripheralType* psUartPeripheral_, u8** ppu8Data_);
+void UartSkipBytes(UartPeripheralType* psUartPeripheral_, u16 u16Count_);
+u16 UartReadBytes(UartPeripheralType* psUartPeripheral_, u8* pu8Destination_, u16 u16MaxSize_);
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -106,14 +129,17 @@ u32 UartWriteData(UartPeripheralType* psUartPeripheral_, u32 u32Size_, u8* u8Dat
 void UartInitialize(void);
 void UartRunActiveState(void);
 
-void UartManualMode(void);
-
 
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Private functions */
 /*--------------------------------------------------------------------------------------------------------------------*/
 //static void UartFillTxBuffer(UartPeripheralType* UartPeripheral_);
 //static void UartReadRxBuffer(UartPeripheralType* psTargetUart_);
+static void UartRxReportBytes(UartPeripheralType* psTargetUart_);
+static void UartRxBlockComplete(UartPeripheralType* psTargetUart_);
+static void UartLoadTransmit(UartPeripheralType* psTargetUart_);
+static void UartChainTransmit(UartPeripheralType* psTargetUart_);
+static void UartTransmitComplete(UartPeripheralType* psTargetUart_);
 
 void UART_IRQHandler(void);
 void UART0_IRQHandler(void);
@@ -0,0 +1,77 @@
+/**********************************************************************************************************************
+File: configuration.h (host build)
+
+Description:
+Stands in for firmware_common/configuration.h when messaging.c is built on a Linux host by messaging_host.c.
+Only what messaging.c needs is provided:
+  - The fixed-width types from typedefs.h (u32 MUST be 32 bits so the token and time arithmetic wrap as on target)
+  - G_u32SystemTime1ms and a SysTick counter that the test program drives by hand
+  - LDREX/STREX stand-ins that can inject the simulated peripheral ISR (see messaging_host.c)
+
+The exclusive-access stand-ins move pointers through u32 just like the target, so the program MUST be linked
+with -no-pie: every object the queues point at is then static and below 4GB.
+
+***********************************************************************************************************************/
+
+#ifndef __CONFIG_H
+#define __CONFIG_H
+
+/**********************************************************************************************************************
+Includes
+***********************************************************************************************************************/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+typedef uint64_t u64;                   /* Host only: used for benchmark totals */
+typedef uint32_t u32;
+typedef uint16_t u16;
+typedef uint8_t  u8;
+typedef int32_t  s32;
+
+typedef void(*fnCode_type)(void);
+
+typedef enum {FALSE = 0, TRUE = !FALSE} bool;
+
+/* The only SysTick register messaging.c reads */
+typedef struct
+{
+  volatile u32 NVIC_STICKCVR;
+} HostNvicType;
+
+
+/**********************************************************************************************************************
+Constants / Definitions
+***********************************************************************************************************************/
+#define SYSTICK_COUNT                   (u32)48000     /* SysTick ticks per ms (48MHz core clock) */
+#define AT91C_BASE_NVIC                 (&Host_sNvic)
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+extern HostNvicType Host_sNvic;
+
+/* Exclusive access stand-ins (messaging_host.c) */
+u32 __LDREXW(volatile u32* pu32Address_);
+u32 __STREXW(u32 u32Value_, volatile u32* pu32Address_);
+u8  __LDREXB(volatile u8* pu8Address_);
+u32 __STREXB(u8 u8Value_, volatile u8* pu8Address_);
+
+
+/**********************************************************************************************************************
+Driver header files
+***********************************************************************************************************************/
+#include "messaging.h"
+
+#endif /* __CONFIG_H */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File */
+/*--------------------------------------------------------------------------------------------------------------------*/
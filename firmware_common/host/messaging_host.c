@@ -0,0 +1,1459 @@
+/**********************************************************************************************************************
+File: messaging_host.c
+
+Description:
+Linux host build of messaging.c with a stubbed timer, a simulated peripheral ISR, a randomized multi-producer stress
+test, a live token test, a split message test, a queue/status/dequeue benchmark and an allocator sweep over pool sizes of 16 to 1024 blocks.  messaging.c
+is compiled in to this file so the tests can check the private arena, queues and status table directly.  The 
+numbers are the baseline that messaging changes are held against; they measure the algorithms, not the SAM3U (use
+the debug benchmark commands for target timing).
+
+Build and run from the repository root (-no-pie is required, see host/configuration.h):
+  gcc -O2 -no-pie -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast -Ifirmware_common/host
+      -Ifirmware_common/drivers firmware_common/host/messaging_host.c -o messaging_host
+  ./messaging_host
+
+Larger arenas can be tested by adding e.g. -DMSG_ARENA_SIZE=131072 -DSTATUS_QUEUE_SIZE=4096 (STATUS_QUEUE_SIZE
+must still satisfy the size check in messaging.c).  The allocator sweep runs in an arena of its own sized for 
+HOST_SWEEP_MAX_BLOCKS, so it does not depend on MSG_ARENA_SIZE.  The program returns 0 if every check passed.
+
+------------------------------------------------------------------------------------------------------------------------
+Simulated interrupts:
+The peripheral "ISR" is HostPeripheralIsr().  It is injected at random:
+  - Right after any LDREX, in which case the exclusive monitor is cleared so the following STREX fails exactly as
+    it does on the Cortex-M3 when an exception is taken between the two
+  - Right after any successful STREX (between the steps of a lock-free update)
+  - Between main loop operations
+The ISR services the head of a random stress queue like the UART does: it marks the message SENDING, sometimes
+chains the message behind it, checks the payload, sets COMPLETE and dequeues it.  It can be stalled for a while
+so the scavenger in MessagingIdle() times out and abandons messages.
+
+Stress test checks:
+  - Tokens are issued in sequence across the 0xFFFFFFFF rollover (so all are unique) and 0 is never issued; only
+    tokens whose status entry holds a live message are skipped
+  - Every message gets exactly one final notification from SetMessageNotification()
+  - The status of a message that has not been notified is WAITING or SENDING (never overwritten)
+  - Payloads arrive intact
+  - Conservation: queue links, counts and byte totals agree, and queued = dequeued + abandoned + still queued
+  - The arena is empty once everything has been sent
+
+Live token test checks (one message held WAITING while STATUS_QUEUE_SIZE * HOST_LIVE_PASSES newer tokens are 
+issued and finished):
+  - No newer token reuses the held message's status entry and its status stays WAITING
+  - The held message is notified exactly once when it finally completes
+  - IssueMessageToken() refuses a token once every status entry is live
+
+Split message test checks (payloads longer than MAX_TX_MESSAGE_LENGTH):
+  - The parts are queued in order with consecutive tokens and the last part's token is returned
+  - No part is longer than MAX_TX_MESSAGE_LENGTH and a part is cut short where the free space wraps
+  - The parts put back together match the payload
+  - A payload larger than the arena is refused with _MESSAGING_TX_QUEUE_FULL and nothing is queued
+
+**********************************************************************************************************************/
+
+#include "configuration.h"
+
+/* The allocator works in the ring these point to: the messaging arena, or the sweep arena during 
+HostAllocatorSweep() */
+static u8* Host_pu8AllocatorBase;
+static u32 Host_u32AllocatorSize = MSG_ARENA_SIZE;
+#define MSG_ALLOCATOR_BASE              Host_pu8AllocatorBase
+#define MSG_ALLOCATOR_SIZE              Host_u32AllocatorSize
+
+#include "messaging.c"
+
+#include <time.h>
+
+
+/***********************************************************************************************************************
+Constants / Definitions
+***********************************************************************************************************************/
+#define HOST_STRESS_ITERATIONS          (u32)1000000   /* Main loop passes run by the stress test */
+#define HOST_STRESS_QUEUES              (u8)3          /* Transmit queues (simulated peripherals) */
+#define HOST_STRESS_PRODUCERS           (u8)6          /* Simulated clients; producer n queues on queue n % HOST_STRESS_QUEUES */
+#define HOST_STRESS_TOKEN_START         (u32)0xFFFFF000 /* First stress token so that the token rolls over early */
+#define HOST_ISR_CHANCE                 (u32)20        /* Percent chance of an interrupt at each injection point */
+#define HOST_LOOPS_PER_MS               (u32)4         /* Main loop passes per simulated ms */
+#define HOST_STALL_CHANCE               (u32)20000     /* 1 in this many main loop passes starts a peripheral stall */
+#define HOST_STALL_MIN_MS               (u32)1200      /* Shortest stall: long enough for the scavenger to act */
+#define HOST_STALL_SPAN_MS              (u32)1500      /* Random extra stall time */
+#define HOST_TRACK_SIZE                 (u32)0x100000  /* Token records: MUST be more than HOST_STRESS_ITERATIONS */
+#define HOST_REFERENCE_SIZE             (u32)256       /* Bytes in the QueueMessageReference() source buffer */
+#define HOST_EVENT_MASK                 (u32)0x00000001 /* Event bit requested with half of the notifications */
+#define HOST_LIVE_PASSES                (u32)3         /* Times the live token test laps the status queue */
+#define HOST_SPLIT_SIZE                 (u32)(MAX_TX_MESSAGE_LENGTH + 76) /* Payload bytes of each split message */
+#define HOST_SPLIT_TOP_SPACE            (u32)256       /* Arena bytes left above the head before the wrapped split */
+#define HOST_SPLIT_TAIL_PAYLOAD         (u32)1200      /* Payload of the block that holds the tail up for the wrapped split */
+
+#define HOST_BENCHMARK_MESSAGES         (u32)200000    /* Messages sent through each benchmark configuration */
+#define HOST_BENCHMARK_MAX_DEPTH        (u32)512       /* Most messages queued at once by the benchmark */
+#define HOST_BENCHMARK_DEPTHS           (u8)5          /* Entries in Host_au32BenchmarkDepths */
+#define HOST_BENCHMARK_DISTRIBUTIONS    (u8)3          /* Entries in Host_asDistributions */
+
+#define HOST_SWEEP_MIN_BLOCKS           (u32)16        /* Smallest pool (blocks held) in the allocator sweep */
+#define HOST_SWEEP_MAX_BLOCKS           (u32)1024      /* Largest pool in the allocator sweep */
+#define HOST_SWEEP_CYCLES               (u32)1000000   /* Release/allocate pairs timed at each pool size */
+#define HOST_SWEEP_PAYLOAD_SIZE         MSG_BENCHMARK_PAYLOAD_SIZE /* Payload bytes of each sweep block */
+#define HOST_SWEEP_ARENA_SIZE           (u32)( (HOST_SWEEP_MAX_BLOCKS + 1) * \
+                                               ((sizeof(MessageBlockType) + HOST_SWEEP_PAYLOAD_SIZE + 3) & ~3) )
+                                                       /* The largest pool plus one block of room to wrap in */
+
+/* Host_u32Failures */
+#define _HOST_FAIL_TOKEN                (u32)0x00000001  /* A token was 0 or out of sequence */
+#define _HOST_FAIL_ROLLOVER             (u32)0x00000002  /* The token did not roll over to 1 */
+#define _HOST_FAIL_NOTIFY               (u32)0x00000004  /* A notification was missing, repeated or for an unknown token */
+#define _HOST_FAIL_STATUS               (u32)0x00000008  /* A status was lost or not as expected */
+#define _HOST_FAIL_DATA                 (u32)0x00000010  /* A payload was corrupted */
+#define _HOST_FAIL_CONSERVATION         (u32)0x00000020  /* Queue links, counts or arena totals disagreed */
+#define _HOST_FAIL_FLAGS                (u32)0x00000040  /* DeQueueMessage() reported an error */
+#define _HOST_FAIL_SELFTEST             (u32)0x00000080  /* MessagingSelfTest() failed */
+#define _HOST_FAIL_LIVE                 (u32)0x00000100  /* A live status entry was reused or a token was not refused */
+#define _HOST_FAIL_SPLIT                (u32)0x00000200  /* A split message was not queued, sent or refused correctly */
+/* end Host_u32Failures */
+
+
+/**********************************************************************************************************************
+Type Definitions
+**********************************************************************************************************************/
+/* What the stress test knows about one token */
+typedef struct
+{
+  u32 u32Token;                         /* Token that owns the record; 0 if never used */
+  u8 u8Notifications;                   /* Final notifications received */
+  u8 u8FinalState;                      /* MessageStateType of the first notification */
+  bool bSkipped;                        /* TRUE if the token was skipped because its status entry was live */
+} HostTokenRecordType;
+
+/* A message size distribution for the benchmark */
+typedef struct
+{
+  const char* pcName;                   /* Printed name */
+  u32 (*pfnSize)(void);                 /* Returns the next payload size */
+} HostDistributionType;
+
+
+/***********************************************************************************************************************
+Global variable definitions
+***********************************************************************************************************************/
+/* Stand-ins for the variables messaging.c takes from main.c and the board file */
+volatile u32 G_u32SystemFlags;
+volatile u32 G_u32ApplicationFlags;
+volatile u32 G_u32SystemTime1ms;
+volatile u32 G_u32SystemTime1s;
+HostNvicType Host_sNvic;
+
+static bool Host_bExclusive;                             /* Simulated local exclusive monitor */
+static bool Host_bInIsr;                                 /* TRUE while the simulated ISR runs (it is not nested) */
+static u32 Host_u32IsrChance;                            /* Percent chance of an interrupt at each injection point */
+static u32 Host_u32Random = 0x12345678;                  /* HostRandom() state */
+static u32 Host_u32Interrupts;                           /* Simulated interrupts taken */
+static u32 Host_u32StrexFails;                           /* STREX failures caused by them */
+
+static MessageQueueType Host_asQueues[HOST_STRESS_QUEUES];  /* Stress test transmit queues */
+static MessageType* Host_apsChained[HOST_STRESS_QUEUES];    /* Message each queue's simulated PDC has chained; NULL if none */
+static u32 Host_au32ChainedToken[HOST_STRESS_QUEUES];       /* Token of that message when it was chained */
+static HostTokenRecordType Host_asTokens[HOST_TRACK_SIZE];  /* Stress test token records indexed by token */
+static u8 Host_au8ReferenceData[HOST_REFERENCE_SIZE];       /* Source of every reference message: byte n is n */
+static volatile u32 Host_u32EventFlags;                     /* Event flag register given to SetMessageNotification() */
+static u32 Host_u32Queued;                                  /* Messages accepted by QueueMessage/QueueMessageReference */
+static u32 Host_u32Dequeued;                                /* Messages sent by the simulated ISR */
+static u32 Host_u32Failures;                                /* _HOST_FAIL_x flags */
+
+static const u32 Host_au32BenchmarkDepths[HOST_BENCHMARK_DEPTHS] = {1, 8, 32, 128, HOST_BENCHMARK_MAX_DEPTH};
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+static u32 HostRandom(void);
+static void HostInterruptPoint(void);
+static void HostServiceQueue(u8 u8Queue_);
+static void HostPeripheralIsr(void);
+static void HostNotify(u32 u32Token_, MessageStateType eState_);
+static void HostCheckConservation(void);
+static u32 HostPredictToken(void);
+static void HostSkipTokens(u32* pu32ExpectedToken_, u32 u32NextToken_, bool* pbRolledOver_);
+static u32 HostStressSize(void);
+static u32 HostStressTest(void);
+static void HostLiveTokenTest(void);
+static u32 HostSendSplit(MessageQueueType* psQueue_, u8* pu8Data_, u32 u32Size_, u32 u32Token_);
+static void HostSplitTest(void);
+static u32 HostSizeFixed16(void);
+static u32 HostSizeUniform256(void);
+static u32 HostSizeBimodal(void);
+static u32 HostNowNs(void);
+static void HostBenchmark(void);
+static void HostAllocatorSweep(void);
+
+static const HostDistributionType Host_asDistributions[HOST_BENCHMARK_DISTRIBUTIONS] =
+{
+  {"16 bytes", HostSizeFixed16},
+  {"0-256 bytes", HostSizeUniform256},
+  {"90% 8 / 10% 512 bytes", HostSizeBimodal}
+};
+
+
+/**********************************************************************************************************************
+Function Definitions
+**********************************************************************************************************************/
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Exclusive access stand-ins */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: __LDREXW()
+
+Description:
+Loads a word and opens the simulated exclusive monitor.  An interrupt may be taken straight afterwards, which
+clears the monitor so the caller's STREX fails.
+
+Requires:
+  - pu32Address_ is word aligned
+
+Promises:
+  - Returns *pu32Address_ as it was before any injected interrupt
+*/
+u32 __LDREXW(volatile u32* pu32Address_)
+{
+  u32 u32Value = *pu32Address_;
+
+  Host_bExclusive = TRUE;
+  HostInterruptPoint();
+
+  return(u32Value);
+
+} /* end __LDREXW() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: __STREXW()
+
+Description:
+Stores a word if the simulated exclusive monitor is still open.  An interrupt may be taken after a successful store.
+
+Requires:
+  - __LDREXW() or __LDREXB() was called first
+
+Promises:
+  - Returns 0 and *pu32Address_ = u32Value_ if no interrupt was taken since the load
+  - Returns 1 with *pu32Address_ unchanged otherwise
+*/
+u32 __STREXW(u32 u32Value_, volatile u32* pu32Address_)
+{
+  if(!Host_bExclusive)
+  {
+    Host_u32StrexFails++;
+    return(1);
+  }
+
+  *pu32Address_ = u32Value_;
+  Host_bExclusive = FALSE;
+  HostInterruptPoint();
+
+  return(0);
+
+} /* end __STREXW() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: __LDREXB()
+
+Description:
+Byte version of __LDREXW().
+
+Requires:
+  -
+
+Promises:
+  - Returns *pu8Address_ as it was before any injected interrupt
+*/
+u8 __LDREXB(volatile u8* pu8Address_)
+{
+  u8 u8Value = *pu8Address_;
+
+  Host_bExclusive = TRUE;
+  HostInterruptPoint();
+
+  return(u8Value);
+
+} /* end __LDREXB() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: __STREXB()
+
+Description:
+Byte version of __STREXW().
+
+Requires:
+  - __LDREXB() was called first
+
+Promises:
+  - Returns 0 and *pu8Address_ = u8Value_ if no interrupt was taken since the load
+  - Returns 1 with *pu8Address_ unchanged otherwise
+*/
+u32 __STREXB(u8 u8Value_, volatile u8* pu8Address_)
+{
+  if(!Host_bExclusive)
+  {
+    Host_u32StrexFails++;
+    return(1);
+  }
+
+  *pu8Address_ = u8Value_;
+  Host_bExclusive = FALSE;
+  HostInterruptPoint();
+
+  return(0);
+
+} /* end __STREXB() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Simulated peripheral */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostRandom()
+
+Description:
+xorshift32 pseudo random numbers so every run is the same.
+
+Requires:
+  -
+
+Promises:
+  - Returns the next number in the sequence
+*/
+static u32 HostRandom(void)
+{
+  Host_u32Random ^= Host_u32Random << 13;
+  Host_u32Random ^= Host_u32Random >> 17;
+  Host_u32Random ^= Host_u32Random << 5;
+
+  return(Host_u32Random);
+
+} /* end HostRandom() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostInterruptPoint()
+
+Description:
+A point where the main loop can be interrupted.  With Host_u32IsrChance percent probability the simulated ISR runs
+and, like exception entry and return on the Cortex-M3, clears the exclusive monitor.
+
+Requires:
+  -
+
+Promises:
+  - HostPeripheralIsr() may have run; if it did Host_bExclusive is FALSE
+*/
+static void HostInterruptPoint(void)
+{
+  if( Host_bInIsr || (Host_u32IsrChance == 0) || ((HostRandom() % 100) >= Host_u32IsrChance) )
+  {
+    return;
+  }
+
+  Host_bInIsr = TRUE;
+  HostPeripheralIsr();
+  Host_bInIsr = FALSE;
+
+  Host_bExclusive = FALSE;
+  Host_u32Interrupts++;
+
+} /* end HostInterruptPoint() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostServiceQueue()
+
+Description:
+Finishes the head message of a queue the way a PDC peripheral ISR does, then loads the new head.  A quarter of the
+time the message behind the new head is also chained (marked SENDING), as the UART does with its next-pointer
+registers.  The PDC cannot be told that the scavenger reclaimed a chained message, so the chained message must be
+the next head.
+
+Requires:
+  - u8Queue_ is the index of a stress queue
+  - Called as the queue's consumer (Host_bInIsr is TRUE or no interrupts are enabled)
+
+Promises:
+  - If the queue had a message: its payload is checked, it is COMPLETE and it has been dequeued
+  - Any new head is SENDING and the message behind it may be chained
+*/
+static void HostServiceQueue(u8 u8Queue_)
+{
+  MessageQueueType* psQueue = &Host_asQueues[u8Queue_];
+  MessageType* psMessage = psQueue->psHead;
+  MessageType* psNext;
+  u32 u32Offset;
+
+  if(psMessage == NULL)
+  {
+    return;
+  }
+
+  /* A message queued on an idle peripheral is loaded here */
+  if( !((MessageBlockType*)psMessage)->bSending )
+  {
+    MarkMessageSending(psMessage);
+  }
+
+  /* Copied payloads hold the token's low byte plus the offset; references point at Host_au8ReferenceData */
+  u32Offset = (u32)psMessage->pu8Data - (u32)&Msg_au32Arena[0];
+  for(u32 i = 0; i < psMessage->u32Size; i++)
+  {
+    if( ( (u32Offset < MSG_ARENA_SIZE) && (psMessage->pu8Data[i] != (u8)(psMessage->u32Token + i)) ) ||
+        ( (u32Offset >= MSG_ARENA_SIZE) && ( (psMessage->pu8Data != Host_au8ReferenceData) || (psMessage->pu8Data[i] != (u8)i) ) ) )
+    {
+      Host_u32Failures |= _HOST_FAIL_DATA;
+    }
+  }
+
+  UpdateMessageStatus(psMessage->u32Token, COMPLETE);
+  DeQueueMessage(psQueue);
+  Host_u32Dequeued++;
+
+  /* The PDC moves straight on to a chained message, so it must be the new head and still hold its token */
+  psMessage = psQueue->psHead;
+  if( (Host_apsChained[u8Queue_] != NULL) && 
+      ( (Host_apsChained[u8Queue_] != psMessage) || (psMessage->u32Token != Host_au32ChainedToken[u8Queue_]) ) )
+  {
+    Host_u32Failures |= _HOST_FAIL_DATA;
+  }
+  Host_apsChained[u8Queue_] = NULL;
+
+  if(psMessage == NULL)
+  {
+    return;
+  }
+
+  if( !((MessageBlockType*)psMessage)->bSending )
+  {
+    MarkMessageSending(psMessage);
+  }
+
+  psNext = (MessageType*)psMessage->psNextMessage;
+  if( (psNext != NULL) && ((HostRandom() & 0x03) == 0) )
+  {
+    MarkMessageSending(psNext);
+    Host_apsChained[u8Queue_] = psNext;
+    Host_au32ChainedToken[u8Queue_] = psNext->u32Token;
+  }
+
+} /* end HostServiceQueue() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostPeripheralIsr()
+
+Description:
+The simulated transmit-complete interrupt: services a random stress queue.
+
+Requires:
+  - Host_bInIsr is TRUE
+
+Promises:
+  - See HostServiceQueue()
+*/
+static void HostPeripheralIsr(void)
+{
+  HostServiceQueue( (u8)(HostRandom() % HOST_STRESS_QUEUES) );
+
+} /* end HostPeripheralIsr() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostNotify()
+
+Description:
+Notification callback registered for every stress message.  Counts the notifications per token.
+
+Requires:
+  - u32Token_ was queued by the stress test
+
+Promises:
+  - The token's record is updated; _HOST_FAIL_NOTIFY is set for a repeat, an unknown token or a non-final state
+*/
+static void HostNotify(u32 u32Token_, MessageStateType eState_)
+{
+  HostTokenRecordType* psRecord = &Host_asTokens[u32Token_ % HOST_TRACK_SIZE];
+
+  if( (psRecord->u32Token != u32Token_) || (psRecord->u8Notifications != 0) ||
+      ( (eState_ != COMPLETE) && (eState_ != TIMEOUT) && (eState_ != ABANDONED) ) )
+  {
+    Host_u32Failures |= _HOST_FAIL_NOTIFY;
+  }
+
+  psRecord->u8Notifications++;
+  psRecord->u8FinalState = eState_;
+
+} /* end HostNotify() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostCheckConservation()
+
+Description:
+Walks every stress queue and checks that the links, counts and byte totals agree with each other, with the arena
+and with the number of messages queued, sent and abandoned.
+
+Requires:
+  - Called from the main loop between messaging calls
+
+Promises:
+  - _HOST_FAIL_CONSERVATION is set if anything disagrees
+*/
+static void HostCheckConservation(void)
+{
+  MessageType* psMessage;
+  MessageType* psLast;
+  u32 u32Count;
+  u32 u32Bytes;
+  u32 u32TotalCount = 0;
+  u32 u32TotalBytes = 0;
+
+  for(u8 i = 0; i < HOST_STRESS_QUEUES; i++)
+  {
+    u32Count = 0;
+    u32Bytes = 0;
+    psLast = NULL;
+    for(psMessage = Host_asQueues[i].psHead; psMessage != NULL; psMessage = (MessageType*)psMessage->psNextMessage)
+    {
+      u32Count++;
+      u32Bytes += ((MessageBlockType*)psMessage)->u32BlockSize;
+      psLast = psMessage;
+    }
+
+    if( (u32Count != Host_asQueues[i].u32Count) || (u32Bytes != Host_asQueues[i].u32BytesUsed) ||
+        (psLast != Host_asQueues[i].psTail) )
+    {
+      Host_u32Failures |= _HOST_FAIL_CONSERVATION;
+    }
+
+    u32TotalCount += u32Count;
+    u32TotalBytes += u32Bytes;
+  }
+
+  if( (u32TotalCount != (Host_u32Queued - Host_u32Dequeued - Msg_sScavengerStats.u32Abandoned)) ||
+      (u32TotalCount > Msg_u16QueuedMessageCount) || (u32TotalBytes > ArenaBytesUsed()) )
+  {
+    Host_u32Failures |= _HOST_FAIL_CONSERVATION;
+  }
+
+} /* end HostCheckConservation() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Stress test */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostPredictToken()
+
+Description:
+Works out the token the next QueueMessage() will be given: the first token from Msg_u32Token whose status entry is
+not live.  There is no interrupt point between this and the IssueMessageToken() call inside QueueMessage(), so the
+prediction is exact and the payload can be built from the token before it is queued.
+
+Requires:
+  - Called from the main loop just before QueueMessage()
+
+Promises:
+  - Returns the token that will be issued if the message is accepted
+*/
+static u32 HostPredictToken(void)
+{
+  u32 u32Token = Msg_u32Token;
+
+  for(u16 i = 0; (i < STATUS_QUEUE_SIZE) && MessageStatusIsLive(u32Token); i++)
+  {
+    if(++u32Token == 0)
+    {
+      u32Token = 1;
+    }
+  }
+
+  return(u32Token);
+
+} /* end HostPredictToken() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostSkipTokens()
+
+Description:
+Records the tokens from *pu32ExpectedToken_ up to u32NextToken_ as skipped.  They were passed over because their
+status entry was live, so they are never queued or notified.
+
+Requires:
+  - u32NextToken_ is the token that was issued, or Msg_u32Token if none was
+
+Promises:
+  - Each skipped token has a record with bSkipped = TRUE
+  - *pu32ExpectedToken_ = u32NextToken_; *pbRolledOver_ is set if the token passed 0
+*/
+static void HostSkipTokens(u32* pu32ExpectedToken_, u32 u32NextToken_, bool* pbRolledOver_)
+{
+  HostTokenRecordType* psRecord;
+
+  while(*pu32ExpectedToken_ != u32NextToken_)
+  {
+    psRecord = &Host_asTokens[*pu32ExpectedToken_ % HOST_TRACK_SIZE];
+    psRecord->u32Token = *pu32ExpectedToken_;
+    psRecord->u8Notifications = 0;
+    psRecord->bSkipped = TRUE;
+
+    if(++(*pu32ExpectedToken_) == 0)
+    {
+      *pu32ExpectedToken_ = 1;
+      *pbRolledOver_ = TRUE;
+    }
+  }
+
+} /* end HostSkipTokens() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostStressSize()
+
+Description:
+Payload size for a stress message: mostly small with the odd large one so the arena wraps and fills.
+
+Requires:
+  -
+
+Promises:
+  - Returns 0 to 512
+*/
+static u32 HostStressSize(void)
+{
+  u32 u32Random = HostRandom();
+
+  if( (u32Random & 0x0F) == 0 )
+  {
+    return(256 + ((u32Random >> 8) % 257));
+  }
+
+  return( (u32Random >> 8) % 65 );
+
+} /* end HostStressSize() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostStressTest()
+
+Description:
+HOST_STRESS_PRODUCERS clients queue copied and reference messages of random sizes on HOST_STRESS_QUEUES queues
+(HIGH, NORMAL with a quota and LOW with a quota) while the simulated ISR sends them and the scavenger runs every
+simulated ms.  Now and then the peripheral stalls for longer than MSG_STATUS_WAITING_TIME.  At the end the ISR is
+stopped, everything is sent and the arena must be empty.
+
+Requires:
+  - MessagingInitialize() has run and nothing is queued
+
+Promises:
+  - Returns Host_u32Failures (0 on a pass)
+*/
+static u32 HostStressTest(void)
+{
+  HostTokenRecordType* psRecord;
+  MessageQueueType* psQueue;
+  u8 au8Data[MAX_TX_MESSAGE_LENGTH];
+  u32 u32ExpectedToken = HOST_STRESS_TOKEN_START;
+  u32 u32FirstToken = HOST_STRESS_TOKEN_START;
+  u32 u32StallEnd = 0;
+  u32 u32Random;
+  u32 u32Token;
+  u32 u32Predicted;
+  u32 u32Size;
+  u32 u32Refused = 0;
+  u32 u32Skipped;
+  bool bStalled = FALSE;
+  bool bRolledOver = FALSE;
+
+  for(u32 i = 0; i < HOST_REFERENCE_SIZE; i++)
+  {
+    Host_au8ReferenceData[i] = (u8)i;
+  }
+
+  for(u8 i = 0; i < HOST_STRESS_QUEUES; i++)
+  {
+    InitializeMessageQueue(&Host_asQueues[i]);
+    RegisterMessageQueue(&Host_asQueues[i]);
+  }
+  SetMessageQueuePriority(&Host_asQueues[0], MSG_PRIORITY_HIGH, 0);
+  SetMessageQueuePriority(&Host_asQueues[1], MSG_PRIORITY_NORMAL, MSG_ARENA_SIZE / 2);
+  SetMessageQueuePriority(&Host_asQueues[2], MSG_PRIORITY_LOW, MSG_ARENA_SIZE / 4);
+
+  Msg_u32Token = HOST_STRESS_TOKEN_START;
+  Host_u32IsrChance = HOST_ISR_CHANCE;
+
+  for(u32 u32Pass = 0; u32Pass < HOST_STRESS_ITERATIONS; u32Pass++)
+  {
+    u32Random = HostRandom();
+    psQueue = &Host_asQueues[(u32Random % HOST_STRESS_PRODUCERS) % HOST_STRESS_QUEUES];
+
+    switch( (u32Random >> 8) & 0x0F )
+    {
+      /* Query a recent message: it must still be tracked unless it has been notified */
+      case 0:
+      {
+        u32Token = u32ExpectedToken - 1 - ((u32Random >> 16) & 0x3F);
+        psRecord = &Host_asTokens[u32Token % HOST_TRACK_SIZE];
+        if( (u32Token != 0) && (psRecord->u32Token == u32Token) && !psRecord->bSkipped && 
+            (psRecord->u8Notifications == 0) )
+        {
+          switch(QueryMessageStatus(u32Token))
+          {
+            case WAITING:
+            case SENDING:
+              break;
+
+            default:
+              Host_u32Failures |= _HOST_FAIL_STATUS;
+              break;
+          }
+        }
+        break;
+      }
+
+      case 1:
+      {
+        HostCheckConservation();
+        break;
+      }
+
+      /* Give the peripheral time to catch up */
+      case 2:
+      case 3:
+      case 4:
+      case 5:
+      case 6:
+      case 7:
+      case 8:
+      case 9:
+      {
+        break;
+      }
+
+      /* Everything else queues a message */
+      default:
+      {
+        u32Size = HostStressSize();
+        u32Predicted = HostPredictToken();
+        if( ((u32Random >> 16) & 0x07) == 0 )
+        {
+          u32Token = QueueMessageReference(psQueue, (u32Size % HOST_REFERENCE_SIZE) + 1, Host_au8ReferenceData);
+        }
+        else
+        {
+          for(u32 i = 0; i < u32Size; i++)
+          {
+            au8Data[i] = (u8)(u32Predicted + i);
+          }
+          u32Token = QueueMessage(psQueue, u32Size, au8Data);
+        }
+
+        /* A refusal for want of a status entry also uses up tokens */
+        if(u32Token == 0)
+        {
+          HostSkipTokens(&u32ExpectedToken, Msg_u32Token, &bRolledOver);
+          u32Refused++;
+          break;
+        }
+
+        if(u32Token != u32Predicted)
+        {
+          Host_u32Failures |= _HOST_FAIL_TOKEN;
+        }
+        HostSkipTokens(&u32ExpectedToken, u32Token, &bRolledOver);
+        if(++u32ExpectedToken == 0)
+        {
+          u32ExpectedToken = 1;
+          bRolledOver = TRUE;
+        }
+
+        Host_u32Queued++;
+        psRecord = &Host_asTokens[u32Token % HOST_TRACK_SIZE];
+        psRecord->u32Token = u32Token;
+        psRecord->u8Notifications = 0;
+        psRecord->bSkipped = FALSE;
+
+        /* The ISR may already have sent it, in which case the notification is delivered right away */
+        if( !SetMessageNotification(u32Token, HostNotify, (u32Random & 0x80000000) ? &Host_u32EventFlags : NULL, HOST_EVENT_MASK) )
+        {
+          Host_u32Failures |= _HOST_FAIL_STATUS;
+        }
+        break;
+      }
+    } /* end switch */
+
+    HostInterruptPoint();
+
+    /* Simulated ms tick */
+    if( (u32Pass % HOST_LOOPS_PER_MS) == 0 )
+    {
+      G_u32SystemTime1ms++;
+      MessagingIdle();
+
+      if(bStalled && (G_u32SystemTime1ms == u32StallEnd))
+      {
+        bStalled = FALSE;
+        Host_u32IsrChance = HOST_ISR_CHANCE;
+      }
+      else if(!bStalled && ((HostRandom() % (HOST_STALL_CHANCE / HOST_LOOPS_PER_MS)) == 0) )
+      {
+        bStalled = TRUE;
+        Host_u32IsrChance = 0;
+        u32StallEnd = G_u32SystemTime1ms + HOST_STALL_MIN_MS + (HostRandom() % HOST_STALL_SPAN_MS);
+      }
+    }
+  }
+
+  /* Stop interrupts and send everything that is left */
+  Host_u32IsrChance = 0;
+  for(u8 i = 0; i < HOST_STRESS_QUEUES; i++)
+  {
+    while(Host_asQueues[i].psHead != NULL)
+    {
+      HostServiceQueue(i);
+    }
+  }
+  HostCheckConservation();
+
+  if(!MessagingIsIdle() || (Msg_u32ArenaHead != Msg_u32ArenaTail))
+  {
+    Host_u32Failures |= _HOST_FAIL_CONSERVATION;
+  }
+
+  /* Every message has been notified exactly once and every skipped token never */
+  u32Skipped = 0;
+  for(u32 u32Check = u32FirstToken; u32Check != u32ExpectedToken; u32Check++)
+  {
+    if(u32Check == 0)
+    {
+      continue;
+    }
+
+    psRecord = &Host_asTokens[u32Check % HOST_TRACK_SIZE];
+    if( (psRecord->u32Token != u32Check) || (psRecord->u8Notifications != (psRecord->bSkipped ? 0 : 1)) )
+    {
+      Host_u32Failures |= _HOST_FAIL_NOTIFY;
+    }
+    
+    if(psRecord->bSkipped)
+    {
+      u32Skipped++;
+    }
+  }
+
+  if(!bRolledOver)
+  {
+    Host_u32Failures |= _HOST_FAIL_ROLLOVER;
+  }
+
+  if( (G_u32MessagingFlags & (_DEQUEUE_GOT_NULL | _DEQUEUE_MSG_NOT_FOUND)) ||
+      ( (Host_u32EventFlags & HOST_EVENT_MASK) == 0 ) )
+  {
+    Host_u32Failures |= _HOST_FAIL_FLAGS;
+  }
+
+  printf("Stress: %u passes, %u queued, %u refused, %u sent, %u timed out, %u abandoned, %u statuses aged\n",
+         (unsigned)HOST_STRESS_ITERATIONS, (unsigned)Host_u32Queued, (unsigned)u32Refused, (unsigned)Host_u32Dequeued,
+         (unsigned)Msg_sScavengerStats.u32TimedOut, (unsigned)Msg_sScavengerStats.u32Abandoned,
+         (unsigned)Msg_sScavengerStats.u32StatusesAged);
+  printf("        %u interrupts, %u STREX retries, tokens 0x%08X to 0x%08X (%u skipped)\n",
+         (unsigned)Host_u32Interrupts, (unsigned)Host_u32StrexFails, (unsigned)u32FirstToken, (unsigned)(u32ExpectedToken - 1),
+         (unsigned)u32Skipped);
+
+  return(Host_u32Failures);
+
+} /* end HostStressTest() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostLiveTokenTest()
+
+Description:
+Holds one IssueMessageToken() message WAITING, as a TWI message on a stuck bus would, while HOST_LIVE_PASSES laps
+of the status queue worth of newer queued messages and issued tokens are sent and finished.  None of them may take
+the held message's status entry.  (A held arena message would also stop the arena from wrapping, so the newer 
+queued messages would soon be refused.)  Then every other entry is filled with live issued tokens and 
+the next token must be refused.  Finally the held message completes and must be notified exactly once.  The 
+simulated time does not move, so the scavenger plays no part.
+
+Requires:
+  - Nothing is queued and no simulated interrupts are enabled
+
+Promises:
+  - _HOST_FAIL_LIVE or _HOST_FAIL_NOTIFY is set in Host_u32Failures if a check fails
+*/
+static void HostLiveTokenTest(void)
+{
+  static MessageQueueType sBusyQueue;
+  static u32 au32Issued[STATUS_QUEUE_SIZE];
+  HostTokenRecordType* psRecord;
+  u8 au8Data[16] = {0};
+  u32 u32Failures = 0;
+  u32 u32Held;
+  u32 u32Token;
+  u32 u32Tokens = 0;
+
+  Host_u32IsrChance = 0;
+  InitializeTestQueue(&sBusyQueue);
+
+  u32Held = IssueMessageToken(MSG_NO_QUEUE_ID);
+  psRecord = &Host_asTokens[u32Held % HOST_TRACK_SIZE];
+  psRecord->u32Token = u32Held;
+  psRecord->u8Notifications = 0;
+  psRecord->bSkipped = FALSE;
+  if( (u32Held == 0) || !SetMessageNotification(u32Held, HostNotify, NULL, 0) )
+  {
+    u32Failures |= _HOST_FAIL_LIVE;
+  }
+
+  /* Newer messages and issued tokens come and go many times past the held one */
+  for(u32 i = 0; i < (HOST_LIVE_PASSES * STATUS_QUEUE_SIZE); i++)
+  {
+    if(i & 0x01)
+    {
+      u32Token = IssueMessageToken(MSG_NO_QUEUE_ID);
+      UpdateMessageStatus(u32Token, SENDING);
+      UpdateMessageStatus(u32Token, COMPLETE);
+    }
+    else
+    {
+      u32Token = QueueMessage(&sBusyQueue, sizeof(au8Data), au8Data);
+      if(sBusyQueue.psHead != NULL)
+      {
+        MarkMessageSending(sBusyQueue.psHead);
+        UpdateMessageStatus(u32Token, COMPLETE);
+        DeQueueMessage(&sBusyQueue);
+      }
+    }
+
+    if( (u32Token == 0) || ( (u32Token & STATUS_QUEUE_MASK) == (u32Held & STATUS_QUEUE_MASK) ) ||
+        (QueryMessageStatus(u32Token) != COMPLETE) )
+    {
+      u32Failures |= _HOST_FAIL_LIVE;
+    }
+  }
+
+  if(QueryMessageStatus(u32Held) != WAITING)
+  {
+    u32Failures |= _HOST_FAIL_LIVE;
+  }
+
+  /* With every other entry live the next token must be refused */
+  for(u32 i = 0; i < (STATUS_QUEUE_SIZE - 1); i++)
+  {
+    au32Issued[i] = IssueMessageToken(MSG_NO_QUEUE_ID);
+    if(au32Issued[i] == 0)
+    {
+      u32Failures |= _HOST_FAIL_LIVE;
+    }
+  }
+
+  G_u32MessagingFlags &= ~_MESSAGING_TX_QUEUE_FULL;
+  if( (IssueMessageToken(MSG_NO_QUEUE_ID) != 0) || !(G_u32MessagingFlags & _MESSAGING_TX_QUEUE_FULL) )
+  {
+    u32Failures |= _HOST_FAIL_LIVE;
+  }
+  G_u32MessagingFlags &= ~_MESSAGING_TX_QUEUE_FULL;
+
+  for(u32 i = 0; i < (STATUS_QUEUE_SIZE - 1); i++)
+  {
+    UpdateMessageStatus(au32Issued[i], COMPLETE);
+    QueryMessageStatus(au32Issued[i]);
+    u32Tokens++;
+  }
+
+  /* The held message is finally sent */
+  UpdateMessageStatus(u32Held, SENDING);
+  UpdateMessageStatus(u32Held, COMPLETE);
+  if( (QueryMessageStatus(u32Held) != COMPLETE) || (psRecord->u8Notifications != 1) )
+  {
+    u32Failures |= _HOST_FAIL_NOTIFY;
+  }
+
+  ReclaimMessageBlocks();
+  if(!MessagingIsIdle())
+  {
+    u32Failures |= _HOST_FAIL_LIVE;
+  }
+
+  u32Tokens += HOST_LIVE_PASSES * STATUS_QUEUE_SIZE;
+  printf("Live token: 0x%08X held while %u newer tokens were issued (%u status entries): 0x%02X\n",
+         (unsigned)u32Held, (unsigned)u32Tokens, (unsigned)STATUS_QUEUE_SIZE, (unsigned)u32Failures);
+  Host_u32Failures |= u32Failures;
+
+} /* end HostLiveTokenTest() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostSendSplit()
+
+Description:
+Sends every message in a split message test queue and checks the parts against the payload they came from.
+
+Requires:
+  - psQueue_ holds only the parts of one message, queued from pu8Data_ with u32Size_ bytes
+  - u32Token_ is the token QueueMessage() returned
+
+Promises:
+  - The queue is emptied and every part is COMPLETE
+  - Returns the number of parts, or 0 if the parts were not in order, did not match the payload or the last token
+    was not u32Token_
+*/
+static u32 HostSendSplit(MessageQueueType* psQueue_, u8* pu8Data_, u32 u32Size_, u32 u32Token_)
+{
+  MessageType* psMessage;
+  u32 u32Parts = 0;
+  u32 u32Offset = 0;
+  u32 u32LastToken = 0;
+  bool bGood = TRUE;
+
+  while(psQueue_->psHead != NULL)
+  {
+    psMessage = psQueue_->psHead;
+    if( (psMessage->u32Size == 0) || (psMessage->u32Size > MAX_TX_MESSAGE_LENGTH) ||
+        ( (u32Offset + psMessage->u32Size) > u32Size_ ) ||
+        (memcmp(psMessage->pu8Data, pu8Data_ + u32Offset, psMessage->u32Size) != 0) ||
+        ( (u32LastToken != 0) && (psMessage->u32Token != (u32LastToken + 1)) ) )
+    {
+      bGood = FALSE;
+    }
+
+    u32Offset += psMessage->u32Size;
+    u32LastToken = psMessage->u32Token;
+    u32Parts++;
+
+    MarkMessageSending(psMessage);
+    UpdateMessageStatus(u32LastToken, COMPLETE);
+    DeQueueMessage(psQueue_);
+    if(QueryMessageStatus(u32LastToken) != COMPLETE)
+    {
+      bGood = FALSE;
+    }
+  }
+
+  if( !bGood || (u32Offset != u32Size_) || (u32LastToken != u32Token_) )
+  {
+    return(0);
+  }
+
+  return(u32Parts);
+
+} /* end HostSendSplit() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostSplitTest()
+
+Description:
+Queues payloads longer than MAX_TX_MESSAGE_LENGTH.  The first goes in to an empty arena and must be split in 
+MAX_TX_MESSAGE_LENGTH parts.  For the second, blocks are allocated so that only HOST_SPLIT_TOP_SPACE bytes are 
+left above the head and the tail is held up by a released block below it: the first part must stop at the top of 
+the arena and the rest wrap to the bottom.  Last, a payload larger than the arena must be refused without queueing
+any part.
+
+Requires:
+  - Nothing is queued and no simulated interrupts are enabled
+
+Promises:
+  - _HOST_FAIL_SPLIT is set in Host_u32Failures if a check fails
+*/
+static void HostSplitTest(void)
+{
+  static MessageQueueType sSplitQueue;
+  static u8 au8Data[MSG_ARENA_SIZE + 1];
+  MessageBlockType* psTailBlock;
+  MessageBlockType* psHeadBlock;
+  u32 u32Failures = 0;
+  u32 u32Token;
+  u32 u32Parts;
+  u32 u32WrappedParts = 0;
+
+  Host_u32IsrChance = 0;
+  InitializeTestQueue(&sSplitQueue);
+  for(u32 i = 0; i < sizeof(au8Data); i++)
+  {
+    au8Data[i] = (u8)(i + (i >> 8));
+  }
+
+  /* Empty arena: full size parts */
+  u32Token = QueueMessage(&sSplitQueue, HOST_SPLIT_SIZE, au8Data);
+  u32Parts = HostSendSplit(&sSplitQueue, au8Data, HOST_SPLIT_SIZE, u32Token);
+  if( (u32Token == 0) || 
+      (u32Parts != ( (HOST_SPLIT_SIZE + MAX_TX_MESSAGE_LENGTH - 1) / MAX_TX_MESSAGE_LENGTH )) )
+  {
+    u32Failures |= _HOST_FAIL_SPLIT;
+  }
+
+  /* Leave HOST_SPLIT_TOP_SPACE bytes above the head with free space below the tail */
+  ReclaimMessageBlocks();
+  psTailBlock = AllocateMessageBlock(HOST_SPLIT_TAIL_PAYLOAD);
+  psHeadBlock = AllocateMessageBlock(MSG_ARENA_SIZE - HOST_SPLIT_TOP_SPACE - 
+                                     MessageBlockSize(HOST_SPLIT_TAIL_PAYLOAD) - MessageBlockSize(0));
+  if( (psTailBlock == NULL) || (psHeadBlock == NULL) || (Msg_u32ArenaHead != (MSG_ARENA_SIZE - HOST_SPLIT_TOP_SPACE)) )
+  {
+    u32Failures |= _HOST_FAIL_SPLIT;
+  }
+  else
+  {
+    ReleaseMessageBlock(psTailBlock);
+    u32Token = QueueMessage(&sSplitQueue, HOST_SPLIT_SIZE, au8Data);
+    if( (sSplitQueue.psHead == NULL) || 
+        (sSplitQueue.psHead->u32Size != (HOST_SPLIT_TOP_SPACE - MessageBlockSize(0))) )
+    {
+      u32Failures |= _HOST_FAIL_SPLIT;
+    }
+    
+    u32WrappedParts = HostSendSplit(&sSplitQueue, au8Data, HOST_SPLIT_SIZE, u32Token);
+    if( (u32Token == 0) || (u32WrappedParts < 2) )
+    {
+      u32Failures |= _HOST_FAIL_SPLIT;
+    }
+    ReleaseMessageBlock(psHeadBlock);
+  }
+
+  /* Too large for the arena: nothing may be queued */
+  G_u32MessagingFlags &= ~_MESSAGING_TX_QUEUE_FULL;
+  u32Token = QueueMessage(&sSplitQueue, sizeof(au8Data), au8Data);
+  if( (u32Token != 0) || !(G_u32MessagingFlags & _MESSAGING_TX_QUEUE_FULL) ||
+      (sSplitQueue.u32Count != 0) || (sSplitQueue.psHead != NULL) )
+  {
+    u32Failures |= _HOST_FAIL_SPLIT;
+  }
+  G_u32MessagingFlags &= ~_MESSAGING_TX_QUEUE_FULL;
+
+  ReclaimMessageBlocks();
+  if(!MessagingIsIdle())
+  {
+    u32Failures |= _HOST_FAIL_SPLIT;
+  }
+
+  printf("Split message: %u bytes in %u parts, %u parts across the wrap, %u bytes refused: 0x%02X\n",
+         (unsigned)HOST_SPLIT_SIZE, (unsigned)u32Parts, (unsigned)u32WrappedParts, (unsigned)sizeof(au8Data),
+         (unsigned)u32Failures);
+  Host_u32Failures |= u32Failures;
+
+} /* end HostSplitTest() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* Benchmark */
+/*--------------------------------------------------------------------------------------------------------------------*/
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostSizeFixed16(), HostSizeUniform256(), HostSizeBimodal()
+
+Description:
+Benchmark message size distributions.
+
+Requires:
+  -
+
+Promises:
+  - Returns the next payload size
+*/
+static u32 HostSizeFixed16(void)
+{
+  return(16);
+
+} /* end HostSizeFixed16() */
+
+static u32 HostSizeUniform256(void)
+{
+  return(HostRandom() % 257);
+
+} /* end HostSizeUniform256() */
+
+static u32 HostSizeBimodal(void)
+{
+  if( (HostRandom() % 10) == 0 )
+  {
+    return(512);
+  }
+
+  return(8);
+
+} /* end HostSizeBimodal() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostNowNs()
+
+Description:
+Reads the host monotonic clock.
+
+Requires:
+  -
+
+Promises:
+  - Returns the time in ns (wraps every 4.3 s, so only use differences over short runs)
+*/
+static u32 HostNowNs(void)
+{
+  struct timespec sTime;
+
+  clock_gettime(CLOCK_MONOTONIC, &sTime);
+  return( (u32)( ((u64)sTime.tv_sec * 1000000000u) + (u64)sTime.tv_nsec ) );
+
+} /* end HostNowNs() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostBenchmark()
+
+Description:
+Times QueueMessage, UpdateMessageStatus plus QueryMessageStatus, and DeQueueMessage with no interrupts for each
+size distribution and queue depth.  A depth is reduced to what fits in the arena ("Held" is the most actually 
+queued) and deeper runs are skipped.  Each configuration sends HOST_BENCHMARK_MESSAGES messages.
+
+Requires:
+  - Nothing is queued
+
+Promises:
+  - Prints ns per operation for each phase
+*/
+static void HostBenchmark(void)
+{
+  static MessageQueueType sQueue;
+  static u32 au32Sizes[HOST_BENCHMARK_MAX_DEPTH];
+  static u32 au32Tokens[HOST_BENCHMARK_MAX_DEPTH];
+  static const u8 au8Data[MAX_TX_MESSAGE_LENGTH];
+  u64 u64QueueNs;
+  u64 u64StatusNs;
+  u64 u64DequeueNs;
+  u32 au32Time[4];
+  u32 u32Messages;
+  u32 u32Depth;
+  u32 u32MaxDepth;
+
+  Host_u32IsrChance = 0;
+  InitializeTestQueue(&sQueue);
+
+  printf("\nBenchmark (%u byte arena): ns per message\n", (unsigned)MSG_ARENA_SIZE);
+  printf("%-24s %6s %6s %8s %8s %8s\n", "Sizes", "Depth", "Held", "Queue", "Status", "Dequeue");
+
+  for(u8 i = 0; i < HOST_BENCHMARK_DISTRIBUTIONS; i++)
+  {
+    for(u8 j = 0; j < HOST_BENCHMARK_DEPTHS; j++)
+    {
+      u64QueueNs = 0;
+      u64StatusNs = 0;
+      u64DequeueNs = 0;
+      u32Messages = 0;
+      u32MaxDepth = 0;
+
+      while(u32Messages < HOST_BENCHMARK_MESSAGES)
+      {
+        for(u32 k = 0; k < Host_au32BenchmarkDepths[j]; k++)
+        {
+          au32Sizes[k] = Host_asDistributions[i].pfnSize();
+        }
+
+        au32Time[0] = HostNowNs();
+        for(u32Depth = 0; u32Depth < Host_au32BenchmarkDepths[j]; u32Depth++)
+        {
+          au32Tokens[u32Depth] = QueueMessage(&sQueue, au32Sizes[u32Depth], (u8*)au8Data);
+          if(au32Tokens[u32Depth] == 0)
+          {
+            break;
+          }
+        }
+
+        au32Time[1] = HostNowNs();
+        for(u32 k = 0; k < u32Depth; k++)
+        {
+          UpdateMessageStatus(au32Tokens[k], COMPLETE);
+          QueryMessageStatus(au32Tokens[k]);
+        }
+
+        au32Time[2] = HostNowNs();
+        for(u32 k = 0; k < u32Depth; k++)
+        {
+          DeQueueMessage(&sQueue);
+        }
+        au32Time[3] = HostNowNs();
+
+        u64QueueNs   += au32Time[1] - au32Time[0];
+        u64StatusNs  += au32Time[2] - au32Time[1];
+        u64DequeueNs += au32Time[3] - au32Time[2];
+        u32Messages  += u32Depth;
+        if(u32Depth > u32MaxDepth)
+        {
+          u32MaxDepth = u32Depth;
+        }
+
+        /* The failed QueueMessage was timed too; it is part of running the arena full */
+        if(u32Depth == 0)
+        {
+          break;
+        }
+      }
+
+      if(u32Messages == 0)
+      {
+        continue;
+      }
+
+      printf("%-24s %6u %6u %8.1f %8.1f %8.1f\n", Host_asDistributions[i].pcName,
+             (unsigned)Host_au32BenchmarkDepths[j], (unsigned)u32MaxDepth,
+             (double)u64QueueNs / u32Messages, (double)u64StatusNs / u32Messages, (double)u64DequeueNs / u32Messages);
+      
+      /* Deeper runs would be limited by the arena in the same way */
+      if(u32MaxDepth < Host_au32BenchmarkDepths[j])
+      {
+        break;
+      }
+    }
+  }
+
+  ReclaimMessageBlocks();
+
+} /* end HostBenchmark() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: HostAllocatorSweep()
+
+Description:
+Times the arena allocator with pools of HOST_SWEEP_MIN_BLOCKS to HOST_SWEEP_MAX_BLOCKS blocks held, doubling each 
+time.  The pool is filled, then the oldest block is released and a new one allocated HOST_SWEEP_CYCLES times, so 
+each allocation also reclaims the block released before it.  The allocator is pointed at au32SweepArena for the 
+sweep so every pool size fits whatever MSG_ARENA_SIZE is.  Allocate and release should cost the same at every 
+pool size.
+
+Requires:
+  - Nothing is queued
+
+Promises:
+  - Prints the average ns per allocate or release for each pool size
+  - The allocator is back on the (empty) messaging arena
+*/
+static void HostAllocatorSweep(void)
+{
+  static u32 au32SweepArena[HOST_SWEEP_ARENA_SIZE / 4];
+  static MessageBlockType* apsBlocks[HOST_SWEEP_MAX_BLOCKS];
+  u32 u32Oldest;
+  u32 u32StartTime;
+  bool bFilled;
+
+  if(!MessagingIsIdle())
+  {
+    Host_u32Failures |= _HOST_FAIL_CONSERVATION;
+    return;
+  }
+  
+  /* Move the allocator to the sweep arena; the empty reclaim resets the head, tail and wrap for it */
+  Host_pu8AllocatorBase = (u8*)au32SweepArena;
+  Host_u32AllocatorSize = HOST_SWEEP_ARENA_SIZE;
+  ReclaimMessageBlocks();
+  
+  printf("\nAllocator sweep (%u byte blocks, %u byte arena): ns per allocate or release\n",
+         (unsigned)MessageBlockSize(HOST_SWEEP_PAYLOAD_SIZE), (unsigned)HOST_SWEEP_ARENA_SIZE);
+  printf("%8s %8s\n", "Blocks", "ns/op");
+
+  for(u32 u32Blocks = HOST_SWEEP_MIN_BLOCKS; u32Blocks <= HOST_SWEEP_MAX_BLOCKS; u32Blocks *= 2)
+  {
+    /* Fill the pool */
+    bFilled = TRUE;
+    for(u32 i = 0; (i < u32Blocks) && bFilled; i++)
+    {
+      apsBlocks[i] = AllocateMessageBlock(HOST_SWEEP_PAYLOAD_SIZE);
+      bFilled = (apsBlocks[i] != NULL);
+    }
+
+    if(!bFilled)
+    {
+      printf("%8u  failed to fill\n", (unsigned)u32Blocks);
+      Host_u32Failures |= _HOST_FAIL_CONSERVATION;
+      break;
+    }
+
+    /* Oldest out, new in: the pool size stays at u32Blocks */
+    u32Oldest = 0;
+    u32StartTime = HostNowNs();
+    for(u32 i = 0; i < HOST_SWEEP_CYCLES; i++)
+    {
+      ReleaseMessageBlock(apsBlocks[u32Oldest]);
+      apsBlocks[u32Oldest] = AllocateMessageBlock(HOST_SWEEP_PAYLOAD_SIZE);
+      if(++u32Oldest == u32Blocks)
+      {
+        u32Oldest = 0;
+      }
+    }
+    printf("%8u %8.1f\n", (unsigned)u32Blocks, (double)(u32)(HostNowNs() - u32StartTime) / (2 * HOST_SWEEP_CYCLES));
+
+    /* Empty the pool again; a failed allocation above would show up here */
+    for(u32 i = 0; i < u32Blocks; i++)
+    {
+      if(apsBlocks[i] == NULL)
+      {
+        Host_u32Failures |= _HOST_FAIL_CONSERVATION;
+        continue;
+      }
+      ReleaseMessageBlock(apsBlocks[i]);
+    }
+
+    if(!MessagingIsIdle())
+    {
+      Host_u32Failures |= _HOST_FAIL_CONSERVATION;
+    }
+  }
+
+  /* Back to the messaging arena (a failed fill above may have left blocks in the sweep arena) */
+  Host_pu8AllocatorBase = (u8*)Msg_au32Arena;
+  Host_u32AllocatorSize = MSG_ARENA_SIZE;
+  Msg_u16QueuedMessageCount = 0;
+  ReclaimMessageBlocks();
+
+} /* end HostAllocatorSweep() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+Function: main()
+
+Description:
+Runs the target self test, the stress test, the live token test, the split message test, the benchmark and the 
+allocator sweep.
+
+Promises:
+  - Returns 0 if every check passed, otherwise the _HOST_FAIL_x flags
+*/
+int main(void)
+{
+  u32 u32Result;
+
+  Host_pu8AllocatorBase = (u8*)Msg_au32Arena;
+  MessagingInitialize();
+
+  /* The self test on target is the same code, so run it here first */
+  u32Result = MessagingSelfTest();
+  printf("MessagingSelfTest: 0x%02X\n", (unsigned)u32Result);
+  if(u32Result != 0)
+  {
+    Host_u32Failures |= _HOST_FAIL_SELFTEST;
+  }
+
+  HostStressTest();
+  HostLiveTokenTest();
+  HostSplitTest();
+  HostBenchmark();
+  HostAllocatorSweep();
+
+  printf("\n%s (0x%02X)\n", (Host_u32Failures == 0) ? "PASS" : "FAIL", (unsigned)Host_u32Failures);
+  return( (int)Host_u32Failures );
+
+} /* end main() */
+
+
+/*--------------------------------------------------------------------------------------------------------------------*/
+/* End of File */
+/*--------------------------------------------------------------------------------------------------------------------*/
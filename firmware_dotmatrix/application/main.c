@@ -14,6 +14,8 @@ All Global variable names shall start with "G_"
 /* New variables */
 volatile u32 G_u32SystemFlags = 0;                     /* Global system flags */
 volatile u32 G_u32ApplicationFlags = 0;                /* Global applications flags: set when application is successfully initialized. Bit defs in configuration.h */
+volatile u32 G_u32StartupFlags = 0;                    /* Set by tasks whose startup sequence is still running (G_u32ApplicationFlags bits) */
+volatile u32 G_u32BootTimeMs = 0;                      /* System time in ms when initialization completed */
 
 
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -26,6 +28,7 @@ extern volatile u32 G_u32SystemTime1s;                 /* From board-specific so
 Global variable definitions with scope limited to this local application.
 Variable names shall start with "Main_" and be declared as static.
 ***********************************************************************************************************************/
+static u32 Main_u32StartupTimer;                        /* Deadline reference for the driver startup sequences */
 
 
 /***********************************************************************************************************************
@@ -34,6 +37,9 @@ Main has two sections:
 
 1. Initialization which is run once on power-up or reset.  All drivers and applications are setup here without timing
 contraints but must complete execution regardless of success or failure of starting the application. 
+Drivers that need timed startup steps (resets, power-up delays) set their bit in G_u32StartupFlags and finish the
+steps from their state machines, so the driver tasks run together until all of the bits clear or 
+MAIN_STARTUP_TIMEOUT_MS passes.  Applications are initialized after that.
 
 2. Super loop which runs infinitely giving processor time to each application.  The total loop time should not exceed
 1ms of execution time counting all application execution.  SystemSleep() will execute to complete the remaining time in
@@ -68,12 +74,25 @@ void main(void)
   CapTouchInitialize();
   AntInitialize();
   
+  /* Run the drivers until their startup sequences are done so the resets and delays overlap */
+  Main_u32StartupTimer = G_u32SystemTime1ms;
+  while( G_u32StartupFlags && !IsTimeUp(&Main_u32StartupTimer, MAIN_STARTUP_TIMEOUT_MS) )
+  {
+    WATCHDOG_BONE();
+    MainRunDriverStates();
+
+    HEARTBEAT_OFF();
+    SystemSleep();
+    HEARTBEAT_ON();
+  }
+  
   /* Application initialization */
   UserApp1Initialize();
   UserApp2Initialize();
   UserApp3Initialize();
   
   /* Exit initialization */
+  G_u32BootTimeMs = G_u32SystemTime1ms;
   SystemStatusReport();
   G_u32SystemFlags &= ~_SYSTEM_INITIALIZING;
    
@@ -83,16 +102,7 @@ void main(void)
     WATCHDOG_BONE();
     
     /* Drivers */
-    LedUpdate();
-    ButtonRunActiveState();
-    UartRunActiveState();
-    SspRunActiveState();
-    TWIRunActiveState();
-    CapTouchRunActiveState(); /* This function violates 1ms loop timing every 25ms */ 
-    MessagingRunActiveState();
-    DebugRunActiveState();
-    LcdRunActiveState();
-    AntRunActiveState();
+    MainRunDriverStates();
 
     /* Applications */
     UserApp1RunActiveState();
@@ -109,6 +119,34 @@ void main(void)
 } /* end main() */
 
 
+/*----------------------------------------------------------------------------------------------------------------------
+Function: MainRunDriverStates
+
+Description:
+Runs one iteration of every driver task.  Used by the startup loop and the super loop.
+
+Requires:
+  - All drivers have been initialized
+
+Promises:
+  - Each driver state machine has run once
+*/
+static void MainRunDriverStates(void)
+{
+  LedUpdate();
+  ButtonRunActiveState();
+  UartRunActiveState();
+  SspRunActiveState();
+  TWIRunActiveState();
+  CapTouchRunActiveState(); /* This function violates 1ms loop timing every 25ms */
+  MessagingRunActiveState();
+  DebugRunActiveState();
+  LcdRunActiveState();
+  AntRunActiveState();
+
+} /* end MainRunDriverStates() */
+
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* End of File */
 /*--------------------------------------------------------------------------------------------------------------------*/
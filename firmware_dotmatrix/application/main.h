@@ -37,5 +37,13 @@ Header file for main.c.
 
 #define  SYSTEM_CLOCK_ALL_FLAGS         (u32)0x0000001F        /* Value to set all System Clock flags */
 
+#define MAIN_STARTUP_TIMEOUT_MS         (u32)5000              /* Max time in ms that main waits for G_u32StartupFlags to clear */
+
+
+/**********************************************************************************************************************
+Function Declarations
+**********************************************************************************************************************/
+static void MainRunDriverStates(void);
+
 
 #endif /* __MAIN_H */
\ No newline at end of file
@@ -238,6 +238,7 @@ extern volatile u32 G_u32SystemTime1s;                 /* From board-specific so
 
 extern volatile u32 G_u32SystemFlags;                  /* From main.c */
 extern volatile u32 G_u32ApplicationFlags;             /* From main.c */
+extern volatile u32 G_u32StartupFlags;                 /* From main.c */
 
 extern const u8 G_aau8SmallFonts[][LCD_SMALL_FONT_ROWS][LCD_SMALL_FONT_COLUMN_BYTES];        /* From lcd_bitmaps.c */
 extern const u8 G_aau8BigFonts[][LCD_BIG_FONT_ROWS][LCD_BIG_FONT_COLUMN_BYTES];              /* From lcd_bitmaps.c */
@@ -267,6 +268,8 @@ static SspConfigurationType Lcd_sSspConfig;                       /* Configurati
 static SspPeripheralType* Lcd_Ssp;                                /* Pointer to LCD's SSP peripheral object */
 static u8 Lcd_u8PagesToUpdate;                                    /* Counter for number of pages in current LCD refresh */
 static u8 Lcd_u8CurrentPage;                                      /* Current page being updated */
+static u8 Lcd_u8StartupStep;                                      /* Setup command or image frame the startup states are on */
+static u8 Lcd_u8StartupRow;                                       /* Row offset of the lower logo pieces in the startup animation */
 
 static u8 Lcd_au8TxBuffer[LCD_TX_BUFFER_SIZE];                    /* Buffer for outgoing data to LCD during the current refresh cycle */
 static u8 Lcd_au8RxDummyBuffer[LCD_RX_BUFFER_SIZE];               /* Dummy location for LCD receive buffer (LCD does not send data) */
@@ -276,6 +279,7 @@ static PixelBlockType Lcd_sUpdateArea;                            /* Area of LCD
 static PixelBlockType Lcd_sCurrentUpdateArea;                     /* Area of LCD currently being updated */
 
 static u8 Lcd_au8MessageInit[]  = "LCD Ready\r\n";
+static u8 Lcd_au8MessageTimeout[] = "LCD: transfer timeout\r\n";
 static u8 Lcd_au8MessageWelcome[] = "SAM3U2 DOT MATRIX";
                                  
 static  u8 Lcd_au8SetupArray[] = {LCD_BIAS_LOW, LCD_ADC_SELECT_NORMAL, LCD_COMMON_MODE1, LCD_COMMON_MODE0, LCD_DISPLAY_LINE_SETx,
@@ -661,15 +665,14 @@ bool LcdCommand(u8 u8Command_)
   if( !(Lcd_u32Flags & _LCD_FLAGS_COMMAND_IN_QUEUE) )
   {
     Lcd_u32Flags |= _LCD_FLAGS_COMMAND_IN_QUEUE;
-    Lcd_au8TxBuffer[0] = u8Command_;
   
-    /* Set hardware for command mode and queue the message */
+    /* Set hardware for command mode and queue the message.  The command byte is copied so that
+    Lcd_au8TxBuffer, which the screen refresh transmits in place, is never touched here. */
     LCD_COMMAND_MODE();
-    Lcd_u32CurrentMsgToken = SspWriteData(Lcd_Ssp, 1, &Lcd_au8TxBuffer[0]);
+    Lcd_u32CurrentMsgToken = SspWriteData(Lcd_Ssp, 1, &u8Command_);
     
-    /* Zero the timer so the command sends immediately and push the command out if initializing */
+    /* Zero the timer so the command sends immediately */
     Lcd_u32RefreshTimer = 0;
-    LcdManualMode();
     
     return TRUE;
   }
@@ -687,29 +690,28 @@ bool LcdCommand(u8 u8Command_)
 Function: LcdInitialize
 
 Description:
-Initialize the local LCD RAM then boot and initialize the LCD.  Since so much 
+Initialize the local LCD RAM and start booting the LCD.  Since so much 
 data is transferred to the LCD and speed is essential, LCD transfers are
 generally assumed to work.  Unless critical data is being sent, then no checking
-is done during data transmission.
+is done during data transmission.  The reset timing, setup commands and startup 
+image are handled by the LcdSM_Startup states so the other tasks start up at the
+same time.
+
 Requires:
   - LCD SPI peripheral is initialized and ready for communication
 
 Promises:
   - G_aau8LcdRamImage[LCD_IMAGE_ROWS][LCD_IMAGE_COLUMNS] = 0;
-  - LCD is initialized and turned on
+  - LCD is held in reset and Lcd_pfnStateMachine = LcdSM_StartupReset
+  - _APPLICATION_FLAGS_LCD is set in G_u32StartupFlags until the LCD is initialized and turned on
 */
 void LcdInitialize(void)
 {
-  u8 u8Size;
-  PixelBlockType sEngenuicsImage;
-  PixelAddressType sStringLocation;
-  
   /* Start with backlight on */
   LCD_BACKLIGHT_ON();
   
   /* Initialize variables */
   Lcd_u32RefreshTimer = G_u32SystemTime1ms;
-  Lcd_pfnStateMachine = LcdSM_Idle;
   Lcd_pu8RxDummyBuffer = Lcd_au8RxDummyBuffer;
   
   /* Configure the SSP resource to be used for the application */
@@ -721,10 +723,14 @@ void LcdInitialize(void)
   Lcd_sSspConfig.u16RxBufferSize    = LCD_RX_BUFFER_SIZE;
   Lcd_sSspConfig.eBitOrder           = MSB_FIRST;
   Lcd_sSspConfig.eSspMode            = SPI_MASTER_AUTO_CS;
+  Lcd_sSspConfig.eTxPriority         = MSG_PRIORITY_HIGH;
+  Lcd_sSspConfig.u32TxByteQuota      = 0;
+  Lcd_sSspConfig.u32ModeRegister     = 0;
+  Lcd_sSspConfig.u32BaudRateRegister = 0;
 
   Lcd_Ssp = SspRequest(&Lcd_sSspConfig);
         
-  /* Carry out the prescribed LCD initialization starting with delay after releasing reset */
+  /* Start the prescribed LCD initialization with a reset pulse; LcdSM_StartupReset releases it */
   LCD_CS_ASSERT();
   LCD_RESET_DEASSERT();
   for(u32 i = 0; i < 10; i++);
@@ -732,102 +738,8 @@ void LcdInitialize(void)
   LCD_RESET_ASSERT();
 
   Lcd_u32Timer = G_u32SystemTime1ms;
-  while( !IsTimeUp(&Lcd_u32Timer, 2) );
-
-  LCD_RESET_DEASSERT();
-
-  Lcd_u32Timer = G_u32SystemTime1ms;
-  while( !IsTimeUp(&Lcd_u32Timer, 2) );
- 
-  /* Send settings array one command at a time - end with display and pixel test on */
-  u8Size = sizeof(Lcd_au8SetupArray);
-  for(u8 i = 0; i < u8Size; i++)
-  {
-    LcdCommand(Lcd_au8SetupArray[i]);
-    Lcd_u32Timer = G_u32SystemTime1ms;
-    while( !IsTimeUp(&Lcd_u32Timer, 5) );
-  }
-  
-  /* Clear LCD pixel data */
-  LcdClearPixels(&G_sLcdClearWholeScreen);
-  LcdManualMode();
- 
-  /* Short pixel test */  
-  Lcd_u32Timer = G_u32SystemTime1ms;
-  while( !IsTimeUp(&Lcd_u32Timer, 500) );
-  
-  LcdCommand(LCD_PIXEL_TEST_OFF);
-  
-#if LCD_STARTUP_ANIMATION
-  /* Divide the Engenuics logo up into 4 equal pieces and put them at the corner of the LCD to 
-  ensure that the full range of pixels is being addressed correctly */
-  u8 u8RowPosition = 0;
-  for(u8 i = 0; i < 40; i++)
-  {
-    LcdClearPixels(&G_sLcdClearWholeScreen);
-  
-    /* Top left */
-    sEngenuicsImage.u16RowStart = 0;
-    sEngenuicsImage.u16ColumnStart = i;
-    sEngenuicsImage.u16RowSize = 25;
-    sEngenuicsImage.u16ColumnSize = 25;
-    LcdLoadBitmap(&aau8EngenuicsLogoBlackQ1[0][0], &sEngenuicsImage);
-  
-    /* Top right */
-    sEngenuicsImage.u16RowStart = 0;
-    sEngenuicsImage.u16ColumnStart = LCD_COLUMNS - 25 - i;
-    LcdLoadBitmap(&aau8EngenuicsLogoBlackQ2[0][0], &sEngenuicsImage);
-  
-    /* Bottom left */
-    sEngenuicsImage.u16RowStart = LCD_ROWS - 25 - u8RowPosition;
-    sEngenuicsImage.u16ColumnStart = i;
-    LcdLoadBitmap(&aau8EngenuicsLogoBlackQ3[0][0], &sEngenuicsImage);
-    
-    /* Bottom right */
-    sEngenuicsImage.u16RowStart = LCD_ROWS - 25 - u8RowPosition;
-    sEngenuicsImage.u16ColumnStart = LCD_COLUMNS - 25 - i;
-    LcdLoadBitmap(&aau8EngenuicsLogoBlackQ4[0][0], &sEngenuicsImage);
-  
-    /* Write the MPGL2 String in the middle */
-    sStringLocation.u16PixelColumnAddress = LCD_CENTER_COLUMN - ( strlen((char const*)Lcd_au8MessageWelcome) * (LCD_SMALL_FONT_COLUMNS + LCD_SMALL_FONT_SPACE) / 2 );
-    sStringLocation.u16PixelRowAddress = LCD_SMALL_FONT_LINE7;
-    LcdLoadString(Lcd_au8MessageWelcome, LCD_FONT_SMALL, &sStringLocation);
-    LcdManualMode();
-       
-    /* Adjust the row by one every few iterations */
-    if( (i % 3) == 0)
-    {
-      u8RowPosition++;
-      /* On the last iteration set, adjust one more row to bring the icon together */
-      if(u8RowPosition == 13)
-      {
-        u8RowPosition = 14;
-      }
-    }
-  }
-  
-#else /* LCD_STARTUP_ANIMATION */
-  
-  /* Show static image in middle of screen */
-  LcdClearPixels(&G_sLcdClearWholeScreen);
-  
-  sEngenuicsImage.u16RowStart = 0;
-  sEngenuicsImage.u16ColumnStart = 40;
-  sEngenuicsImage.u16RowSize = LCD_IMAGE_ROW_SIZE_50PX;
-  sEngenuicsImage.u16ColumnSize = LCD_IMAGE_COL_SIZE_50PX;
-  LcdLoadBitmap(&aau8EngenuicsLogoBlack[0][0], &sEngenuicsImage);
-
-  /* Write the MPGL2 String in the middle */
-  sStringLocation.u16PixelColumnAddress = LCD_CENTER_COLUMN - ( strlen((char const*)Lcd_au8MessageWelcome) * (LCD_SMALL_FONT_COLUMNS + LCD_SMALL_FONT_SPACE) / 2 );
-  sStringLocation.u16PixelRowAddress = LCD_SMALL_FONT_LINE7;
-  LcdLoadString(Lcd_au8MessageWelcome, LCD_FONT_SMALL, &sStringLocation);
-
-  LcdManualMode();
-#endif /* LCD_STARTUP_ANIMATION */
-
-  /* Announce on the debug port that LCD setup is ready */
-  G_u32ApplicationFlags |= _APPLICATION_FLAGS_LCD;
-  DebugPrintf(Lcd_au8MessageInit);
+  G_u32StartupFlags |= _APPLICATION_FLAGS_LCD;
+  Lcd_pfnStateMachine = LcdSM_StartupReset;
   
 } /* end LcdInitialize() */
 
@@ -853,44 +765,6 @@ void LcdRunActiveState(void)
 } /* end LcdRunActiveState */
 
 
-/*----------------------------------------------------------------------------------------------------------------------
-Function: LcdManualMode
-
-Description:
-Runs a cycle of the LCD state machine until there are no messages queued up to transmit.
-
-*** Violates 1ms system timing: use only during initialization ***
-
-Requires:
- - SSP state machine ready for manual mode
-           
-Promises:
- - The current command for an LCD will be sent; or an LCD refresh will be carried out.
-  
-*/
-void LcdManualMode(void)
-{
-  u32 u32ManualModeTimer;
-  
-  if(G_u32SystemFlags & _SYSTEM_INITIALIZING)
-  {
-    /* Zero the refresh timer so the LCD refreshes right away in manual mode */
-    Lcd_u32RefreshTimer = 0; 
-    Lcd_u32Flags |= _LCD_MANUAL_MODE;
-    while(Lcd_u32Flags & _LCD_MANUAL_MODE)
-    {
-      /* Run the two SMs that are needed to send LCD bytes */
-      Lcd_pfnStateMachine();
-      
-      /* Provide an equivalent system tick delay */
-      u32ManualModeTimer = G_u32SystemTime1ms;
-      while( !IsTimeUp(&u32ManualModeTimer, 1) );
-    }
-  }
-  
-} /* end LcdManualMode() */
-
-
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* Private Functions */
 /*--------------------------------------------------------------------------------------------------------------------*/
@@ -924,7 +798,7 @@ static bool LcdSetStartAddressForDataTransfer(u8 u8LocalRamPage_)
       
     LCD_COMMAND_MODE(); 
     Lcd_u32Flags |= _LCD_FLAGS_COMMAND_IN_QUEUE;
-    Lcd_u32CurrentMsgToken = SspWriteData(Lcd_Ssp, 3, &Lcd_au8TxBuffer[0]);
+    Lcd_u32CurrentMsgToken = SspWriteDataReference(Lcd_Ssp, 3, &Lcd_au8TxBuffer[0]);
 
     return TRUE;
   }
@@ -1005,9 +879,10 @@ static void LcdLoadPageToBuffer(u8 u8LocalRamPage_)
     }
   }
   
-  /* Lcd_au8TxBuffer now has all of the bytes for the current transfer */
+  /* Lcd_au8TxBuffer now has all of the bytes for the current transfer.  It is sent in place since it is
+  not touched again until LcdSM_WaitTransfer sees the message COMPLETE. */
   LCD_DATA_MODE();
-  Lcd_u32CurrentMsgToken = SspWriteData(Lcd_Ssp, Lcd_sCurrentUpdateArea.u16ColumnSize, &Lcd_au8TxBuffer[0]);
+  Lcd_u32CurrentMsgToken = SspWriteDataReference(Lcd_Ssp, Lcd_sCurrentUpdateArea.u16ColumnSize, &Lcd_au8TxBuffer[0]);
  
 } /* end LcdLoadPageToBuffer () */
     
@@ -1070,6 +945,59 @@ static void LcdUpdateScreenRefreshArea(PixelBlockType* sPixelsToUpdate_)
 } /* end LcdUpdateScreenRefreshArea() */      
 
 
+/*----------------------------------------------------------------------------------------------------------------------
+Function: LcdStartRefresh
+
+Description:
+Starts sending the part of the LCD RAM image that has changed since the last refresh.
+
+Requires:
+  - Lcd_sUpdateArea holds the area to refresh (u16RowSize is 0 if nothing has changed)
+  - Lcd_ReturnState is the state to go to when the refresh is done
+
+Promises:
+  - If there is something to refresh, Lcd_sUpdateArea is moved to Lcd_sCurrentUpdateArea, 
+    the first page address command is queued, Lcd_u32Timer is started and Lcd_pfnStateMachine = LcdSM_WaitTransfer
+  - Otherwise, Lcd_pfnStateMachine = Lcd_ReturnState
+*/
+static void LcdStartRefresh(void)
+{
+  /* Do something only if there is something to do (i.e. at least one row of the LCD needs updating) */
+  if(Lcd_sUpdateArea.u16RowSize != 0)
+  {
+    /* Make a copy of the current Lcd_sUpdateArea then clear it */
+    Lcd_sCurrentUpdateArea.u16RowSize     = Lcd_sUpdateArea.u16RowSize;
+    Lcd_sCurrentUpdateArea.u16ColumnSize  = Lcd_sUpdateArea.u16ColumnSize;
+    Lcd_sCurrentUpdateArea.u16RowStart    = Lcd_sUpdateArea.u16RowStart;
+    Lcd_sCurrentUpdateArea.u16ColumnStart = Lcd_sUpdateArea.u16ColumnStart;     
+
+    Lcd_sUpdateArea.u16RowSize     = 0;
+    Lcd_sUpdateArea.u16ColumnSize  = 0;
+    Lcd_sUpdateArea.u16RowStart    = 0;
+    Lcd_sUpdateArea.u16ColumnStart = 0;     
+
+    /* Calculate the number of pages to update -- all rows in a page must be updated to the LCD if any
+    pixels are present on the page.  Eg. if 10 rows need updating, then up to 3 pages will have to be updated
+    since there could be one pixel row on page n, eight on page n+1 and one on page n+2.  */
+    Lcd_u8PagesToUpdate = ( (Lcd_sCurrentUpdateArea.u16RowStart + Lcd_sCurrentUpdateArea.u16RowSize - 1) / LCD_PAGE_SIZE ) - 
+                          ( (Lcd_sCurrentUpdateArea.u16RowStart) / LCD_PAGE_SIZE ) + 1;
+    
+    /* Set the starting page; subsequent pages are incremental */
+    Lcd_u8CurrentPage = Lcd_sCurrentUpdateArea.u16RowStart / LCD_PAGE_SIZE;
+
+    /* Start the refresh cycle by loading the command to set the cursor location */
+    LcdSetStartAddressForDataTransfer(Lcd_u8CurrentPage);
+    Lcd_u32Timer = G_u32SystemTime1ms;
+    Lcd_pfnStateMachine = LcdSM_WaitTransfer;
+  }
+  else
+  {
+    Lcd_pfnStateMachine = Lcd_ReturnState;
+  }
+  
+} /* end LcdStartRefresh() */
+
+
 /***********************************************************************************************************************
 State Machine Function Definitions
 
@@ -1096,39 +1024,8 @@ static void LcdSM_Idle(void)
   {
     /* Reset the refresh period reference value */
     Lcd_u32RefreshTimer = G_u32SystemTime1ms;
-    
-    /* Do something only if there is something to do (i.e. at least one row of the LCD needs updating) */
-    if(Lcd_sUpdateArea.u16RowSize != 0)
-    {
-      /* Make a copy of the current Lcd_sUpdateArea then clear it */
-      Lcd_sCurrentUpdateArea.u16RowSize     = Lcd_sUpdateArea.u16RowSize;
-      Lcd_sCurrentUpdateArea.u16ColumnSize  = Lcd_sUpdateArea.u16ColumnSize;
-      Lcd_sCurrentUpdateArea.u16RowStart    = Lcd_sUpdateArea.u16RowStart;
-      Lcd_sCurrentUpdateArea.u16ColumnStart = Lcd_sUpdateArea.u16ColumnStart;     
-
-      Lcd_sUpdateArea.u16RowSize     = 0;
-      Lcd_sUpdateArea.u16ColumnSize  = 0;
-      Lcd_sUpdateArea.u16RowStart    = 0;
-      Lcd_sUpdateArea.u16ColumnStart = 0;     
-
-      /* Calculate the number of pages to update -- all rows in a page must be updated to the LCD if any
-      pixels are present on the page.  Eg. if 10 rows need updating, then up to 3 pages will have to be updated
-      since there could be one pixel row on page n, eight on page n+1 and one on page n+2.  */
-      Lcd_u8PagesToUpdate = ( (Lcd_sCurrentUpdateArea.u16RowStart + Lcd_sCurrentUpdateArea.u16RowSize - 1) / LCD_PAGE_SIZE ) - 
-                            ( (Lcd_sCurrentUpdateArea.u16RowStart) / LCD_PAGE_SIZE ) + 1;
-      
-      /* Set the starting page; subsequent pages are incremental */
-      Lcd_u8CurrentPage = Lcd_sCurrentUpdateArea.u16RowStart / LCD_PAGE_SIZE;
-
-      /* Start the refresh cycle by loading the command to set the cursor location */
-      LcdSetStartAddressForDataTransfer(Lcd_u8CurrentPage);
-      Lcd_pfnStateMachine = LcdSM_WaitTransfer;
-    }
-  }
-  else
-  {
-    /* Nothing to do, so just make sure manual mode is not enabled */
-    Lcd_u32Flags &= ~_LCD_MANUAL_MODE;
+    Lcd_ReturnState = LcdSM_Idle;
+    LcdStartRefresh();
   }
         
 } /* end LcdSM_Idle */
@@ -1139,13 +1036,23 @@ State: LcdSM_WaitTransfer()
 Sends the current queued LCD command or data to the SPI peripheral through the SSP API.
 This waits until the message token is complete or a timeout occurs.  We can determine the next step based
 on Lcd_u8PagesToUpdate that will be 0 if the last transfer was a comand or non-zero if we are waiting
-on the screen refresh process.
+on the screen refresh process.  When everything is sent, the state machine goes to Lcd_ReturnState.
+Lcd_u32Timer must be started when this state is entered.  If a transfer is not COMPLETE within 
+LCD_TRANSFER_TIMEOUT_MS (or the messaging task gives up on it), the command or refresh is dropped, 
+_LCD_FLAGS_TRANSFER_ERROR is set and LcdSM_WaitRelease holds the state machine until the message is out of the 
+SSP queue.
 */
 static void LcdSM_WaitTransfer(void)
 {
+  MessageStateType eStatus;
+  
   /* Wait for message to be sent */
-  if(QueryMessageStatus(Lcd_u32CurrentMsgToken) == COMPLETE)
+  eStatus = QueryMessageStatus(Lcd_u32CurrentMsgToken);
+  if(eStatus == COMPLETE)
   {
+    /* Each transfer gets the full timeout */
+    Lcd_u32Timer = G_u32SystemTime1ms;
+    
     /* The next step depends on what we did last */
     if(Lcd_u8PagesToUpdate != 0)
     {
@@ -1163,23 +1070,218 @@ static void LcdSM_WaitTransfer(void)
         LcdSetStartAddressForDataTransfer(Lcd_u8CurrentPage);
       }
       
-      Lcd_ReturnState = LcdSM_WaitTransfer;
     }
     /* Either just sent a command, or just sent that last data page */
     else
     {
-      Lcd_u32Flags &= ~(_LCD_MANUAL_MODE | _LCD_FLAGS_COMMAND_IN_QUEUE);
-      Lcd_ReturnState = LcdSM_Idle;
+      Lcd_u32Flags &= ~_LCD_FLAGS_COMMAND_IN_QUEUE;
+      Lcd_pfnStateMachine = Lcd_ReturnState;
     }
-
-    Lcd_pfnStateMachine = Lcd_ReturnState;
   }
   
   /* Check for timeout */
+  else if( (eStatus == TIMEOUT) || (eStatus == ABANDONED) || (eStatus == NOT_FOUND) ||
+           IsTimeUp(&Lcd_u32Timer, LCD_TRANSFER_TIMEOUT_MS) )
+  {
+    /* Put the area of an unfinished refresh back in the update area so the next refresh redraws it */
+    if(Lcd_u8PagesToUpdate != 0)
+    {
+      LcdUpdateScreenRefreshArea(&Lcd_sCurrentUpdateArea);
+      Lcd_u8PagesToUpdate = 0;
+    }
+    
+    /* The message may still be queued (TIMEOUT, a local timeout or a status that aged out) and the PDC may yet 
+    read Lcd_au8TxBuffer, so LcdCommand() stays blocked until it is gone */
+    Lcd_u32Flags |= (_LCD_FLAGS_COMMAND_IN_QUEUE | _LCD_FLAGS_TRANSFER_ERROR);
+    DebugPrintf(Lcd_au8MessageTimeout);
+    
+    Lcd_pfnStateMachine = LcdSM_WaitRelease;
+  }
   
 } /* end LcdSM_WaitTransfer() */
 
 
+/*----------------------------------------------------------------------------------------------------------------------
+State: LcdSM_WaitRelease()
+Waits after a dropped transfer until the LCD's SSP transmit queue is empty.  Only then is the dropped message no 
+longer using Lcd_au8TxBuffer, so the next refresh can load it.  If the SSP never sends the message the LCD stops 
+here with _LCD_FLAGS_TRANSFER_ERROR set rather than change a buffer the PDC may still be reading.
+*/
+static void LcdSM_WaitRelease(void)
+{
+  if(SspTxQueueCount(Lcd_Ssp) == 0)
+  {
+    Lcd_u32Flags &= ~_LCD_FLAGS_COMMAND_IN_QUEUE;
+    Lcd_pfnStateMachine = Lcd_ReturnState;
+  }
+  
+} /* end LcdSM_WaitRelease() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+State: LcdSM_StartupReset()
+Holds the LCD in reset for LCD_STARTUP_RESET_TIME_MS then releases it.
+*/
+static void LcdSM_StartupReset(void)
+{
+  if( IsTimeUp(&Lcd_u32Timer, LCD_STARTUP_RESET_TIME_MS) )
+  {
+    LCD_RESET_DEASSERT();
+    
+    Lcd_u32Timer = G_u32SystemTime1ms;
+    Lcd_u8StartupStep = 0;
+    Lcd_pfnStateMachine = LcdSM_StartupSetup;
+  }
+  
+} /* end LcdSM_StartupReset() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+State: LcdSM_StartupSetup()
+Sends the settings array one command at a time (ending with display and pixel test on) with 
+LCD_STARTUP_COMMAND_TIME_MS between commands, then clears the LCD pixel data.
+*/
+static void LcdSM_StartupSetup(void)
+{
+  u32 u32WaitTime = LCD_STARTUP_COMMAND_TIME_MS;
+
+  /* The first command only waits for the LCD to come out of reset */
+  if(Lcd_u8StartupStep == 0)
+  {
+    u32WaitTime = LCD_STARTUP_RESET_TIME_MS;
+  }
+  
+  if( IsTimeUp(&Lcd_u32Timer, u32WaitTime) )
+  {
+    Lcd_u32Timer = G_u32SystemTime1ms;
+    
+    if(Lcd_u8StartupStep < sizeof(Lcd_au8SetupArray))
+    {
+      LcdCommand(Lcd_au8SetupArray[Lcd_u8StartupStep]);
+      Lcd_u8StartupStep++;
+      Lcd_u32Timer = G_u32SystemTime1ms;
+      
+      Lcd_ReturnState = LcdSM_StartupSetup;
+      Lcd_pfnStateMachine = LcdSM_WaitTransfer;
+    }
+    else
+    {
+      /* Clear LCD pixel data and start the short pixel test */
+      LcdClearPixels(&G_sLcdClearWholeScreen);
+      Lcd_ReturnState = LcdSM_StartupPixelTest;
+      LcdStartRefresh();
+    }
+  }
+  
+} /* end LcdSM_StartupSetup() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+State: LcdSM_StartupPixelTest()
+Leaves the pixel test on for LCD_STARTUP_PIXEL_TEST_MS.
+*/
+static void LcdSM_StartupPixelTest(void)
+{
+  if( IsTimeUp(&Lcd_u32Timer, LCD_STARTUP_PIXEL_TEST_MS) )
+  {
+    LcdCommand(LCD_PIXEL_TEST_OFF);
+    Lcd_u32Timer = G_u32SystemTime1ms;
+    
+    Lcd_u8StartupStep = 0;
+    Lcd_u8StartupRow = 0;
+    Lcd_ReturnState = LcdSM_StartupImage;
+    Lcd_pfnStateMachine = LcdSM_WaitTransfer;
+  }
+  
+} /* end LcdSM_StartupPixelTest() */
+
+
+/*----------------------------------------------------------------------------------------------------------------------
+State: LcdSM_StartupImage()
+Draws one frame of the startup image each time the previous frame has been sent to the LCD.
+After LCD_STARTUP_FRAMES frames the LCD is ready.
+*/
+static void LcdSM_StartupImage(void)
+{
+  PixelBlockType sEngenuicsImage;
+  PixelAddressType sStringLocation;
+
+  if(Lcd_u8StartupStep < LCD_STARTUP_FRAMES)
+  {
+    LcdClearPixels(&G_sLcdClearWholeScreen);
+    
+#if LCD_STARTUP_ANIMATION
+    /* Divide the Engenuics logo up into 4 equal pieces and put them at the corner of the LCD to 
+    ensure that the full range of pixels is being addressed correctly */
+    
+    /* Top left */
+    sEngenuicsImage.u16RowStart = 0;
+    sEngenuicsImage.u16ColumnStart = Lcd_u8StartupStep;
+    sEngenuicsImage.u16RowSize = 25;
+    sEngenuicsImage.u16ColumnSize = 25;
+    LcdLoadBitmap(&aau8EngenuicsLogoBlackQ1[0][0], &sEngenuicsImage);
+  
+    /* Top right */
+    sEngenuicsImage.u16RowStart = 0;
+    sEngenuicsImage.u16ColumnStart = LCD_COLUMNS - 25 - Lcd_u8StartupStep;
+    LcdLoadBitmap(&aau8EngenuicsLogoBlackQ2[0][0], &sEngenuicsImage);
+  
+    /* Bottom left */
+    sEngenuicsImage.u16RowStart = LCD_ROWS - 25 - Lcd_u8StartupRow;
+    sEngenuicsImage.u16ColumnStart = Lcd_u8StartupStep;
+    LcdLoadBitmap(&aau8EngenuicsLogoBlackQ3[0][0], &sEngenuicsImage);
+    
+    /* Bottom right */
+    sEngenuicsImage.u16RowStart = LCD_ROWS - 25 - Lcd_u8StartupRow;
+    sEngenuicsImage.u16ColumnStart = LCD_COLUMNS - 25 - Lcd_u8StartupStep;
+    LcdLoadBitmap(&aau8EngenuicsLogoBlackQ4[0][0], &sEngenuicsImage);
+
+    /* Adjust the row by one every few iterations */
+    if( (Lcd_u8StartupStep % 3) == 0)
+    {
+      Lcd_u8StartupRow++;
+      /* On the last iteration set, adjust one more row to bring the icon together */
+      if(Lcd_u8StartupRow == 13)
+      {
+        Lcd_u8StartupRow = 14;
+      }
+    }
+    
+#else /* LCD_STARTUP_ANIMATION */
+  
+    /* Show static image in middle of screen */
+    sEngenuicsImage.u16RowStart = 0;
+    sEngenuicsImage.u16ColumnStart = 40;
+    sEngenuicsImage.u16RowSize = LCD_IMAGE_ROW_SIZE_50PX;
+    sEngenuicsImage.u16ColumnSize = LCD_IMAGE_COL_SIZE_50PX;
+    LcdLoadBitmap(&aau8EngenuicsLogoBlack[0][0], &sEngenuicsImage);
+    
+#endif /* LCD_STARTUP_ANIMATION */
+
+    /* Write the MPGL2 String in the middle */
+    sStringLocation.u16PixelColumnAddress = LCD_CENTER_COLUMN - ( strlen((char const*)Lcd_au8MessageWelcome) * (LCD_SMALL_FONT_COLUMNS + LCD_SMALL_FONT_SPACE) / 2 );
+    sStringLocation.u16PixelRowAddress = LCD_SMALL_FONT_LINE7;
+    LcdLoadString(Lcd_au8MessageWelcome, LCD_FONT_SMALL, &sStringLocation);
+
+    /* Send the frame and come back for the next one */
+    Lcd_u8StartupStep++;
+    Lcd_ReturnState = LcdSM_StartupImage;
+    LcdStartRefresh();
+  }
+  else
+  {
+    /* Announce on the debug port that LCD setup is ready */
+    G_u32ApplicationFlags |= _APPLICATION_FLAGS_LCD;
+    DebugPrintf(Lcd_au8MessageInit);
+    G_u32StartupFlags &= ~_APPLICATION_FLAGS_LCD;
+
+    Lcd_u32RefreshTimer = G_u32SystemTime1ms;
+    Lcd_pfnStateMachine = LcdSM_Idle;
+  }
+  
+} /* end LcdSM_StartupImage() */
+
+
 /*--------------------------------------------------------------------------------------------------------------------*/
 /* End of File */
 /*--------------------------------------------------------------------------------------------------------------------*/
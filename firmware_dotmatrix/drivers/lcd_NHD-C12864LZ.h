@@ -67,8 +67,7 @@ typedef struct
 *******************************************************************************/
 /* Lcd_u32Flags */
 #define _LCD_FLAGS_COMMAND_IN_QUEUE   0x00000001      /* Command or data in LCD */
-
-#define _LCD_MANUAL_MODE              0x10000000      /* The task is in manual mode */
+#define _LCD_FLAGS_TRANSFER_ERROR     0x00000002      /* A command or refresh was dropped because its transfer timed out */
 
 /* end Lcd_u32Flags */
 
@@ -93,6 +92,16 @@ typedef struct
 #define LCD_STARTUP_DELAY_200         (u32)205
 #define LCD_STARTUP_DELAY_10          (u32)11
 #define LCD_REFRESH_TIME              (u32)25                /* Time in ms between LCD refreshes */
+#define LCD_TRANSFER_TIMEOUT_MS       (u32)100               /* Time in ms to wait for one LCD command or page transfer */
+
+#define LCD_STARTUP_RESET_TIME_MS     (u32)2                 /* Time in ms for the reset pulse and for the LCD to come out of reset */
+#define LCD_STARTUP_COMMAND_TIME_MS   (u32)5                 /* Time in ms between setup commands */
+#define LCD_STARTUP_PIXEL_TEST_MS     (u32)500               /* Time in ms the pixel test is shown */
+#if LCD_STARTUP_ANIMATION
+#define LCD_STARTUP_FRAMES            (u8)40                 /* Frames in the startup animation */
+#else
+#define LCD_STARTUP_FRAMES            (u8)1                  /* Static startup image */
+#endif /* LCD_STARTUP_ANIMATION */
 
 /* Bitmap sizes (x = # of column pixels, y = # of row pixels) */
 #define LCD_SMALL_FONT_COLUMNS        (u8)5
@@ -208,16 +217,21 @@ bool LcdCommand(u8 u8Command_);
 /* LCD Protected Functions */
 void LcdInitialize(void);
 void LcdRunActiveState(void);
-void LcdManualMode(void);
 
 /* LCD Private Driver Functions */
 static bool LcdSetStartAddressForDataTransfer(u8 u8Page_);         
 static void LcdLoadPageToBuffer(u8 u8LocalRamPage_); 
 static void LcdUpdateScreenRefreshArea(PixelBlockType* sPixelsToClear_);
+static void LcdStartRefresh(void);
 
 /* State machine declarations */
 static void LcdSM_Idle(void);
 static void LcdSM_WaitTransfer(void);
+static void LcdSM_WaitRelease(void);
+static void LcdSM_StartupReset(void);
+static void LcdSM_StartupSetup(void);
+static void LcdSM_StartupPixelTest(void);
+static void LcdSM_StartupImage(void);
 static void BoardTestSM_WaitPixelTestOn(void);          
 static void BoardTestSM_WaitPixelTestOff(void);          
 